@@ -203,7 +203,7 @@ GridCg<APPLYMAT>::GridCg(Grid<Real>& dst, Grid<Real>& rhs, Grid<Real>& residual,
 			   Grid<Real>* pA0, Grid<Real>* pAi, Grid<Real>* pAj, Grid<Real>* pAk) :
 	GridCgInterface(), mInited(false), mIterations(0), mDst(dst), mRhs(rhs), mResidual(residual),
 	mSearch(search), mFlags(flags), mTmp(tmp), mpA0(pA0), mpAi(pAi), mpAj(pAj), mpAk(pAk),
-	mPcMethod(PC_None), mpPCA0(nullptr), mpPCAi(nullptr), mpPCAj(nullptr), mpPCAk(nullptr), mMG(nullptr), mSigma(0.), mAccuracy(VECTOR_EPSILON), mResNorm(1e20) 
+	mPcMethod(PC_None), mpPCA0(nullptr), mpPCAi(nullptr), mpPCAj(nullptr), mpPCAk(nullptr), mMG(nullptr), mSchwarz(nullptr), mSigma(0.), mAccuracy(VECTOR_EPSILON), mResNorm(1e20) 
 {
 	dst.clear();
 	residual.clear();
@@ -228,6 +228,9 @@ void GridCg<APPLYMAT>::doInit() {
 	} else if (mPcMethod == PC_MGP) {
 		InitPreconditionMultigrid(mMG, *mpA0, *mpAi, *mpAj, *mpAk, mAccuracy);
 		ApplyPreconditionMultigrid(mMG, mTmp, mResidual);
+	} else if (mPcMethod == PC_SchwarzP) {
+		mSchwarz->setA(mFlags, mpA0, mpAi, mpAj, mpAk);
+		mSchwarz->apply(mTmp, mResidual);
 	} else {
 		mTmp.copyFrom( mResidual );
 	}
@@ -263,6 +266,8 @@ bool GridCg<APPLYMAT>::iterate() {
 		ApplyPreconditionModifiedIncompCholesky2(mTmp, mResidual, mFlags, *mpPCA0, *mpA0, *mpAi, *mpAj, *mpAk);
 	else if (mPcMethod == PC_MGP)
 		ApplyPreconditionMultigrid(mMG, mTmp, mResidual);
+	else if (mPcMethod == PC_SchwarzP)
+		mSchwarz->apply(mTmp, mResidual);
 	else
 		mTmp.copyFrom( mResidual );
 		
@@ -329,6 +334,15 @@ void GridCg<APPLYMAT>::setMGPreconditioner(PreconditionType method, GridMg* MG)
 	mMG = MG;
 }
 
+template<class APPLYMAT>
+void GridCg<APPLYMAT>::setSchwarzPreconditioner(PreconditionType method, GridSchwarz* schwarz) {
+	assertMsg(method==PC_SchwarzP, "GridCg<APPLYMAT>::setSchwarzPreconditioner: Invalid method specified.");
+
+	mPcMethod = method;
+
+	mSchwarz = schwarz;
+}
+
 // explicit instantiation
 template class GridCg<ApplyMatrix>;
 template class GridCg<ApplyMatrix2D>;
@@ -18,6 +18,7 @@
 #include "grid.h"
 #include "kernel.h"
 #include "multigrid.h"
+#include "schwarz.h"
 
 namespace Manta { 
 
@@ -26,7 +27,7 @@ static const bool CG_DEBUG = false;
 //! Basic CG interface 
 class GridCgInterface {
 	public:
-		enum PreconditionType { PC_None=0, PC_ICP, PC_mICP, PC_MGP };
+		enum PreconditionType { PC_None=0, PC_ICP, PC_mICP, PC_MGP, PC_SchwarzP };
 		
 		GridCgInterface() : mUseL2Norm(true) {};
 		virtual ~GridCgInterface() {};
@@ -38,6 +39,7 @@ class GridCgInterface {
 		// precond
 		virtual void setICPreconditioner(PreconditionType method, Grid<Real> *A0, Grid<Real> *Ai, Grid<Real> *Aj, Grid<Real> *Ak) = 0;
 		virtual void setMGPreconditioner(PreconditionType method, GridMg* MG) = 0;
+		virtual void setSchwarzPreconditioner(PreconditionType method, GridSchwarz* schwarz) = 0;
 
 		// access
 		virtual Real getSigma() const = 0;
@@ -73,6 +75,7 @@ class GridCg : public GridCgInterface {
 		//! init pointers, and copy values from "normal" matrix
 		void setICPreconditioner(PreconditionType method, Grid<Real> *A0, Grid<Real> *Ai, Grid<Real> *Aj, Grid<Real> *Ak);
 		void setMGPreconditioner(PreconditionType method, GridMg* MG);
+		void setSchwarzPreconditioner(PreconditionType method, GridSchwarz* schwarz);
 		
 		// Accessors        
 		Real getSigma() const { return mSigma; }
@@ -100,6 +103,7 @@ class GridCg : public GridCgInterface {
 		//! preconditioning grids
 		Grid<Real> *mpPCA0, *mpPCAi, *mpPCAj, *mpPCAk;
 		GridMg* mMG;
+		GridSchwarz* mSchwarz;
 
 		//! sigma / residual
 		Real mSigma;
@@ -125,13 +125,88 @@ Vec3 ModifiedButterflySubdivision(Mesh& m, const Corner &ca, const Corner &cb, c
 
 bool gAbort = false;
 
+// plain collapse of the edge P0-P1 between the triangles of ca_old and cb_old, P1 is merged into P0
+static void collapseCorners(Mesh& m, const Corner ca_old[3], const Corner cb_old[3], const int P0, const int P1, 
+							const Vec3 &edgevect, const Vec3 &endpoint, vector<char> &deletedNodes, vector<char> &taintedTris)
+{
+	// update tri props of all adjacent triangles of P0,P1 (do before CT updates!)
+	// TODO: handleTriPropertyEdgeCollapse(trinum, P0,P1,  ca_old[0], cb_old[0]);
+
+	m.mergeNode(P0, P1);
+	
+	// Move position of P0
+	m.nodes(P0).pos = endpoint + 0.5*edgevect;
+
+	// Preserve connectivity in both triangles
+	if (ca_old[1].opposite>=0)
+		m.corners(ca_old[1].opposite).opposite = ca_old[2].opposite;
+	if (ca_old[2].opposite>=0)
+		m.corners(ca_old[2].opposite).opposite = ca_old[1].opposite;
+	if (cb_old[1].opposite>=0)
+		m.corners(cb_old[1].opposite).opposite = cb_old[2].opposite;
+	if (cb_old[2].opposite>=0)
+		m.corners(cb_old[2].opposite).opposite = cb_old[1].opposite;
+	
+	////////////////////
+	// mark the two triangles and the one node for deletion
+	taintedTris[ca_old[0].tri] = true;
+	m.removeTriFromLookup(ca_old[0].tri);
+	taintedTris[cb_old[0].tri] = true;
+	m.removeTriFromLookup(cb_old[0].tri);    
+	deletedNodes[P1] = true;
+}
+
+static inline void edgeCorners(Mesh& m, const int trinum, const int which, Corner ca[3], Corner cb[3]) {
+	ca[0] = m.corners(trinum, which);
+	ca[1] = m.corners(ca[0].next);
+	ca[2] = m.corners(ca[0].prev);
+	cb[0] = m.corners(ca[0].opposite);
+	cb[1] = m.corners(cb[0].next);
+	cb[2] = m.corners(cb[0].prev);
+}
+
+bool IsSimpleCollapse(Mesh& m, const int trinum, const int which) {
+	if (m.corners(trinum, which).opposite < 0) return false;
+	Corner ca[3], cb[3];
+	edgeCorners(m, trinum, which, ca, cb);
+	for (int c=0; c<3; c++)
+		if (ca[c].opposite<0 || cb[c].opposite<0) return false;
+	
+	// 1-rings may only share the two opposite nodes, otherwise the collapse is non-manifold
+	const CompactLists& ring = m.get1RingLookup().nodes;
+	const int P0 = ca[2].node, P1 = ca[1].node;
+	int cl=0;
+	for(const int* it=ring.begin(P1); it != ring.end(P1); ++it)
+		if (ring.contains(P0, *it)) cl++;
+	if (cl>2) return false;
+	
+	// closed caps, tets and two-triangle components are removed as a whole by CollapseEdge
+	const int na1 = m.corners(ca[1].opposite).node, na2 = m.corners(ca[2].opposite).node;
+	const int nb1 = m.corners(cb[1].opposite).node, nb2 = m.corners(cb[2].opposite).node;
+	if (na1==na2 && nb1==nb2 && (na1==nb1 || (na1==cb[0].node && nb1==ca[0].node)))
+		return false;
+	const int tb = m.corners(cb[0].opposite).tri, ta = m.corners(ca[0].opposite).tri;
+	if (ta==tb && m.corners(ca[1].opposite).tri==tb && m.corners(ca[2].opposite).tri==tb &&
+		m.corners(cb[1].opposite).tri==ta && m.corners(cb[2].opposite).tri==ta)
+		return false;
+	return true;
+}
+
+void CollapseSimpleEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgevect, const Vec3 &endpoint,
+						vector<char> &deletedNodes, vector<char> &taintedTris)
+{
+	Corner ca_old[3], cb_old[3];
+	edgeCorners(m, trinum, which, ca_old, cb_old);
+	collapseCorners(m, ca_old, cb_old, ca_old[2].node, ca_old[1].node, edgevect, endpoint, deletedNodes, taintedTris);
+}
+
 // collapse an edge on triangle "trinum".
 // "which" is 0,1, or 2,
 // where which==0 is the triangle edge from p0 to p1, 
 // which==1 is the triangle edge from p1 to p2, 
 // and which==2 is the triangle edge from p2 to p0, 
 void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgevect, const Vec3 &endpoint,
-				  vector<int> &deletedNodes, std::map<int,bool> &taintedTris, int &numCollapses, bool doTubeCutting)
+				  vector<char> &deletedNodes, vector<char> &taintedTris, int &numCollapses, bool doTubeCutting)
 {
 	if (gAbort) return;
 	// I wanted to draw a pretty picture of an edge collapse,
@@ -199,13 +274,12 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 	bool nonmanifold = false;
 	bool nonmanifold2 = false;
 	
-	set<int>& ring0 = m.get1Ring(P0).nodes;
-	set<int>& ring1 = m.get1Ring(P1).nodes;
+	CompactLists& ring = m.get1RingLookup().nodes;
 	
 	// check for intersections of the 1-rings of P0,P1
 	int cl=0, commonVert=-1;
-	for(set<int>::iterator it=ring1.begin(); it != ring1.end(); ++it)
-		if (ring0.find(*it) != ring0.end()) {
+	for(const int* it=ring.begin(P1); it != ring.end(P1); ++it)
+		if (ring.contains(P0, *it)) {
 			cl++;
 			if (*it != ca_old[0].node && *it != cb_old[0].node) commonVert = *it;
 		}
@@ -273,7 +347,7 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 			m.removeTriFromLookup(tmpOthertri);
 			taintedTris[tmpTrinum] = true;
 			taintedTris[tmpOthertri] = true;
-			deletedNodes.push_back(P3);
+			deletedNodes[P3] = true;
 
 			numCollapses++;
 
@@ -290,13 +364,12 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 		
 			///////////////
 			// avoid creating nonmanifold edges... again
-			ring0 = m.get1Ring(ca_old[2].node).nodes;
-			ring1 = m.get1Ring(ca_old[1].node).nodes;
+			const int Q0 = ca_old[2].node, Q1 = ca_old[1].node;
 			
-			// check for intersections of the 1-rings of P0,P1
+			// check for intersections of the 1-rings of the new edge
 			cl=0;
-			for(set<int>::iterator it=ring1.begin(); it != ring1.end(); ++it)
-				if (*it != ca_old[0].node && ring0.find(*it) != ring0.end())
+			for(const int* it=ring.begin(Q1); it != ring.end(Q1); ++it)
+				if (*it != ca_old[0].node && ring.contains(Q0, *it))
 					cl++;
 				
 			if(cl>2) { // nonmanifold
@@ -310,9 +383,9 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 					taintedTris[cb_old[0].tri] = true;
 					m.removeTriFromLookup(ca_old[0].tri);
 					m.removeTriFromLookup(cb_old[0].tri);
-					deletedNodes.push_back(ca_old[0].node);
-					deletedNodes.push_back(ca_old[1].node);
-					deletedNodes.push_back(ca_old[2].node);
+					deletedNodes[ca_old[0].node] = true;
+					deletedNodes[ca_old[1].node] = true;
+					deletedNodes[ca_old[2].node] = true;
 				}
 				return;
 			}
@@ -366,7 +439,7 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 					taintedTris[tmpOthertri] = true;
 					m.removeTriFromLookup(tmpTrinum);
 					m.removeTriFromLookup(tmpOthertri);
-					deletedNodes.push_back(P3);
+					deletedNodes[P3] = true;
 
 					numCollapses++;
 				}
@@ -404,7 +477,7 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 					int tmpOthertri = cd_old[0].tri;
 					taintedTris[tmpTrinum] = true;
 					taintedTris[tmpOthertri] = true;
-					deletedNodes.push_back(P3);
+					deletedNodes[P3] = true;
 
 					numCollapses++;
 				}
@@ -461,10 +534,11 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 			int P0b = m.addNode(Node(m.nodes(P0).pos));
 			int P1b = m.addNode(Node(m.nodes(P1).pos));
 			int P2b = m.addNode(Node(m.nodes(P2).pos));
-			for (int i=0; i<m.numNodeChannels(); i++) {
-				m.nodeChannel(i)->addInterpol(P0, P0, 0.5);
-				m.nodeChannel(i)->addInterpol(P1, P1, 0.5);
-				m.nodeChannel(i)->addInterpol(P2, P2, 0.5);
+			deletedNodes.resize(m.numNodes(), false);
+			{
+				vector<int> src(3);
+				src[0] = P0; src[1] = P1; src[2] = P2;
+				m.appendNodeChannels(src, src, vector<Real>(3, 0.5));
 			}
 			
 			// offset the verts in the normal directions to avoid self intersections
@@ -511,10 +585,8 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 			// create two new triangles,
 			int Ta = m.addTri(Triangle(P0,P1,P2));
 			int Tb = m.addTri(Triangle(P1b,P0b,P2b));
-			for (int i=0; i<m.numTriChannels(); i++) {
-				m.triChannel(i)->addNew();
-				m.triChannel(i)->addNew();
-			}
+			taintedTris.resize(m.numTris(), false);
+			m.appendTriChannels(2);
 					
 			// sew the tris to close the cut on each side
 			for(int c=0; c<3; c++) m.addCorner(Corner(Ta, m.tris(Ta).c[c]));
@@ -536,47 +608,47 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 				m.corners(m.corners(Tb,c).opposite).opposite = 3*Tb+c;
 			}
 			// replace P0,P1,P2 on the top with P0b,P1b,P2b.
+			CompactLists& ringt = m.get1RingLookup().tris;
 			for(map<int,bool>::iterator tti=topTris.begin(); tti!=topTris.end(); tti++) {
 				//cout << "H " << tti->first << " : " << m.tris(tti->first).c[0] << " " << m.tris(tti->first).c[1] << " " << m.tris(tti->first).c[2] << " " << endl;
 				for(int i=0; i<3; i++) {
 					int cn = m.tris(tti->first).c[i];
-					set<int>& ring = m.get1Ring(cn).nodes;          
 					
-					if (ring.find(P0) != ring.end() && cn!=P0 && cn!=P1 && cn!=P2 && cn!=P0b && cn!=P1b && cn!=P2b) {
-						ring.erase(P0);
-						ring.insert(P0b);
-						m.get1Ring(P0).nodes.erase(cn);
-						m.get1Ring(P0b).nodes.insert(cn);
+					if (ring.contains(cn, P0) && cn!=P0 && cn!=P1 && cn!=P2 && cn!=P0b && cn!=P1b && cn!=P2b) {
+						ring.erase(cn, P0);
+						ring.insert(cn, P0b);
+						ring.erase(P0, cn);
+						ring.insert(P0b, cn);
 					}
-					if (ring.find(P1) != ring.end() && cn!=P0 && cn!=P1 && cn!=P2 && cn!=P0b && cn!=P1b && cn!=P2b) {
-						ring.erase(P1);
-						ring.insert(P1b); 
-						m.get1Ring(P1).nodes.erase(cn);
-						m.get1Ring(P1b).nodes.insert(cn);                         
+					if (ring.contains(cn, P1) && cn!=P0 && cn!=P1 && cn!=P2 && cn!=P0b && cn!=P1b && cn!=P2b) {
+						ring.erase(cn, P1);
+						ring.insert(cn, P1b); 
+						ring.erase(P1, cn);
+						ring.insert(P1b, cn);                         
 					}
-					if (ring.find(P2) != ring.end() && cn!=P0 && cn!=P1 && cn!=P2 && cn!=P0b && cn!=P1b && cn!=P2b) {
-						ring.erase(P2);
-						ring.insert(P2b); 
-						m.get1Ring(P2).nodes.erase(cn);
-						m.get1Ring(P2b).nodes.insert(cn);                         
+					if (ring.contains(cn, P2) && cn!=P0 && cn!=P1 && cn!=P2 && cn!=P0b && cn!=P1b && cn!=P2b) {
+						ring.erase(cn, P2);
+						ring.insert(cn, P2b); 
+						ring.erase(P2, cn);
+						ring.insert(P2b, cn);                         
 					}
 					if(cn==P0) {
 						m.tris(tti->first).c[i]=P0b;
 						m.corners(tti->first,i).node = P0b;                        
-						m.get1Ring(P0).tris.erase(tti->first);
-						m.get1Ring(P0b).tris.insert(tti->first);
+						ringt.erase(P0, tti->first);
+						ringt.insert(P0b, tti->first);
 					}
 					else if(cn==P1) {
 						m.tris(tti->first).c[i]=P1b;
 						m.corners(tti->first,i).node = P1b;
-						m.get1Ring(P1).tris.erase(tti->first);
-						m.get1Ring(P1b).tris.insert(tti->first);
+						ringt.erase(P1, tti->first);
+						ringt.insert(P1b, tti->first);
 					}
 					else if(cn==P2) {
 						m.tris(tti->first).c[i]=P2b;
 						m.corners(tti->first,i).node = P2b;
-						m.get1Ring(P2).tris.erase(tti->first);
-						m.get1Ring(P2b).tris.insert(tti->first);
+						ringt.erase(P2, tti->first);
+						ringt.insert(P2b, tti->first);
 					}
 				}
 			}
@@ -600,66 +672,28 @@ void CollapseEdge(Mesh& m, const int trinum, const int which, const Vec3 &edgeve
 	{
 		// both top and bottom are closed pyramid caps, or it is a single tet
 		// delete the whole component!
-		// flood fill to mark all triangles in the component
-		map<int,bool> markedTris;
+		// flood fill to mark all triangles in the component, the taint flags double as visited markers
 		queue<int> triQ;
 		triQ.push(trinum);
-		markedTris[trinum] = true;
-		int iters = 0;
+		taintedTris[trinum] = true;
 		while(!triQ.empty()) {
 			int trival = triQ.front();
 			triQ.pop();
 			for(int i=0; i<3; i++) {
+				deletedNodes[m.tris(trival).c[i]] = true;
 				int newtri = m.corners(m.corners(trival,i).opposite).tri;
-				if(markedTris.find(newtri)==markedTris.end()) {
+				if(!taintedTris[newtri]) {
 					triQ.push(newtri);
-					markedTris[newtri] = true;
+					taintedTris[newtri] = true;
 				}
 			}
-			iters++;
 		}
-		map<int,bool> markedverts;
-		for(map<int,bool>::iterator mit=markedTris.begin(); mit!=markedTris.end(); mit++) {
-			taintedTris[mit->first] = true;
-			markedverts[m.tris(mit->first).c[0]] = true;
-			markedverts[m.tris(mit->first).c[1]] = true;
-			markedverts[m.tris(mit->first).c[2]] = true;            
-		}
-		for(map<int,bool>::iterator mit=markedverts.begin(); mit!=markedverts.end(); mit++)
-			deletedNodes.push_back(mit->first);
 		return;
 	}
 
 	//////////////////////////
 	// begin original edge collapse
-
-	// update tri props of all adjacent triangles of P0,P1 (do before CT updates!)
-	// TODO: handleTriPropertyEdgeCollapse(trinum, P0,P1,  ca_old[0], cb_old[0]);
-
-	m.mergeNode(P0, P1);
-	
-	// Move position of P0
-	m.nodes(P0).pos = endpoint + 0.5*edgevect;
-
-	// Preserve connectivity in both triangles
-	if (ca_old[1].opposite>=0)
-		m.corners(ca_old[1].opposite).opposite = ca_old[2].opposite;
-	if (ca_old[2].opposite>=0)
-		m.corners(ca_old[2].opposite).opposite = ca_old[1].opposite;
-	if (haveB && cb_old[1].opposite>=0)
-		m.corners(cb_old[1].opposite).opposite = cb_old[2].opposite;
-	if (haveB && cb_old[2].opposite>=0)
-		m.corners(cb_old[2].opposite).opposite = cb_old[1].opposite;
-	
-	////////////////////
-	// mark the two triangles and the one node for deletion
-	taintedTris[ca_old[0].tri] = true;
-	m.removeTriFromLookup(ca_old[0].tri);
-	if (haveB) {
-		taintedTris[cb_old[0].tri] = true;
-		m.removeTriFromLookup(cb_old[0].tri);    
-	}
-	deletedNodes.push_back(P1);
+	collapseCorners(m, ca_old, cb_old, P0, P1, edgevect, endpoint, deletedNodes, taintedTris);
 	numCollapses++;
 }
 
@@ -26,8 +26,18 @@
 
 namespace Manta {
 
+//! deletedNodes and taintedTris are flags per node / triangle, grown if tube cutting adds elements
 void CollapseEdge(Mesh& mesh, const int trinum, const int which, const Vec3 &edgevect, const Vec3 &endpoint,
-                  std::vector<int> &deletedNodes, std::map<int,bool> &taintedTris, int &numCollapses, bool doTubeCutting);
+                  std::vector<char> &deletedNodes, std::vector<char> &taintedTris, int &numCollapses, bool doTubeCutting);
+
+//! true if the collapse only needs the plain edge collapse (closed, manifold neighborhood, no tet or tube case).
+//! Read-only, can be evaluated in parallel
+bool IsSimpleCollapse(Mesh& mesh, const int trinum, const int which);
+
+//! plain edge collapse, only touches the nodes P0,P1, their 1-rings and the triangles around P0,P1.
+//! Collapses with disjoint neighborhoods can be applied in parallel, after Mesh::reserveMerge(P0,P1) for each
+void CollapseSimpleEdge(Mesh& mesh, const int trinum, const int which, const Vec3 &edgevect, const Vec3 &endpoint,
+                  std::vector<char> &deletedNodes, std::vector<char> &taintedTris);
 
 Vec3 ModifiedButterflySubdivision(Mesh& mesh, const Corner& ca, const Corner& cb, const Vec3& fallback);
     
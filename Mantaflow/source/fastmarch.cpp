@@ -220,6 +220,168 @@ void FastMarch<COMP,TDIR>::performMarching() {
 	setls.getArg0(); // get rid of compiler warning...
 }
 
+/*****************************************************************************/
+// fast iterative method (Jeong & Whitaker), parallel alternative to the heap
+
+//! upwind distance of a cell from its known neighbors, in marching direction (tdir*phi)
+//! same update as calculateDistance, but takes the closer neighbor along each axis
+static inline Real fimSolve(const Grid<Real>& phi, const Grid<int>& fmFlags, const IndexInt idx, const int tdir) {
+	const IndexInt stride[3] = { 1, phi.getSizeX(), phi.getStrideZ() };
+	const int dim = phi.is3D() ? 3 : 2;
+	Real a[3];
+	int cnt = 0;
+	for (int c=0; c<dim; c++) {
+		bool ok = false;
+		for (int s=-1; s<=1; s+=2) {
+			const IndexInt nb = idx + s*stride[c];
+			if (fmFlags[nb] == 0) continue;
+			const Real u = tdir * phi[nb];
+			if (!ok || u < a[cnt]) a[cnt] = u;
+			ok = true;
+		}
+		if (ok) cnt++;
+	}
+	if (cnt==0) return -FastMarch<FmHeapEntryOut, +1>::InvalidTime();
+	// sort the (up to three) axis values
+	if (cnt>1 && a[1] < a[0]) std::swap(a[0], a[1]);
+	if (cnt>2) {
+		if (a[2] < a[1]) std::swap(a[1], a[2]);
+		if (a[1] < a[0]) std::swap(a[0], a[1]);
+	}
+
+	// only use the next axis if the result would be upwind of it
+	Real t = a[0] + 1.;
+	if (cnt>1 && t > a[1]) {
+		const Real csqrt = max(0. , 2.-(a[1]-a[0])*(a[1]-a[0]) );
+		t = 0.5*( a[0]+a[1]+ sqrt(csqrt) );
+		if (cnt>2 && t > a[2]) {
+			const Real ca=a[0], cb=a[1], cc=a[2];
+			const Real csqrt = max(0. , 
+					-2.*(ca*ca+cb*cb- cb*cc + cc*cc - ca*(cb+cc)) + 3 );
+			t = 0.333333*( ca+cb+cc+ sqrt(csqrt) );
+		}
+	}
+	return t;
+}
+
+static const Real FimEpsilon = 1e-5;
+
+//! new values of the active cells, only reads the values of the previous iteration
+KERNEL(pts)
+void knFimUpdate(const std::vector<IndexInt>& active, const Grid<Real>& phi, const Grid<int>& fmFlags, 
+		const int tdir, std::vector<Real>& newVal) {
+	const IndexInt c = active[idx];
+	newVal[idx] = tdir * std::min( fimSolve(phi, fmFlags, c, tdir), tdir * phi[c] );
+}
+
+KERNEL(pts)
+void knFimApply(const std::vector<IndexInt>& active, const std::vector<Real>& newVal, Grid<Real>& phi, 
+		Grid<int>& fmFlags, std::vector<char>& converged, const int flagReached) {
+	const IndexInt c = active[idx];
+	converged[idx] = fabs(phi[c] - newVal[idx]) <= FimEpsilon;
+	phi[c] = newVal[idx];
+	if (converged[idx]) fmFlags[c] = flagReached;
+}
+
+//! neighbors of converged cells that are reached or improved, up to 6 per cell
+KERNEL(pts)
+void knFimExpand(const std::vector<IndexInt>& active, const std::vector<char>& converged, const Grid<Real>& phi, 
+		const Grid<int>& fmFlags, const int tdir, const Real maxTime, const int flagInited, const int flagOnList,
+		std::vector<IndexInt>& cand, std::vector<Real>& candVal) {
+	for (int nb=0; nb<6; nb++) cand[6*idx+nb] = -1;
+	if (!converged[idx]) return;
+	const IndexInt c = active[idx];
+	// discard by source time, as in addToList
+	if (tdir * phi[c] > maxTime) return;
+
+	const IndexInt stride[3] = { 1, phi.getSizeX(), phi.getStrideZ() };
+	const IndexInt sx = phi.getSizeX(), sxy = sx * phi.getSizeY();
+	const Vec3i p( c % sx, (c % sxy) / sx, c / sxy );
+	const int dim = phi.is3D() ? 3 : 2;
+	for (int nb=0; nb<2*dim; nb++) {
+		Vec3i pn(p);
+		pn[nb/2] += (nb%2) ? 1 : -1;
+		if (!phi.isInBounds(pn,1)) continue;
+		const IndexInt n = c + ((nb%2) ? 1 : -1) * stride[nb/2];
+		const int f = fmFlags[n];
+		if (f == flagInited || f == flagOnList) continue;
+
+		const Real u = fimSolve(phi, fmFlags, n, tdir);
+		if (f == 0 || u < tdir * phi[n] - FimEpsilon) {
+			cand[6*idx+nb]    = n;
+			candVal[6*idx+nb] = tdir * u;
+		}
+	}
+}
+
+//! cells added by addToList, per z-slice (y-row in 2D)
+KERNEL(pts)
+void knFimCollectActive(std::vector< std::vector<IndexInt> >& slabCells, const Grid<int>& fmFlags, const int flagOnList) {
+	std::vector<IndexInt>& cells = slabCells[idx];
+	const int k0 = fmFlags.is3D() ? idx : 0,   j0 = fmFlags.is3D() ? 0 : idx;
+	const int k1 = fmFlags.is3D() ? idx+1 : 1, j1 = fmFlags.is3D() ? fmFlags.getSizeY() : idx+1;
+	for (int k=k0; k<k1; k++) 
+	for (int j=j0; j<j1; j++) 
+	for (int i=0; i<fmFlags.getSizeX(); i++) {
+		if (fmFlags(i,j,k) == flagOnList) cells.push_back(fmFlags.index(i,j,k));
+	}
+}
+
+KERNEL(idx)
+void knFimFinish(Grid<int>& fmFlags, const int flagReached, const int flagInited) {
+	if (fmFlags[idx] == flagReached) fmFlags[idx] = flagInited;
+}
+
+template<class COMP, int TDIR>
+void FastMarch<COMP,TDIR>::performIterativeMarching() {
+	// velocity transport relies on the order in which cells are accepted
+	if (mVelTransport.isInitialized()) {
+		performMarching();
+		return;
+	}
+	mHeap = std::priority_queue<COMP, std::vector<COMP>, std::less<COMP> >();
+
+	std::vector< std::vector<IndexInt> > slabCells( mLevelset.is3D() ? mLevelset.getSizeZ() : mLevelset.getSizeY() );
+	knFimCollectActive( slabCells, mFmFlags, FlagIsOnHeap );
+	std::vector<IndexInt> active;
+	for (size_t s=0; s<slabCells.size(); s++) 
+		active.insert(active.end(), slabCells[s].begin(), slabCells[s].end());
+
+	std::vector<Real> newVal, candVal;
+	std::vector<IndexInt> cand, next;
+	std::vector<char> converged;
+	int iter = 0;
+	while (!active.empty()) {
+		newVal.resize(active.size());
+		converged.resize(active.size());
+		cand.resize(6*active.size());
+		candVal.resize(6*active.size());
+		knFimUpdate( active, mLevelset, mFmFlags, TDIR, newVal );
+		knFimApply ( active, newVal, mLevelset, mFmFlags, converged, FlagIsReached );
+		knFimExpand( active, converged, mLevelset, mFmFlags, TDIR, fabs(mMaxTime), FlagInited, FlagIsOnHeap, cand, candVal );
+
+		// next active list, cells that didn't converge yet and the new ones
+		next.clear();
+		for (size_t l=0; l<active.size(); l++) 
+			if (!converged[l]) next.push_back(active[l]);
+		for (size_t l=0; l<cand.size(); l++) {
+			const IndexInt n = cand[l];
+			if (n<0 || mFmFlags[n] == FlagIsOnHeap) continue;
+			mFmFlags[n]  = FlagIsOnHeap;
+			mLevelset[n] = candVal[l];
+			next.push_back(n);
+		}
+		active.swap(next);
+		iter++;
+	}
+	debMsg("FastMarch::performIterativeMarching done after "<<iter<<" iterations", 2);
+	knFimFinish( mFmFlags, FlagIsReached, FlagInited );
+
+	// set boundary for plain array
+	SetLevelsetBoundaries setls(mLevelset); 
+	setls.getArg0(); // get rid of compiler warning...
+}
+
 // explicit instantiation
 template class FastMarch<FmHeapEntryIn, -1>;
 template class FastMarch<FmHeapEntryOut, +1>;
@@ -227,35 +389,137 @@ template class FastMarch<FmHeapEntryOut, +1>;
 
 /*****************************************************************************/
 // simpler extrapolation functions (primarily for FLIP)
+// they grow layer by layer from a frontier, each layer only visits the cells next to 
+// the previous one, so the cost scales with the surface instead of the domain size
 
-KERNEL(bnd=1)
-void knExtrapolateMACSimple (MACGrid& vel, int distance , Grid<int>& tmp , const int d , const int c ) 
+static const Vec3i nb[6] = { 
+	Vec3i(1 ,0,0), Vec3i(-1,0,0),
+	Vec3i(0,1 ,0), Vec3i(0,-1,0),
+	Vec3i(0,0,1 ), Vec3i(0,0,-1) };
+
+//! position of a grid index
+static inline Vec3i frontierPos(const GridBase& g, const IndexInt idx) {
+	const IndexInt sx = g.getSizeX(), sxy = sx * g.getSizeY();
+	return Vec3i( idx % sx, (idx % sxy) / sx, idx / sxy );
+}
+
+//! cells are collected per z-slice (y-row in 2D), and joined in order afterwards
+static inline int frontierSlabs(const GridBase& g) { return g.is3D() ? g.getSizeZ() : g.getSizeY(); }
+
+static inline void frontierSlabRange(const GridBase& g, const int s, int& j0, int& j1, int& k0, int& k1) {
+	k0 = g.is3D() ? s   : 0; j0 = g.is3D() ? 0 : s;
+	k1 = g.is3D() ? s+1 : 1; j1 = g.is3D() ? g.getSizeY() : s+1;
+}
+
+static void joinSlabCells(const std::vector< std::vector<IndexInt> >& slabCells, std::vector<IndexInt>& cells) {
+	size_t num = 0;
+	for (size_t s=0; s<slabCells.size(); s++) num += slabCells[s].size();
+	cells.clear();
+	cells.reserve(num);
+	for (size_t s=0; s<slabCells.size(); s++) 
+		cells.insert(cells.end(), slabCells[s].begin(), slabCells[s].end());
+}
+
+//! MAC version, one frontier for all components: weight(p)[c] holds the layer of component c,
+//! 0 for cells that are not extrapolated yet
+
+static inline bool isMACFrontier(const Grid<Vec3>& mark, const Vec3i& p, const int dim) {
+	for (int c=0; c<dim; ++c) {
+		if (mark(p)[c] != 1.) continue;
+		for (int n=0; n<2*dim; ++n) {
+			const Vec3i pn(p + nb[n]);
+			if (mark.isInBounds(pn,1) && mark(pn)[c] == 0.) return true;
+		}
+	}
+	return false;
+}
+
+KERNEL(pts)
+void knCollectFrontierMAC ( std::vector< std::vector<IndexInt> >& slabCells, const Grid<Vec3>& mark, const int dim ) 
 {
-	static const Vec3i nb[6] = { 
-		Vec3i(1 ,0,0), Vec3i(-1,0,0),
-		Vec3i(0,1 ,0), Vec3i(0,-1,0),
-		Vec3i(0,0,1 ), Vec3i(0,0,-1) };
-	const int dim = (vel.is3D() ? 3:2);
+	int j0, j1, k0, k1;
+	frontierSlabRange(mark, idx, j0, j1, k0, k1);
+	for (int k=k0; k<k1; k++) 
+	for (int j=j0; j<j1; j++) 
+	for (int i=0; i<mark.getSizeX(); i++) {
+		if (isMACFrontier(mark, Vec3i(i,j,k), dim)) slabCells[idx].push_back(mark.index(i,j,k));
+	}
+}
 
-	if (tmp(i,j,k) != 0) return;
+KERNEL(pts)
+void knFlagFrontierMACBand ( const LevelsetBand& band, const Grid<Vec3>& mark, const int dim, std::vector<char>& isFrontier ) 
+{
+	isFrontier[idx] = isMACFrontier(mark, band.getPos(idx), dim);
+}
 
-	// copy from initialized neighbors
-	Vec3i p(i,j,k);
-	int nbs = 0;
-	Real avgVel = 0.;
+//! neighbors of the frontier that are reached by layer d+1, and the components to extrapolate
+KERNEL(pts)
+void knExpandFrontierMAC ( const std::vector<IndexInt>& frontier, const Grid<Vec3>& mark, const Real d, const int dim, 
+		std::vector<IndexInt>& cand, std::vector<int>& candComp ) 
+{
+	const Vec3i p = frontierPos(mark, frontier[idx]);
+	for (int n=0; n<6; ++n) cand[6*idx+n] = -1;
 	for (int n=0; n<2*dim; ++n) {
-		if (tmp(p+nb[n]) == d) {
-			//vel(p)[c] = (c+1.)*0.1;
-			avgVel += vel(p+nb[n])[c];
-			nbs++;
+		const Vec3i pn(p + nb[n]);
+		if (!mark.isInBounds(pn,1)) continue;
+		int comp = 0;
+		for (int c=0; c<dim; ++c) {
+			if (mark(p)[c] == d && mark(pn)[c] == 0.) comp |= 1<<c;
+		}
+		if (comp) {
+			cand[6*idx+n]     = mark.index(pn);
+			candComp[6*idx+n] = comp;
 		}
 	}
+}
 
-	if(nbs>0) {
-		tmp(p)    = d+1;
+//! copy from initialized neighbors
+KERNEL(pts)
+void knExtrapolateFrontierMAC ( const std::vector<IndexInt>& cells, MACGrid& vel, const Grid<Vec3>& mark, const Real d, const int dim ) 
+{
+	const Vec3i p = frontierPos(vel, cells[idx]);
+	for (int c=0; c<dim; ++c) {
+		if (mark(p)[c] != d+1) continue;
+		int nbs = 0;
+		Real avgVel = 0.;
+		for (int n=0; n<2*dim; ++n) {
+			if (mark(p+nb[n])[c] == d) {
+				avgVel += vel(p+nb[n])[c];
+				nbs++;
+			}
+		}
 		vel(p)[c] = avgVel / nbs;
 	}
 }
+
+//! extrapolate all components for distance layers, starting at the frontier of layer 1
+static void extrapolateMACFrontier( MACGrid& vel, Grid<Vec3>& mark, std::vector<IndexInt>& frontier, const int distance ) 
+{
+	const int dim = (vel.is3D() ? 3:2);
+	std::vector<IndexInt> cand, next;
+	std::vector<int> candComp;
+	for(int d=1; d<1+distance && !frontier.empty(); ++d) {
+		cand.resize(6*frontier.size());
+		candComp.resize(6*frontier.size());
+		knExpandFrontierMAC( frontier, mark, d, dim, cand, candComp );
+
+		// new layer, a cell can be reached from several frontier cells
+		next.clear();
+		for (size_t l=0; l<cand.size(); ++l) {
+			const IndexInt n = cand[l];
+			if (n<0) continue;
+			bool listed = false;
+			for (int c=0; c<dim; ++c) {
+				if (mark[n][c] == d+1) listed = true;
+				else if (candComp[l] & (1<<c)) mark[n][c] = d+1;
+			}
+			if (!listed) next.push_back(n);
+		}
+		knExtrapolateFrontierMAC( next, vel, mark, d, dim );
+		frontier.swap(next);
+	}
+}
+
 // NT_DEBUG, todo - test w/o single threaded, should work...
 KERNEL(bnd=0, single)
 void knExtrapolateIntoBnd (FlagGrid& flags, MACGrid& vel)
@@ -333,36 +597,39 @@ void knUnprojectNormalComp (FlagGrid& flags, MACGrid& vel, Grid<Real>& phi, Real
 // (note, less accurate than fast marching extrapolation.)
 // into obstacle is a special mode for second order obstable boundaries (extrapolating
 // only fluid velocities, not those at obstacles)
-PYTHON() void extrapolateMACSimple (FlagGrid& flags, MACGrid& vel, int distance, 
-		LevelsetGrid* phiObs, bool intoObs) 
-{
-	Grid<int> tmp( flags.getParent() );
-	int dim = (flags.is3D() ? 3:2);
 
-	for(int c=0; c<dim; ++c) {
+KERNEL(bnd=1)
+void knMarkMACSimple ( const FlagGrid& flags, Grid<Vec3>& mark, const bool intoObs ) 
+{
+	const int dim = (flags.is3D() ? 3:2);
+	const Vec3i p(i,j,k);
+	for (int c=0; c<dim; ++c) {
 		Vec3i dir = 0;
 		dir[c] = 1;
-		tmp.clear();
-
-		// remove all fluid cells (not touching obstacles)
-		FOR_IJK_BND(flags,1) {
-			Vec3i p(i,j,k);
-			bool mark = false;
-			if(!intoObs) {
-				if( flags.isFluid(p) || flags.isFluid(p-dir) ) mark = true;
-			} else {
-				if( (flags.isFluid(p) || flags.isFluid(p-dir) ) && 
-					(!flags.isObstacle(p)) && (!flags.isObstacle(p-dir)) ) mark = true;
-			}
-
-			if(mark) tmp(p) = 1;
+		// all fluid faces (not touching obstacles)
+		bool m = false;
+		if(!intoObs) {
+			if( flags.isFluid(p) || flags.isFluid(p-dir) ) m = true;
+		} else {
+			if( (flags.isFluid(p) || flags.isFluid(p-dir) ) && 
+				(!flags.isObstacle(p)) && (!flags.isObstacle(p-dir)) ) m = true;
 		}
-		
-		// extrapolate for distance
-		for(int d=1; d<1+distance; ++d) {
-			knExtrapolateMACSimple(vel, distance, tmp, d, c);
-		} // d
+		mark(p)[c] = m ? 1. : 0.;
 	}
+}
+
+PYTHON() void extrapolateMACSimple (FlagGrid& flags, MACGrid& vel, int distance, 
+		LevelsetGrid* phiObs, bool intoObs) 
+{
+	Grid<Vec3> mark( flags.getParent() );
+	knMarkMACSimple( flags, mark, intoObs );
+
+	// extrapolate for distance
+	std::vector< std::vector<IndexInt> > slabCells( frontierSlabs(flags) );
+	knCollectFrontierMAC( slabCells, mark, (flags.is3D() ? 3:2) );
+	std::vector<IndexInt> frontier;
+	joinSlabCells( slabCells, frontier );
+	extrapolateMACFrontier( vel, mark, frontier, distance );
 
 	if(phiObs) {
 		knUnprojectNormalComp( flags, vel, *phiObs, distance );
@@ -373,30 +640,19 @@ PYTHON() void extrapolateMACSimple (FlagGrid& flags, MACGrid& vel, int distance,
 }
 
 KERNEL(bnd=1)
-void knExtrapolateMACFromWeight ( MACGrid& vel, Grid<Vec3>& weight, int distance , const int d, const int c ) 
+void knResetWeight ( Grid<Vec3>& weight, const int dim ) 
 {
-	static const Vec3i nb[6] = { 
-		Vec3i(1 ,0,0), Vec3i(-1,0,0),
-		Vec3i(0,1 ,0), Vec3i(0,-1,0),
-		Vec3i(0,0,1 ), Vec3i(0,0,-1) };
-	const int dim = (vel.is3D() ? 3:2);
-
-	if (weight(i,j,k)[c] != 0) return;
-
-	// copy from initialized neighbors
-	Vec3i p(i,j,k);
-	int nbs = 0;
-	Real avgVel = 0.;
-	for (int n=0; n<2*dim; ++n) {
-		if (weight(p+nb[n])[c] == d) {
-			avgVel += vel(p+nb[n])[c];
-			nbs++;
-		}
+	for (int c=0; c<dim; ++c) {
+		if(weight(i,j,k)[c]>0.) weight(i,j,k)[c] = 1.0;
 	}
+}
 
-	if(nbs>0) {
-		weight(p)[c]    = d+1;
-		vel(p)[c] = avgVel / nbs;
+KERNEL(pts)
+void knResetWeightBand ( const LevelsetBand& band, Grid<Vec3>& weight, const int dim ) 
+{
+	if (!weight.isInBounds(band.getPos(idx),1)) return;
+	for (int c=0; c<dim; ++c) {
+		if(weight[band[idx]][c]>0.) weight[band[idx]][c] = 1.0;
 	}
 }
 
@@ -405,43 +661,84 @@ void knExtrapolateMACFromWeight ( MACGrid& vel, Grid<Vec3>& weight, int distance
 // note - the weight grid values are destroyed! the function is necessary due to discrepancies
 // between velocity mapping on surface-levelset / fluid-flag creation. With this
 // extrapolation we make sure the fluid region is covered by initial velocities
-PYTHON() void extrapolateMACFromWeight(MACGrid& vel, Grid<Vec3>& weight, int distance)
+// with band, the initial layer is only searched in the band cells, the band has to 
+// extend distance cells beyond the particles
+PYTHON() void extrapolateMACFromWeight(MACGrid& vel, Grid<Vec3>& weight, int distance, const LevelsetBand* band)
 {
 	const int dim = (vel.is3D() ? 3:2);
 
-	for(int c=0; c<dim; ++c) {
-		Vec3i dir = 0;
-		dir[c] = 1;
+	// reset weight values to 0 (uninitialized), and 1 (initialized inner values)
+	std::vector<IndexInt> frontier;
+	if(band) {
+		knResetWeightBand(*band, weight, dim);
+		std::vector<char> isFrontier( band->size() );
+		knFlagFrontierMACBand( *band, weight, dim, isFrontier );
+		for (IndexInt n=0; n<band->size(); ++n) 
+			if (isFrontier[n]) frontier.push_back( (*band)[n] );
+	} else {
+		knResetWeight(weight, dim);
+		std::vector< std::vector<IndexInt> > slabCells( frontierSlabs(vel) );
+		knCollectFrontierMAC( slabCells, weight, dim );
+		joinSlabCells( slabCells, frontier );
+	}
 
-		// reset weight values to 0 (uninitialized), and 1 (initialized inner values)
-		FOR_IJK_BND(vel,1) {
-			Vec3i p(i,j,k);
-			if(weight(p)[c]>0.) weight(p)[c] = 1.0;
-		}
-		
-		// extrapolate for distance
-		for(int d=1; d<1+distance; ++d) {
-			knExtrapolateMACFromWeight(vel, weight, distance, d, c);
-		} // d
+	// extrapolate for distance
+	extrapolateMACFrontier( vel, weight, frontier, distance );
+}
+
+// simple extrapolation functions for levelsets
+
+KERNEL(bnd=1)
+void knMarkSide (const Grid<Real>& phi, Grid<int>& tmp, const bool inside)
+{
+	if ( inside ? (phi(i,j,k) > 0.) : (phi(i,j,k) < 0.) ) tmp(i,j,k) = 1;
+}
 
+//! first layer around the marked cells
+KERNEL(pts)
+void knCollectFirstLayer (std::vector< std::vector<IndexInt> >& slabCells, const Grid<int>& tmp)
+{
+	const int dim = (tmp.is3D() ? 3:2); 
+	int j0, j1, k0, k1;
+	frontierSlabRange(tmp, idx, j0, j1, k0, k1);
+	for (int k=k0; k<k1; k++) 
+	for (int j=j0; j<j1; j++) 
+	for (int i=0; i<tmp.getSizeX(); i++) {
+		const Vec3i p(i,j,k);
+		if ( !tmp.isInBounds(p,1) || tmp(p) ) continue;
+		for (int n=0; n<2*dim; ++n) {
+			if (tmp(p+nb[n])==1) {
+				slabCells[idx].push_back(tmp.index(p)); break;
+			}
+		}
 	}
 }
 
-// simple extrapolation functions for levelsets
+KERNEL(pts)
+void knSetLayer (const std::vector<IndexInt>& cells, Grid<int>& tmp, const int d)
+{
+	tmp[cells[idx]] = d;
+}
 
-static const Vec3i nb[6] = { 
-	Vec3i(1 ,0,0), Vec3i(-1,0,0),
-	Vec3i(0,1 ,0), Vec3i(0,-1,0),
-	Vec3i(0,0,1 ), Vec3i(0,0,-1) };
+KERNEL(pts)
+void knExpandFrontier (const std::vector<IndexInt>& frontier, const Grid<int>& tmp, std::vector<IndexInt>& cand)
+{
+	const int dim = (tmp.is3D() ? 3:2); 
+	const Vec3i p = frontierPos(tmp, frontier[idx]);
+	for (int n=0; n<6; ++n) cand[6*idx+n] = -1;
+	for (int n=0; n<2*dim; ++n) {
+		const Vec3i pn(p + nb[n]);
+		if (tmp.isInBounds(pn,1) && tmp(pn) == 0) cand[6*idx+n] = tmp.index(pn);
+	}
+}
 
-KERNEL(bnd=1) template<class S>
-void knExtrapolateLsSimple (Grid<S>& val, int distance , Grid<int>& tmp , const int d , S direction )
+KERNEL(pts) template<class S>
+void knExtrapolateFrontier (const std::vector<IndexInt>& cells, Grid<S>& val, const Grid<int>& tmp, const int d, S direction)
 {
 	const int dim = (val.is3D() ? 3:2); 
-	if (tmp(i,j,k) != 0) return;
+	const Vec3i p = frontierPos(val, cells[idx]);
 
 	// copy from initialized neighbors
-	Vec3i p(i,j,k);
 	int   nbs = 0;
 	S     avg(0.);
 	for (int n=0; n<2*dim; ++n) {
@@ -450,14 +747,9 @@ void knExtrapolateLsSimple (Grid<S>& val, int distance , Grid<int>& tmp , const
 			nbs++;
 		}
 	}
-
-	if(nbs>0) {
-		tmp(p) = d+1;
-		val(p) = avg / nbs + direction;
-	} 
+	val(p) = avg / nbs + direction;
 }
 
-
 KERNEL(bnd=1) template<class S>
 void knSetRemaining (Grid<S>& phi, Grid<int>& tmp, S distance )
 {
@@ -465,40 +757,42 @@ void knSetRemaining (Grid<S>& phi, Grid<int>& tmp, S distance )
 	phi(i,j,k) = distance;
 }
 
+//! mark the first layer around the cells with tmp=1 as 2, and extrapolate from there for distance
+template<class S>
+static void extrapolateFrontier(Grid<S>& val, Grid<int>& tmp, const int distance, S direction)
+{
+	std::vector< std::vector<IndexInt> > slabCells( frontierSlabs(tmp) );
+	knCollectFirstLayer( slabCells, tmp );
+	std::vector<IndexInt> frontier, cand, next;
+	joinSlabCells( slabCells, frontier );
+	knSetLayer( frontier, tmp, 2 );
+
+	for(int d=2; d<1+distance && !frontier.empty(); ++d) {
+		cand.resize(6*frontier.size());
+		knExpandFrontier( frontier, tmp, cand );
+		next.clear();
+		for (size_t l=0; l<cand.size(); ++l) {
+			const IndexInt n = cand[l];
+			if (n<0 || tmp[n] != 0) continue;
+			tmp[n] = d+1;
+			next.push_back(n);
+		}
+		knExtrapolateFrontier<S>( next, val, tmp, d, direction );
+		frontier.swap(next);
+	} 
+}
+
 PYTHON() void extrapolateLsSimple(Grid<Real>& phi, int distance, bool inside)
 {
 	Grid<int> tmp( phi.getParent() );
 	tmp.clear();
-	const int dim = (phi.is3D() ? 3:2);
-
-	// by default, march outside
-	Real direction = 1.;
-	if(!inside) { 
-		// mark all inside
-		FOR_IJK_BND(phi,1) {
-			if ( phi(i,j,k) < 0. ) { tmp(i,j,k) = 1; }
-		} 
-	} else {
-		direction = -1.;
-		FOR_IJK_BND(phi,1) {
-			if ( phi(i,j,k) > 0. ) { tmp(i,j,k) = 1; }
-		} 
-	}
-	// + first layer around
-	FOR_IJK_BND(phi,1) {
-		Vec3i p(i,j,k);
-		if ( tmp(p) ) continue;
-		for (int n=0; n<2*dim; ++n) {
-			if (tmp(p+nb[n])==1) {
-				tmp(i,j,k) = 2; n=2*dim;
-			}
-		}
-	} 
 
-	// extrapolate for distance
-	for(int d=2; d<1+distance; ++d) {
-		knExtrapolateLsSimple<Real>(phi, distance, tmp, d, direction );
-	} 
+	// by default, march outside (mark all inside)
+	const Real direction = inside ? -1. : 1.;
+	knMarkSide( phi, tmp, inside );
+
+	// + first layer around, and extrapolate for distance
+	extrapolateFrontier<Real>( phi, tmp, distance, direction );
 
 	// set all remaining cells to max
 	knSetRemaining<Real>(phi, tmp, Real(direction * (distance+2)) );
@@ -509,26 +803,10 @@ PYTHON() void extrapolateVec3Simple(Grid<Vec3>& vel, Grid<Real>& phi, int distan
 {
 	Grid<int> tmp( vel.getParent() );
 	tmp.clear();
-	const int dim = (vel.is3D() ? 3:2);
 
-	// mark all inside
-	FOR_IJK_BND(vel,1) {
-		if ( phi(i,j,k) < 0. ) { tmp(i,j,k) = 1; }
-	} 
-	// + first layer outside
-	FOR_IJK_BND(vel,1) {
-		Vec3i p(i,j,k);
-		if ( tmp(p) ) continue;
-		for (int n=0; n<2*dim; ++n) {
-			if (tmp(p+nb[n])==1) {
-				tmp(i,j,k) = 2; n=2*dim;
-			}
-		}
-	} 
-
-	for(int d=2; d<1+distance; ++d) {
-		knExtrapolateLsSimple<Vec3>(vel, distance, tmp, d, Vec3(0.) );
-	} 
+	// mark all inside, + first layer outside, and extrapolate for distance
+	knMarkSide( phi, tmp, false );
+	extrapolateFrontier<Vec3>( vel, tmp, distance, Vec3(0.) );
 	knSetRemaining<Vec3>(vel, tmp, Vec3(0.) );
 }
 
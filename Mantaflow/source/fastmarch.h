@@ -134,13 +134,17 @@ public:
 	static inline Real InvalidTime() { return -1000; }
 	static inline Real InvtOffset() { return 500; }
 
-	enum SpecialValues { FlagInited = 1, FlagIsOnHeap = 2};
+	enum SpecialValues { FlagInited = 1, FlagIsOnHeap = 2, FlagIsReached = 4 /* fast iterative method only */ };
 
 	FastMarch(FlagGrid& flags, Grid<int>& fmFlags, Grid<Real>& levelset, Real maxTime, MACGrid* velTransport = NULL);
 	~FastMarch() {}
 	
 	//! advect level set function with given velocity */
 	void performMarching();
+	//! same result as performMarching (up to the upwind neighbor choice), computed with the fast 
+	//! iterative method: all cells on the list are updated in parallel until they converge, 
+	//! independent of the number of threads. Falls back to performMarching with velocity transport
+	void performIterativeMarching();
 
 	//! test value for invalidity
 	inline bool isInvalid(Real v) const { return (v <= InvalidTime()); }
@@ -180,7 +184,7 @@ protected:
 #if NOPYTHON==1
 void extrapolateMACSimple(FlagGrid& flags, MACGrid& vel, int distance = 4, LevelsetGrid* phiObs = NULL, bool intoObs = false);
 
-void extrapolateMACFromWeight(MACGrid& vel, Grid<Vec3>& weight, int distance = 2);
+void extrapolateMACFromWeight(MACGrid& vel, Grid<Vec3>& weight, int distance = 2, const LevelsetBand* band = NULL);
 
 void extrapolateLsSimple(Grid<Real>& phi, int distance = 4, bool inside = false);
 
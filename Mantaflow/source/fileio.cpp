@@ -1084,7 +1084,7 @@ void writeParticlesUni(const std::string& name, BasicParticleSystem* parts ) {
 	// warning - hard coded conversion of byte size here...
 	gzwrite(gzf, &head, sizeof(UniPartHeader));
 	for(int i=0; i<parts->size(); ++i) {
-		Vector3D<float> pos  = toVec3f( (*parts)[i].pos );
+		Vector3D<float> pos  = toVec3f( parts->getPos(i) );
 		int             flag = (*parts)[i].flag;
 		gzwrite(gzf, &pos , sizeof(Vector3D<float>) );
 		gzwrite(gzf, &flag, sizeof(int)             );
@@ -1092,7 +1092,10 @@ void writeParticlesUni(const std::string& name, BasicParticleSystem* parts ) {
 #	else
 	assertMsg( sizeof(BasicParticleData) == PartSysSize, "particle data size doesn't match" );
 	gzwrite(gzf, &head, sizeof(UniPartHeader));
-	gzwrite(gzf, &(parts->getData()[0]), PartSysSize*head.dim);
+	// interleave positions and flags, as in BasicParticleData
+	std::vector<BasicParticleData> buf(head.dim);
+	for(IndexInt i=0; i<(IndexInt)buf.size(); ++i) buf[i] = (*parts)[i];
+	gzwrite(gzf, &buf[0], PartSysSize*head.dim);
 #	endif
 	gzclose(gzf);
 #	else
@@ -1127,14 +1130,16 @@ void readParticlesUni(const std::string& name, BasicParticleSystem* parts ) {
 			Vector3D<float> pos; int flag;
 			gzread(gzf, &pos , sizeof(Vector3D<float>) );
 			gzread(gzf, &flag, sizeof(int)             );
-			(*parts)[i].pos  = toVec3d(pos);
+			parts->setPos(i, toVec3d(pos));
 			(*parts)[i].flag = flag;
 		}
 #		else
 		assertMsg( sizeof(BasicParticleData) == PartSysSize, "particle data size doesn't match" );
 		IndexInt bytes     = PartSysSize*head.dim;
-		IndexInt readBytes = gzread(gzf, &(parts->getData()[0]), bytes);
+		std::vector<BasicParticleData> buf(head.dim);
+		IndexInt readBytes = gzread(gzf, &buf[0], bytes);
 		assertMsg( bytes==readBytes, "can't read uni file, stream length does not match, "<<bytes<<" vs "<<readBytes );
+		for(IndexInt i=0; i<(IndexInt)buf.size(); ++i) (*parts)[i] = buf[i];
 #		endif
 
 		parts->transformPositions( Vec3i(head.dimX,head.dimY,head.dimZ), parts->getParent()->getGridSize() );
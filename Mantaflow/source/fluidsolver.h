@@ -64,6 +64,8 @@ public:
     Real getTimeStep() const { return mDt; }
     Real getTimeTotal() const { return mTimeTotal; }
     int  getFrame() const { return mFrame; }
+    //! number of step() calls so far, counts every substep of a frame
+    int  getStepCount() const { return mStepCount; }
     void setTimeStep(Real timestep) { mDt = timestep; }
     void setTimeTotal(Real timetotal) { mTimeTotal = timetotal; }
     void setFrame(int frame) { mFrame = frame; }
@@ -79,6 +81,7 @@ protected:
 	const int mDim;
 	Real      mTimePerFrame;
 	bool      mLockDt;
+	int       mStepCount;
 		
 	//! subclass for managing grid memory
 	//! stored as a stack to allow fast allocation
@@ -18,6 +18,7 @@
 #include <sstream>
 #include <cstring>
 #include "fileio.h"
+#include "unionfind.h"
 
 using namespace std;
 namespace Manta {
@@ -692,6 +693,82 @@ void FlagGrid::fillGrid(int type) {
 	}
 }
 
+//******************************************************************************
+// Connected components
+
+KERNEL() void knUniteFlagCells(const FlagGrid& flags, UnionFind& uf, const int type) {
+	const IndexInt idx = flags.index(i,j,k);
+	if (!(flags[idx] & type)) return;
+	// each face is handled by the cell with the higher index
+	if (i>0 && (flags[idx-flags.getStrideX()] & type)) uf.unite(idx, idx-flags.getStrideX());
+	if (j>0 && (flags[idx-flags.getStrideY()] & type)) uf.unite(idx, idx-flags.getStrideY());
+	if (k>0 && (flags[idx-flags.getStrideZ()] & type)) uf.unite(idx, idx-flags.getStrideZ());
+}
+
+KERNEL(idx) void knFindFlagRoots(const FlagGrid& flags, Grid<int>& label, UnionFind& uf, const int type) {
+	label[idx] = (flags[idx] & type) ? uf.find(idx) : -1;
+}
+
+KERNEL(idx) void knRootToComponent(Grid<int>& label, const vector<int>& rootId) {
+	if (label[idx] >= 0) label[idx] = rootId[label[idx]];
+}
+
+KERNEL(pts) void knFlagComponentBounds(vector<int>& cells, vector<Vec3i>& bbMin, vector<Vec3i>& bbMax, 
+		const vector<IndexInt>& start, const vector<IndexInt>& list, const Grid<int>& label) {
+	cells[idx] = start[idx+1] - start[idx];
+	const IndexInt sx = label.getSizeX(), sxy = sx * label.getSizeY();
+	Vec3i lo(std::numeric_limits<int>::max()), hi(-1);
+	for (IndexInt n=start[idx]; n<start[idx+1]; n++) {
+		const IndexInt c = list[n];
+		const Vec3i p(c % sx, (c % sxy) / sx, c / sxy);
+		for (int d=0; d<3; d++) {
+			lo[d] = std::min(lo[d], p[d]);
+			hi[d] = std::max(hi[d], p[d]);
+		}
+	}
+	bbMin[idx] = lo;
+	bbMax[idx] = hi;
+}
+
+int computeFlagComponents(const FlagGrid& flags, Grid<int>& label, GridComponents& comps, int type) {
+	const IndexInt numCells = flags.getSizeX() * flags.getSizeY() * flags.getSizeZ();
+	assertMsg(numCells < std::numeric_limits<int>::max(), "grid too large for component labels");
+	
+	// union over shared faces, the root of each set is its first cell
+	UnionFind uf(numCells);
+	knUniteFlagCells(flags, uf, type);
+	knFindFlagRoots(flags, label, uf, type);
+	
+	vector<int> rootId(numCells, -1);
+	int num = 0;
+	for (IndexInt idx=0; idx<numCells; idx++) 
+		if (label[idx] == idx) rootId[idx] = num++;
+	knRootToComponent(label, rootId);
+	
+	// bucket the cells by component, then sizes and bounds per component
+	vector<IndexInt> start(num+1, 0), list;
+	for (IndexInt idx=0; idx<numCells; idx++) 
+		if (label[idx] >= 0) start[label[idx]+1]++;
+	for (int n=0; n<num; n++) 
+		start[n+1] += start[n];
+	vector<IndexInt> fill(start.begin(), start.end()-1);
+	list.resize(start[num]);
+	for (IndexInt idx=0; idx<numCells; idx++) 
+		if (label[idx] >= 0) list[fill[label[idx]]++] = idx;
+	
+	comps.size.resize(num);
+	comps.bbMin.resize(num);
+	comps.bbMax.resize(num);
+	knFlagComponentBounds(comps.size, comps.bbMin, comps.bbMax, start, list, label);
+	return num;
+}
+
+//! label connected regions of cells with the given flag type, e.g. separate liquid bodies and drops
+PYTHON() int labelFlagComponents(const FlagGrid& flags, Grid<int>& label, int type=FlagGrid::TypeFluid) {
+	GridComponents comps;
+	return computeFlagComponents(flags, label, comps, type);
+}
+
 // explicit instantiation
 template class Grid<int>;
 template class Grid<Real>;
@@ -138,6 +138,8 @@ public:
 	// interpolated access
 	inline T    getInterpolated(const Vec3& pos) const { return interpol<T>(mData, mSize, mStrideZ, pos); }
 	inline void setInterpolated(const Vec3& pos, const T& val, Grid<Real>& sumBuffer) const { setInterpol<T>(mData, mSize, mStrideZ, pos, val, &sumBuffer[0]); }
+	//! interpolate n<=INTERPOL_BATCH positions at once
+	inline void getInterpolatedBatch(const Vec3* pos, int n, T* out) const { interpolBatch<T>(mData, mSize, mStrideZ, pos, n, out); }
 	// higher order interpolation (1=linear, 2=cubic)
 	inline T getInterpolatedHi(const Vec3& pos, int order) const { 
 		switch(order) {
@@ -236,6 +238,8 @@ public:
 	// interpolation
 	inline Vec3 getInterpolated(const Vec3& pos) const { return interpolMAC(mData, mSize, mStrideZ, pos); }
 	inline void setInterpolated(const Vec3& pos, const Vec3& val, Vec3* tmp) { return setInterpolMAC(mData, mSize, mStrideZ, pos, val, tmp); }
+	inline void getInterpolatedBatch(const Vec3* pos, int n, Vec3* out) const { interpolMACBatch(mData, mSize, mStrideZ, pos, n, out); }
+	inline void getInterpolatedBatch(const InterpolWeightsBatchMAC& w, int n, Vec3* out) const { interpolMACBatch(mData, mSize, mStrideZ, w, n, out); }
 	inline Vec3 getInterpolatedHi(const Vec3& pos, int order) const { 
 		switch(order) {
 		case 1:  return interpolMAC     (mData, mSize, mStrideZ, pos); 
@@ -244,10 +248,11 @@ public:
 	}
 	// specials for mac grid:
 	template<int comp> inline Real getInterpolatedComponent(Vec3 pos) const { return interpolComponent<comp>(mData, mSize, mStrideZ, pos); }
+	template<int comp> inline void getInterpolatedComponentBatch(const Vec3* pos, int n, Real* out) const { interpolComponentBatch<comp>(mData, mSize, mStrideZ, pos, n, out); }
 	template<int comp> inline Real getInterpolatedComponentHi(const Vec3& pos, int order) const { 
 		switch(order) {
 		case 1:  return interpolComponent<comp>(mData, mSize, mStrideZ, pos); 
-		case 2:  return interpolCubicMAC(mData, mSize, mStrideZ, pos)[comp];  // warning - not yet optimized
+		case 2:  return interpolCubicMACComponent<comp>(mData, mSize, mStrideZ, pos);
 		default: assertMsg(false, "Unknown interpolation order "<<order); }
 	}
 
@@ -334,6 +339,17 @@ public:
 
 };
 
+//! face-connected components of the cells of a flag grid, numbered in order of their first cell
+struct GridComponents {
+	std::vector<int> size;
+	std::vector<Vec3i> bbMin, bbMax;
+	
+	inline int num() const { return (int)size.size(); }
+};
+
+//! label cells with (flags & type) by component, all other cells get -1. Returns the number of components
+int computeFlagComponents(const FlagGrid& flags, Grid<int>& label, GridComponents& comps, int type=FlagGrid::TypeFluid);
+
 //! helper to compute grid conversion factor between local coordinates of two grids
 inline Vec3 calcGridSizeFactor(Vec3i s1, Vec3i s2) {
 	return Vec3( Real(s1[0])/s2[0], Real(s1[1])/s2[1], Real(s1[2])/s2[2] );
@@ -16,6 +16,7 @@
 #include "kernel.h"
 #include "mcubes.h"
 #include "mesh.h"
+#include <algorithm>
 
 using namespace std;
 namespace Manta {
@@ -109,11 +110,39 @@ KERNEL(idx) void KnSubtract(Grid<Real>& a, const Grid<Real>& b) {
 } 
 void LevelsetGrid::subtract(const LevelsetGrid& o) { KnSubtract(*this, o); }
 
+//! collect the band cells of one z-slice (y-row in 2D)
+KERNEL(pts) 
+void KnCollectBand(std::vector< std::vector<IndexInt> >& slabCells, const Grid<Real>& phi, const Real inside, const Real outside) {
+	std::vector<IndexInt>& cells = slabCells[idx];
+	const int k0 = phi.is3D() ? idx : 0,   j0 = phi.is3D() ? 0 : idx;
+	const int k1 = phi.is3D() ? idx+1 : 1, j1 = phi.is3D() ? phi.getSizeY() : idx+1;
+	for (int k=k0; k<k1; k++) 
+	for (int j=j0; j<j1; j++) 
+	for (int i=0; i<phi.getSizeX(); i++) {
+		const IndexInt c = phi.index(i,j,k);
+		if (phi[c] >= -inside && phi[c] <= outside) cells.push_back(c);
+	}
+}
+
+void LevelsetBand::update(const Grid<Real>& phi, Real inside, Real outside) {
+	mSizeX   = phi.getSizeX();
+	mStrideZ = phi.getStrideZ();
+	std::vector< std::vector<IndexInt> > slabCells( phi.is3D() ? phi.getSizeZ() : phi.getSizeY() );
+	KnCollectBand( slabCells, phi, inside, outside );
+
+	size_t num = 0;
+	for (size_t s=0; s<slabCells.size(); s++) num += slabCells[s].size();
+	mCells.clear();
+	mCells.reserve(num);
+	for (size_t s=0; s<slabCells.size(); s++) 
+		mCells.insert(mCells.end(), slabCells[s].begin(), slabCells[s].end());
+}
+
 //! re-init levelset and extrapolate velocities (in & out)
 //  note - uses flags to identify border (could also be done based on ls values)
 static void doReinitMarch( Grid<Real>& phi,
 		FlagGrid& flags, Real maxTime, MACGrid* velTransport,
-		bool ignoreWalls, bool correctOuterLayer, int obstacleType )
+		bool ignoreWalls, bool correctOuterLayer, int obstacleType, bool fastIterative )
 {
 	const int dim = (phi.is3D() ? 3 : 2); 
 	Grid<int> fmFlags( phi.getParent() );
@@ -144,7 +173,8 @@ static void doReinitMarch( Grid<Real>& phi,
 			}            
 		}
 	}
-	marchIn.performMarching();     
+	if (fastIterative) marchIn.performIterativeMarching();
+	else               marchIn.performMarching();     
 	// done with inwards marching
    
 	// now march out...    
@@ -205,7 +235,8 @@ static void doReinitMarch( Grid<Real>& phi,
 			}
 		}
 	}    
-	marchOut.performMarching();
+	if (fastIterative) marchOut.performIterativeMarching();
+	else               marchOut.performMarching();
 
 	// set un initialized regions
 	SetUninitialized (flags, fmFlags, phi, +maxTime + 1., ignoreWalls, obstacleType);    
@@ -214,9 +245,9 @@ static void doReinitMarch( Grid<Real>& phi,
 //! call for levelset grids & external real grids
 
 void LevelsetGrid::reinitMarching( FlagGrid& flags, Real maxTime, MACGrid* velTransport,
-		bool ignoreWalls, bool correctOuterLayer, int obstacleType )
+		bool ignoreWalls, bool correctOuterLayer, int obstacleType, bool fastIterative )
 {
-	doReinitMarch( *this, flags, maxTime, velTransport, ignoreWalls, correctOuterLayer, obstacleType );
+	doReinitMarch( *this, flags, maxTime, velTransport, ignoreWalls, correctOuterLayer, obstacleType, fastIterative );
 }
 
 
@@ -229,7 +260,170 @@ void LevelsetGrid::initFromFlags(FlagGrid& flags, bool ignoreWalls) {
 	}
 }
 
+//************************************************************************
+// Marching cubes, parallel over x-slabs of cells (the outer loop of the serial traversal)
+// the vertex of a shared edge is created by the first cell in (i,j,k) order that uses it, 
+// so node and triangle numbering are the same as for a serial traversal
+
+//! cell with surface, idx: j*sizeZ+k within its slab (traversal order),
+//! created: bits of the edges whose vertex is created by this cell
+struct McCell {
+	IndexInt idx;
+	int cubeIdx, created, nodeBase;
+};
+
+//! the cells sharing the edge of axis mcEdgeAxis[e], relative to the edge base position, 
+//! in traversal order, and the local edge number in these cells
+static const int   mcEdgeAxis[12]  = { 0,1,0,1, 0,1,0,1, 2,2,2,2 };
+static const Vec3i mcEdgeBase[12]  = { Vec3i(0,0,0), Vec3i(1,0,0), Vec3i(0,1,0), Vec3i(0,0,0), 
+                                       Vec3i(0,0,1), Vec3i(1,0,1), Vec3i(0,1,1), Vec3i(0,0,1), 
+                                       Vec3i(0,0,0), Vec3i(1,0,0), Vec3i(1,1,0), Vec3i(0,1,0) };
+static const Vec3i mcEdgeCells[3][4] = { 
+	{ Vec3i(0,-1,-1), Vec3i(0,-1,0), Vec3i(0,0,-1), Vec3i(0,0,0) },
+	{ Vec3i(-1,0,-1), Vec3i(-1,0,0), Vec3i(0,0,-1), Vec3i(0,0,0) },
+	{ Vec3i(-1,-1,0), Vec3i(-1,0,0), Vec3i(0,-1,0), Vec3i(0,0,0) } };
+static const int   mcEdgeCellEdge[3][4] = { { 6,2,4,0 }, { 5,1,7,3 }, { 10,9,11,8 } };
+
+//! cells with invalid values are skipped
+static inline bool mcSkipCell(const Grid<Real>& phi, const Vec3i& c, const Real invalidTime) {
+	for (int l=0;l<8;l++) {
+		if (phi(c.x+cubieOffsetX[l], c.y+cubieOffsetY[l], c.z+cubieOffsetZ[l]) <= invalidTime) return true;
+	}
+	return false;
+}
+
+//! first cell in traversal order that uses edge e of cell c, and the edge number in that cell
+static inline void mcEdgeCreator(const Grid<Real>& phi, const Vec3i& c, const int e, const Real invalidTime, Vec3i& creator, int& creatorEdge) {
+	const int axis = mcEdgeAxis[e];
+	const Vec3i base = c + mcEdgeBase[e];
+	for (int n=0; n<4; n++) {
+		const Vec3i cn = base + mcEdgeCells[axis][n];
+		if (cn.x<0 || cn.y<0 || cn.z<0 || cn.x>=phi.getSizeX()-1 || cn.y>=phi.getSizeY()-1 || cn.z>=phi.getSizeZ()-1) continue;
+		if (cn != c && mcSkipCell(phi, cn, invalidTime)) continue;
+		creator = cn;
+		creatorEdge = mcEdgeCellEdge[axis][n];
+		return;
+	}
+	creator = c;
+	creatorEdge = e;
+}
+
+//! number of created vertices before edge e
+static inline int mcVertexRank(const int created, const int e) {
+	int r = 0;
+	for (int l=0; l<e; l++) if (created & (1<<l)) r++;
+	return r;
+}
+
+//! pass 1: cells with surface per slab, and their number of new vertices and triangles
+KERNEL(pts)
+void knMcClassify(std::vector< std::vector<McCell> >& slabCells, const Grid<Real>& phi, const Real isoValue, 
+		const Real invalidTime, std::vector<int>& numNodes, std::vector<int>& numTris) {
+	const int i = idx;
+	int nodes = 0, tris = 0;
+	for(int j=0; j<phi.getSizeY()-1; j++)
+	for(int k=0; k<phi.getSizeZ()-1; k++) {
+		const Vec3i c(i,j,k);
+		if (mcSkipCell(phi, c, invalidTime)) continue;
+		int cubeIdx = 0;
+		for (int l=0;l<8;l++) {
+			if (-phi(i+cubieOffsetX[l], j+cubieOffsetY[l], k+cubieOffsetZ[l]) < isoValue) 
+				cubeIdx |= 1<<l;
+		}
+		if (mcEdgeTable[cubeIdx] == 0) continue;
+
+		McCell cell;
+		cell.idx = (IndexInt)j*phi.getSizeZ() + k;
+		cell.cubeIdx = cubeIdx;
+		cell.created = 0;
+		cell.nodeBase = 0;
+		for (int e=0; e<12; e++) {
+			if (!(mcEdgeTable[cubeIdx] & (1<<e))) continue;
+			Vec3i creator; int creatorEdge;
+			mcEdgeCreator(phi, c, e, invalidTime, creator, creatorEdge);
+			if (creator == c) { cell.created |= 1<<e; nodes++; }
+		}
+		for(int e=0; mcTriTable[cubeIdx][e]!=-1; e+=3) tris++;
+		slabCells[idx].push_back(cell);
+	}
+	numNodes[idx] = nodes;
+	numTris[idx]  = tris;
+}
+
+//! interpolated isosurface vertex on edge e of cell c
+static inline void mcEdgeVertex(const Grid<Real>& phi, const Vec3i& c, const int e, const Real isoValue, Node& vertex) {
+	const int e1 = mcEdges[e*2  ];
+	const int e2 = mcEdges[e*2+1];
+	const Vec3i c1 = c + Vec3i(cubieOffsetX[e1], cubieOffsetY[e1], cubieOffsetZ[e1]);
+	const Vec3i c2 = c + Vec3i(cubieOffsetX[e2], cubieOffsetY[e2], cubieOffsetZ[e2]);
+	const Vec3 p1 = toVec3(c1);    // scalar field pos 1
+	const Vec3 p2 = toVec3(c2);    // scalar field pos 2
+	const float valp1  = -phi(c1);  // scalar field val 1
+	const float valp2  = -phi(c2);  // scalar field val 2
+	const float mu = (isoValue - valp1) / (valp2 - valp1);
+
+	// init isolevel vertex
+	vertex.pos = p1 + (p2-p1)*mu + Vec3(Real(0.5));
+	vertex.normal = getNormalized( 
+						getGradient( phi, c1.x, c1.y, c1.z) * (1.0-mu) +
+						getGradient( phi, c2.x, c2.y, c2.z) * (    mu)) ;
+}
+
+//! pass 2: create the vertices, starting at the node offset of the slab
+KERNEL(pts)
+void knMcCreateNodes(std::vector< std::vector<McCell> >& slabCells, const Grid<Real>& phi, const Real isoValue, 
+		const std::vector<int>& nodeOffset, Mesh& mesh) {
+	int nodeBase = nodeOffset[idx];
+	std::vector<McCell>& cells = slabCells[idx];
+	for (size_t n=0; n<cells.size(); n++) {
+		McCell& cell = cells[n];
+		cell.nodeBase = nodeBase;
+		const Vec3i c( idx, cell.idx / phi.getSizeZ(), cell.idx % phi.getSizeZ() );
+		for (int e=0; e<12; e++) {
+			if (cell.created & (1<<e)) 
+				mcEdgeVertex(phi, c, e, isoValue, mesh.nodes(nodeBase++));
+		}
+	}
+}
+
+static inline bool mcCellLess(const McCell& a, const McCell& b) { return a.idx < b.idx; }
+
+//! pass 3: create the triangles, vertices of other cells are looked up in the slab of their creator
+KERNEL(pts)
+void knMcCreateTris(const std::vector< std::vector<McCell> >& slabCells, const Grid<Real>& phi, const Real invalidTime,
+		const std::vector<int>& triOffset, Mesh& mesh) {
+	int tri = triOffset[idx];
+	const std::vector<McCell>& cells = slabCells[idx];
+	for (size_t n=0; n<cells.size(); n++) {
+		const McCell& cell = cells[n];
+		const Vec3i c( idx, cell.idx / phi.getSizeZ(), cell.idx % phi.getSizeZ() );
+		int triIndices[12];
+		for (int e=0; e<12; e++) {
+			if (!(mcEdgeTable[cell.cubeIdx] & (1<<e))) continue;
+			if (cell.created & (1<<e)) {
+				triIndices[e] = cell.nodeBase + mcVertexRank(cell.created, e);
+				continue;
+			}
+			Vec3i creator; int creatorEdge;
+			mcEdgeCreator(phi, c, e, invalidTime, creator, creatorEdge);
+			const std::vector<McCell>& other = slabCells[creator.x];
+			McCell key; 
+			key.idx = (IndexInt)creator.y*phi.getSizeZ() + creator.z;
+			const McCell& oc = *std::lower_bound(other.begin(), other.end(), key, mcCellLess);
+			triIndices[e] = oc.nodeBase + mcVertexRank(oc.created, creatorEdge);
+		}
+		
+		// Create the triangles... 
+		for(int e=0; mcTriTable[cell.cubeIdx][e]!=-1; e+=3) {
+			mesh.tris(tri++) = Triangle( triIndices[ mcTriTable[cell.cubeIdx][e+0]],
+			                             triIndices[ mcTriTable[cell.cubeIdx][e+1]],
+			                             triIndices[ mcTriTable[cell.cubeIdx][e+2]]);
+		}
+	}
+}
+
 //! run marching cubes to create a mesh for the 0-levelset
+//! note - the one-ring lookup is not built here, call rebuildQuickCheck before using it
 void LevelsetGrid::createMesh(Mesh& mesh) {
 	assertMsg(is3D(), "Only 3D grids supported so far");
 	
@@ -237,81 +431,738 @@ void LevelsetGrid::createMesh(Mesh& mesh) {
 		
 	const Real invalidTime = invalidTimeValue();
 	const Real isoValue = 1e-4;
+	if (mSize.x < 2) return;
+	
+	// classify and count per slab
+	const int numSlabs = mSize.x-1;
+	std::vector< std::vector<McCell> > slabCells( numSlabs );
+	std::vector<int> nodeOffset( numSlabs ), triOffset( numSlabs );
+	knMcClassify( slabCells, *this, isoValue, invalidTime, nodeOffset, triOffset );
+
+	// exclusive prefix sums give the first node and triangle of each slab
+	int numNodes = 0, numTris = 0;
+	for (int s=0; s<numSlabs; s++) {
+		const int nn = nodeOffset[s], nt = triOffset[s];
+		nodeOffset[s] = numNodes; triOffset[s] = numTris;
+		numNodes += nn; numTris += nt;
+	}
+	mesh.resizeNodes(numNodes);
+	mesh.resizeTris(numTris);
+
+	knMcCreateNodes( slabCells, *this, isoValue, nodeOffset, mesh );
+	knMcCreateTris ( slabCells, *this, invalidTime, triOffset, mesh );
+}
+
+
+//************************************************************************
+// Adaptive dual contouring
+// cells with surface carry the Hermite samples (edge crossings and levelset normals) of their 
+// edges as a quadric error function (QEF). Octree cells are merged bottom-up, level by level, 
+// as long as the merged QEF error stays below tolerance and the merge can't change the topology.
+// Each leaf gets one vertex (finest cells one per MC component), and every sign changing grid 
+// edge connects the leaves of its four cells. Edges that only touch one or two leaves are inside 
+// merged cells, the remaining ones correspond to the minimal edges of the octree, so the mesh 
+// stays closed. All passes run per x-slab, output order doesn't depend on the threading
+
+//! quadric error function of the Hermite samples of a cell, in double precision as merged 
+//! cells sum up many samples
+struct DcQef {
+	double ata[6]; // xx xy xz yy yz zz
+	double atb[3], btb;
+	double mass[3], normal[3];
+	int num;
 	
-	// create some temp grids
-	Grid<int> edgeVX(mParent);
-	Grid<int> edgeVY(mParent);
-	Grid<int> edgeVZ(mParent);
+	inline void clear() { 
+		for (int i=0; i<6; i++) ata[i] = 0.;
+		for (int i=0; i<3; i++) atb[i] = mass[i] = normal[i] = 0.;
+		btb = 0.; num = 0;
+	}
+	inline void add(const Vec3& p, const Vec3& n) {
+		const double d = n.x*p.x + n.y*p.y + n.z*p.z;
+		ata[0] += n.x*n.x; ata[1] += n.x*n.y; ata[2] += n.x*n.z;
+		ata[3] += n.y*n.y; ata[4] += n.y*n.z; ata[5] += n.z*n.z;
+		atb[0] += n.x*d; atb[1] += n.y*d; atb[2] += n.z*d;
+		btb += d*d;
+		mass[0] += p.x; mass[1] += p.y; mass[2] += p.z;
+		normal[0] += n.x; normal[1] += n.y; normal[2] += n.z;
+		num++;
+	}
+	//! length of the average normal, 1 for a plane
+	inline double normalCoherence() const { 
+		return sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]) / num; 
+	}
+	inline void add(const DcQef& o) {
+		for (int i=0; i<6; i++) ata[i] += o.ata[i];
+		for (int i=0; i<3; i++) { atb[i] += o.atb[i]; mass[i] += o.mass[i]; normal[i] += o.normal[i]; }
+		btb += o.btb; num += o.num;
+	}
+};
+
+//! eigen decomposition of a symmetric 3x3 matrix with Jacobi rotations, v holds the eigenvectors as columns
+static void dcSymEigen(double a[3][3], double v[3][3], double w[3]) {
+	for (int i=0; i<3; i++) for (int j=0; j<3; j++) v[i][j] = (i==j) ? 1. : 0.;
+	for (int sweep=0; sweep<16; sweep++) {
+		if (a[0][1]*a[0][1] + a[0][2]*a[0][2] + a[1][2]*a[1][2] < 1e-24) break;
+		for (int p=0; p<2; p++) 
+		for (int q=p+1; q<3; q++) {
+			if (fabs(a[p][q]) < 1e-30) continue;
+			const double theta = (a[q][q]-a[p][p]) / (2.*a[p][q]);
+			const double t = (theta>=0. ? 1. : -1.) / (fabs(theta) + sqrt(theta*theta+1.));
+			const double c = 1./sqrt(t*t+1.), s = t*c;
+			for (int k=0; k<3; k++) { const double x=a[k][p], y=a[k][q]; a[k][p] = c*x-s*y; a[k][q] = s*x+c*y; }
+			for (int k=0; k<3; k++) { const double x=a[p][k], y=a[q][k]; a[p][k] = c*x-s*y; a[q][k] = s*x+c*y; }
+			for (int k=0; k<3; k++) { const double x=v[k][p], y=v[k][q]; v[k][p] = c*x-s*y; v[k][q] = s*x+c*y; }
+		}
+	}
+	for (int i=0; i<3; i++) w[i] = a[i][i];
+}
+
+//! minimize the QEF with a truncated pseudo-inverse around the mass point, vertices leaving the 
+//! cell [lo,hi] fall back to the mass point. Returns the QEF error at the vertex
+static double dcSolveQef(const DcQef& q, const Vec3& lo, const Vec3& hi, Vec3& pos) {
+	const double m[3] = { q.mass[0]/q.num, q.mass[1]/q.num, q.mass[2]/q.num };
+	double a[3][3] = { { q.ata[0], q.ata[1], q.ata[2] }, { q.ata[1], q.ata[3], q.ata[4] }, { q.ata[2], q.ata[4], q.ata[5] } };
+	double rhs[3], v[3][3], w[3], x[3];
+	for (int i=0; i<3; i++) 
+		rhs[i] = q.atb[i] - (a[i][0]*m[0] + a[i][1]*m[1] + a[i][2]*m[2]);
+	dcSymEigen(a, v, w);
+	const double wmax = std::max(fabs(w[0]), std::max(fabs(w[1]), fabs(w[2])));
+	for (int i=0; i<3; i++) x[i] = m[i];
+	for (int e=0; e<3; e++) {
+		if (fabs(w[e]) <= 0.1*wmax) continue;
+		const double c = (v[0][e]*rhs[0] + v[1][e]*rhs[1] + v[2][e]*rhs[2]) / w[e];
+		for (int i=0; i<3; i++) x[i] += c * v[i][e];
+	}
+	const Real eps = 1e-3;
+	for (int i=0; i<3; i++) {
+		if (x[i] < lo[i]-eps || x[i] > hi[i]+eps) {
+			for (int j=0; j<3; j++) x[j] = m[j];
+			break;
+		}
+	}
+	pos = Vec3(x[0], x[1], x[2]);
+	const double ax[3] = { q.ata[0]*x[0] + q.ata[1]*x[1] + q.ata[2]*x[2], 
+	                       q.ata[1]*x[0] + q.ata[3]*x[1] + q.ata[4]*x[2], 
+	                       q.ata[2]*x[0] + q.ata[4]*x[1] + q.ata[5]*x[2] };
+	const double err = x[0]*(ax[0]-2.*q.atb[0]) + x[1]*(ax[1]-2.*q.atb[1]) + x[2]*(ax[2]-2.*q.atb[2]) + q.btb;
+	return std::max(err, 0.);
+}
+
+//! surface components of a MC case, edgeComp gets the component of each used edge (2 bits per edge)
+static int dcComponents(const int cubeIdx, int& edgeComp) {
+	int parent[12];
+	for (int e=0; e<12; e++) parent[e] = e;
+	for (int t=0; mcTriTable[cubeIdx][t]!=-1; t+=3) {
+		for (int l=1; l<3; l++) {
+			int a = mcTriTable[cubeIdx][t], b = mcTriTable[cubeIdx][t+l];
+			while (parent[a] != a) a = parent[a];
+			while (parent[b] != b) b = parent[b];
+			if (a != b) parent[std::max(a,b)] = std::min(a,b);
+		}
+	}
+	int num = 0, compOfRoot[12];
+	edgeComp = 0;
+	for (int e=0; e<12; e++) {
+		if (!(mcEdgeTable[cubeIdx] & (1<<e))) continue;
+		int r = e;
+		while (parent[r] != r) r = parent[r];
+		if (r == e) compOfRoot[e] = num++;
+		edgeComp |= compOfRoot[r] << (2*e);
+	}
+	return num;
+}
+
+static inline int dcCubeIndex(const Grid<Real>& phi, const Vec3i& c, const int step, const Real isoValue) {
+	int cubeIdx = 0;
+	for (int l=0;l<8;l++) {
+		if (-phi(c.x+step*cubieOffsetX[l], c.y+step*cubieOffsetY[l], c.z+step*cubieOffsetZ[l]) < isoValue) 
+			cubeIdx |= 1<<l;
+	}
+	return cubeIdx;
+}
+
+//! octree cell with surface. key: linear cell index on its level, vertex: first vertex of a leaf,
+//! or the vertex of the merged cell covering it
+struct DcNode {
+	IndexInt key;
+	int vertex, edgeComp;
+	char numComp, merged, covered;
+	Vec3 pos;
+	DcQef qef;
+};
+
+//! nodes of one octree level sorted by key, nodes of cell slab x are slabStart[x] .. slabStart[x+1]-1
+struct DcLevel {
+	Vec3i size;
+	std::vector<DcNode> nodes;
+	std::vector<int> slabStart;
 	
-	for(int i=0; i<mSize.x-1; i++)
-	for(int j=0; j<mSize.y-1; j++)
-	for(int k=0; k<mSize.z-1; k++) {
-		 Real value[8] = { get(i,j,k),   get(i+1,j,k),   get(i+1,j+1,k),   get(i,j+1,k),
-						   get(i,j,k+1), get(i+1,j,k+1), get(i+1,j+1,k+1), get(i,j+1,k+1) };
-		
-		// build lookup index, check for invalid times
-		bool skip = false;
-		int cubeIdx = 0;
-		for (int l=0;l<8;l++) {
-			value[l] *= -1;
-			if (-value[l] <= invalidTime)
-				skip = true;
-			if (value[l] < isoValue) 
-				cubeIdx |= 1<<l;
+	inline IndexInt key(const Vec3i& c) const { return ((IndexInt)c.x*size.y + c.y)*size.z + c.z; }
+	//! node of cell c, or -1
+	inline int find(const Vec3i& c) const {
+		if (c.x<0 || c.y<0 || c.z<0 || c.x>=size.x || c.y>=size.y || c.z>=size.z) return -1;
+		const IndexInt k = key(c);
+		int lo = slabStart[c.x], hi = slabStart[c.x+1];
+		while (lo < hi) {
+			const int mid = (lo+hi)/2;
+			if (nodes[mid].key < k) lo = mid+1; else hi = mid;
 		}
-		if (skip || (mcEdgeTable[cubeIdx] == 0)) continue;
-		
-		// where to look up if this point already exists
-		int triIndices[12];
-		int *eVert[12] = { &edgeVX(i,j,k),   &edgeVY(i+1,j,k),   &edgeVX(i,j+1,k),   &edgeVY(i,j,k), 
-						   &edgeVX(i,j,k+1), &edgeVY(i+1,j,k+1), &edgeVX(i,j+1,k+1), &edgeVY(i,j,k+1), 
-						   &edgeVZ(i,j,k),   &edgeVZ(i+1,j,k),   &edgeVZ(i+1,j+1,k), &edgeVZ(i,j+1,k) };
+		return (lo < slabStart[c.x+1] && nodes[lo].key == k) ? lo : -1;
+	}
+	//! concatenate per-slab nodes
+	void assign(std::vector< std::vector<DcNode> >& slabNodes) {
+		slabStart.assign(size.x+1, 0);
+		for (int x=0; x<size.x; x++) slabStart[x+1] = slabStart[x] + slabNodes[x].size();
+		nodes.resize(slabStart[size.x]);
+		for (int x=0; x<size.x; x++) std::copy(slabNodes[x].begin(), slabNodes[x].end(), nodes.begin()+slabStart[x]);
+	}
+};
+
+//! finest level: cells with surface and their QEF, single component cells can be merged
+KERNEL(pts)
+void knDcClassify(std::vector< std::vector<DcNode> >& slabNodes, const Grid<Real>& phi, const DcLevel& level, 
+		const Real isoValue, const Real invalidTime) {
+	for (int j=0; j<level.size.y; j++)
+	for (int k=0; k<level.size.z; k++) {
+		const Vec3i c(idx,j,k);
+		if (mcSkipCell(phi, c, invalidTime)) continue;
+		const int cubeIdx = dcCubeIndex(phi, c, 1, isoValue);
+		if (mcEdgeTable[cubeIdx] == 0) continue;
 		
-		const Vec3 pos[9] = { Vec3(i,j,k),   Vec3(i+1,j,k),   Vec3(i+1,j+1,k),   Vec3(i,j+1,k),
-						Vec3(i,j,k+1), Vec3(i+1,j,k+1), Vec3(i+1,j+1,k+1), Vec3(i,j+1,k+1) };
+		DcNode node;
+		node.key = level.key(c);
+		node.vertex = -1;
+		node.numComp = dcComponents(cubeIdx, node.edgeComp);
+		node.covered = false;
+		node.qef.clear();
+		Node sample;
+		for (int e=0; e<12; e++) {
+			if (!(mcEdgeTable[cubeIdx] & (1<<e))) continue;
+			mcEdgeVertex(phi, c, e, isoValue, sample);
+			node.qef.add(sample.pos, sample.normal);
+		}
+		node.merged = (node.numComp == 1);
+		if (node.merged) 
+			dcSolveQef(node.qef, toVec3(c)+Vec3(0.5), toVec3(c)+Vec3(1.5), node.pos);
+		slabNodes[idx].push_back(node);
+	}
+}
+
+//! signs at the edge midpoints, face centers and center of a cell have to agree with the sign of one 
+//! of the corners of the edge, face or cell, otherwise merging its children would change the topology
+static bool dcTopologySafe(const Grid<Real>& phi, const Vec3i& base, const int half, const Real isoValue, const Real invalidTime) {
+	int side[3][3][3];
+	for (int a=0; a<3; a++) for (int b=0; b<3; b++) for (int c=0; c<3; c++) {
+		const Real v = phi(base.x+a*half, base.y+b*half, base.z+c*half);
+		if (v <= invalidTime) return false;
+		side[a][b][c] = (-v < isoValue) ? 1 : 0;
+	}
+	for (int a=0; a<3; a++) for (int b=0; b<3; b++) for (int c=0; c<3; c++) {
+		const int mids = (a==1) + (b==1) + (c==1);
+		if (mids == 0) continue;
+		// corners of the edge / face / cell the point is centered in
+		bool agree = false;
+		for (int ca=0; ca<3; ca+=2) for (int cb=0; cb<3; cb+=2) for (int cc=0; cc<3; cc+=2) {
+			if ((a!=1 && ca!=a) || (b!=1 && cb!=b) || (c!=1 && cc!=c)) continue;
+			if (side[ca][cb][cc] == side[a][b][c]) agree = true;
+		}
+		if (!agree) return false;
+	}
+	return true;
+}
+
+//! merged cells need normals within about 25 degrees of their average
+static const Real dcMinNormalCoherence = 0.9;
+
+//! build the parents of the nodes of the slabs 2*idx and 2*idx+1 of the level below, 
+//! and merge them where possible
+KERNEL(pts)
+void knDcMerge(std::vector< std::vector<DcNode> >& slabNodes, const DcLevel& child, const DcLevel& level, 
+		const Grid<Real>& phi, const int lev, const Real maxError, const Real isoValue, const Real invalidTime, 
+		const Vec3i& numCells) {
+	std::vector<DcNode>& nodes = slabNodes[idx];
+	std::vector<IndexInt> keys;
+	for (int x=2*idx; x<=2*idx+1 && x<child.size.x; x++) {
+		for (int n=child.slabStart[x]; n<child.slabStart[x+1]; n++) {
+			const IndexInt r = child.nodes[n].key % ((IndexInt)child.size.y*child.size.z);
+			keys.push_back(level.key(Vec3i(idx, (r / child.size.z)/2, (r % child.size.z)/2)));
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	
+	const int cellSize = 1<<lev;
+	for (size_t n=0; n<keys.size(); n++) {
+		DcNode node;
+		node.key = keys[n];
+		node.vertex = -1;
+		node.numComp = 1;
+		node.edgeComp = 0;
+		node.merged = false;
+		node.covered = false;
+		node.qef.clear();
+		const IndexInt r = keys[n] % ((IndexInt)level.size.y*level.size.z);
+		const Vec3i c(idx, r / level.size.z, r % level.size.z);
+		const Vec3i base = c * cellSize;
 		
+		bool merge = base.x+cellSize <= numCells.x && base.y+cellSize <= numCells.y && base.z+cellSize <= numCells.z;
+		for (int l=0; l<8 && merge; l++) {
+			const int ch = child.find(c*2 + Vec3i(cubieOffsetX[l], cubieOffsetY[l], cubieOffsetZ[l]));
+			if (ch < 0) continue;
+			if (!child.nodes[ch].merged) merge = false;
+			else node.qef.add(child.nodes[ch].qef);
+		}
+		// sharp features stay at full resolution, the finest QEF vertices already lie on them
+		if (merge) merge = node.qef.normalCoherence() >= dcMinNormalCoherence;
+		if (merge) merge = dcTopologySafe(phi, base, cellSize/2, isoValue, invalidTime);
+		if (merge) {
+			int edgeComp;
+			merge = dcComponents(dcCubeIndex(phi, base, cellSize, isoValue), edgeComp) == 1;
+		}
+		if (merge) {
+			const Real err = dcSolveQef(node.qef, toVec3(base)+Vec3(0.5), toVec3(base)+Vec3(cellSize+0.5), node.pos);
+			merge = err <= maxError * maxError * node.qef.num;
+		}
+		node.merged = merge;
+		nodes.push_back(node);
+	}
+}
+
+//! nodes inside a merged parent are covered by it
+KERNEL(pts)
+void knDcCovered(std::vector<DcNode>& nodes, const DcLevel& level, const DcLevel& parent) {
+	const IndexInt r = nodes[idx].key % ((IndexInt)level.size.y*level.size.z);
+	const Vec3i c(nodes[idx].key / ((IndexInt)level.size.y*level.size.z), r / level.size.z, r % level.size.z);
+	const int p = parent.find(c/2);
+	nodes[idx].covered = p >= 0 && parent.nodes[p].merged;
+}
+
+//! vertices of covered nodes are the ones of the parent, filled in top-down
+KERNEL(pts)
+void knDcInheritVertex(std::vector<DcNode>& nodes, const DcLevel& level, const DcLevel& parent) {
+	if (!nodes[idx].covered) return;
+	const IndexInt r = nodes[idx].key % ((IndexInt)level.size.y*level.size.z);
+	const Vec3i c(nodes[idx].key / ((IndexInt)level.size.y*level.size.z), r / level.size.z, r % level.size.z);
+	nodes[idx].vertex = parent.nodes[parent.find(c/2)].vertex;
+}
+
+//! vertex normal from the trilinearly interpolated levelset gradient
+static inline Vec3 dcNormal(const Grid<Real>& phi, const Vec3& pos) {
+	const Vec3 p = pos - Vec3(0.5);
+	const Vec3i c( clamp((int)p.x, 0, phi.getSizeX()-2), clamp((int)p.y, 0, phi.getSizeY()-2), clamp((int)p.z, 0, phi.getSizeZ()-2) );
+	const Vec3 f = p - toVec3(c);
+	Vec3 n(0.);
+	for (int l=0; l<8; l++) {
+		const Real w = (cubieOffsetX[l] ? f.x : 1.-f.x) * (cubieOffsetY[l] ? f.y : 1.-f.y) * (cubieOffsetZ[l] ? f.z : 1.-f.z);
+		n += w * getGradient(phi, c.x+cubieOffsetX[l], c.y+cubieOffsetY[l], c.z+cubieOffsetZ[l]);
+	}
+	return getNormalized(n);
+}
+
+//! vertices of the leaves, finest cells with several components get one QEF vertex per component
+KERNEL(pts)
+void knDcCreateVertices(const std::vector<DcNode>& nodes, const DcLevel& level, const Grid<Real>& phi, 
+		const int lev, const Real isoValue, std::vector<Node>& vertices) {
+	const DcNode& node = nodes[idx];
+	if (node.covered || (!node.merged && lev>0)) return;
+	if (node.merged) {
+		vertices[node.vertex] = Node(node.pos);
+		vertices[node.vertex].normal = dcNormal(phi, node.pos);
+		return;
+	}
+	const IndexInt r = node.key % ((IndexInt)level.size.y*level.size.z);
+	const Vec3i c(node.key / ((IndexInt)level.size.y*level.size.z), r / level.size.z, r % level.size.z);
+	const int cubeIdx = dcCubeIndex(phi, c, 1, isoValue);
+	for (int comp=0; comp<node.numComp; comp++) {
+		DcQef qef;
+		qef.clear();
+		Node sample;
 		for (int e=0; e<12; e++) {
-			if (mcEdgeTable[cubeIdx] & (1<<e)) {
-				// vertex already calculated ?
-				if (*eVert[e] == 0) {
-					// interpolate edge
-					const int e1 = mcEdges[e*2  ];
-					const int e2 = mcEdges[e*2+1];
-					const Vec3 p1 = pos[ e1  ];    // scalar field pos 1
-					const Vec3 p2 = pos[ e2  ];    // scalar field pos 2
-					const float valp1  = value[ e1  ];  // scalar field val 1
-					const float valp2  = value[ e2  ];  // scalar field val 2
-					const float mu = (isoValue - valp1) / (valp2 - valp1);
-
-					// init isolevel vertex
-					Node vertex;
-					vertex.pos = p1 + (p2-p1)*mu + Vec3(Real(0.5));
-					vertex.normal = getNormalized( 
-										getGradient( *this, i+cubieOffsetX[e1], j+cubieOffsetY[e1], k+cubieOffsetZ[e1]) * (1.0-mu) +
-										getGradient( *this, i+cubieOffsetX[e2], j+cubieOffsetY[e2], k+cubieOffsetZ[e2]) * (    mu)) ;
-					
-					triIndices[e] = mesh.addNode(vertex) + 1;
-					
-					// store vertex 
-					*eVert[e] = triIndices[e];
-				} else {
-					// retrieve  from vert array
-					triIndices[e] = *eVert[e];
-				}
+			if (!(mcEdgeTable[cubeIdx] & (1<<e)) || ((node.edgeComp >> (2*e)) & 3) != comp) continue;
+			mcEdgeVertex(phi, c, e, isoValue, sample);
+			qef.add(sample.pos, sample.normal);
+		}
+		Vec3 pos;
+		dcSolveQef(qef, toVec3(c)+Vec3(0.5), toVec3(c)+Vec3(1.5), pos);
+		vertices[node.vertex+comp] = Node(pos);
+		vertices[node.vertex+comp].normal = dcNormal(phi, pos);
+	}
+}
+
+//! splitting quad a,b,c,d along a-c: worst alignment of the two triangles with their vertex normals
+static inline Real dcSplitQuality(const std::vector<Node>& v, const int a, const int b, const int c, const int d) {
+	const Vec3 n1 = getNormalized(cross(v[b].pos-v[a].pos, v[c].pos-v[a].pos));
+	const Vec3 n2 = getNormalized(cross(v[c].pos-v[a].pos, v[d].pos-v[a].pos));
+	return std::min( dot(n1, v[a].normal+v[b].normal+v[c].normal), dot(n2, v[a].normal+v[c].normal+v[d].normal) );
+}
+
+//! the cells around the edges of each axis in cyclic order, and whether the resulting 
+//! polygon has to be flipped for that axis
+static const int dcRing[4] = { 0,1,3,2 };
+static const bool dcAxisFlip[3] = { false, true, false };
+
+//! one polygon per sign changing grid edge with base point in slab idx, from the vertices of the 
+//! leaves of its four cells
+KERNEL(pts)
+void knDcCreateTris(std::vector< std::vector<Triangle> >& slabTris, const DcLevel& level, const Grid<Real>& phi, 
+		const std::vector<Node>& vertices, const Real isoValue, const Real invalidTime) {
+	std::vector<Triangle>& tris = slabTris[idx];
+	const int i = idx;
+	for (int j=0; j<phi.getSizeY(); j++)
+	for (int k=0; k<phi.getSizeZ(); k++) {
+		const Real v0 = phi(i,j,k);
+		if (v0 <= invalidTime) continue;
+		const bool side0 = -v0 < isoValue;
+		for (int axis=0; axis<3; axis++) {
+			const Vec3i p(i,j,k), q = p + Vec3i(axis==0, axis==1, axis==2);
+			if (q.x>=phi.getSizeX() || q.y>=phi.getSizeY() || q.z>=phi.getSizeZ()) continue;
+			const Real v1 = phi(q);
+			if (v1 <= invalidTime || (-v1 < isoValue) == side0) continue;
+			
+			// cells of a merged leaf are neighbors in the ring, so duplicates are consecutive
+			int vert[4], num = 0;
+			bool complete = true;
+			for (int n=0; n<4 && complete; n++) {
+				const int nd = level.find(p + mcEdgeCells[axis][dcRing[n]]);
+				if (nd < 0) { complete = false; break; }
+				const DcNode& node = level.nodes[nd];
+				int vx = node.vertex;
+				if (!node.covered) 
+					vx += (node.edgeComp >> (2*mcEdgeCellEdge[axis][dcRing[n]])) & 3;
+				if (num==0 || vx != vert[num-1]) vert[num++] = vx;
+			}
+			if (num>1 && vert[num-1]==vert[0]) num--;
+			// cells missing at the domain boundary or next to invalid values, or edge inside a merged leaf
+			if (!complete || num < 3) continue;
+			
+			if (side0 == dcAxisFlip[axis]) {
+				std::swap(vert[0], vert[num-1]);
+				if (num==4) std::swap(vert[1], vert[2]);
+			}
+			if (num == 3) {
+				tris.push_back(Triangle(vert[0], vert[1], vert[2]));
+			} else if (dcSplitQuality(vertices, vert[0], vert[1], vert[2], vert[3]) >= dcSplitQuality(vertices, vert[1], vert[2], vert[3], vert[0])) {
+				tris.push_back(Triangle(vert[0], vert[1], vert[2]));
+				tris.push_back(Triangle(vert[0], vert[2], vert[3]));
+			} else {
+				tris.push_back(Triangle(vert[0], vert[1], vert[3]));
+				tris.push_back(Triangle(vert[1], vert[2], vert[3]));
 			}
 		}
+	}
+}
+
+KERNEL(pts)
+void knDcMarkUsed(const std::vector< std::vector<Triangle> >& slabTris, std::vector<int>& used) {
+	for (size_t t=0; t<slabTris[idx].size(); t++)
+		for (int c=0; c<3; c++) used[slabTris[idx][t].c[c]] = 0;
+}
+
+KERNEL(pts)
+void knDcWriteNodes(const std::vector<Node>& vertices, const std::vector<int>& newIndex, Mesh& mesh) {
+	if (newIndex[idx] >= 0) mesh.nodes(newIndex[idx]) = vertices[idx];
+}
+
+KERNEL(pts)
+void knDcWriteTris(const std::vector< std::vector<Triangle> >& slabTris, const std::vector<int>& triOffset, 
+		const std::vector<int>& newIndex, Mesh& mesh) {
+	for (size_t t=0; t<slabTris[idx].size(); t++)
+		for (int c=0; c<3; c++) 
+			mesh.tris(triOffset[idx]+t).c[c] = newIndex[slabTris[idx][t].c[c]];
+}
+
+//! create a mesh of the 0-levelset with adaptive dual contouring. Cells are merged up to 
+//! 2^maxLevel cells wide while the RMS distance of their Hermite planes to the merged vertex 
+//! stays below tolerance (in cells)
+//! note - the one-ring lookup is not built here, call rebuildQuickCheck before using it
+void LevelsetGrid::createMeshAdaptive(Mesh& mesh, Real tolerance, int maxLevel) {
+	assertMsg(is3D(), "Only 3D grids supported so far");
+	
+	mesh.clear();
+	const Real invalidTime = invalidTimeValue();
+	const Real isoValue = 1e-4;
+	if (mSize.x < 2 || mSize.y < 2 || mSize.z < 2) return;
+	
+	// finest level, then merge bottom-up as long as there is something to merge
+	const Vec3i numCells = mSize - Vec3i(1);
+	std::vector<DcLevel> levels(1);
+	levels[0].size = numCells;
+	{
+		std::vector< std::vector<DcNode> > slabNodes(numCells.x);
+		knDcClassify(slabNodes, *this, levels[0], isoValue, invalidTime);
+		levels[0].assign(slabNodes);
+	}
+	for (int lev=1; lev<=maxLevel; lev++) {
+		const DcLevel& child = levels[lev-1];
+		bool anyMerged = false;
+		for (size_t n=0; n<child.nodes.size() && !anyMerged; n++) anyMerged = child.nodes[n].merged;
+		if (!anyMerged) break;
 		
-		// Create the triangles... 
-		for(int e=0; mcTriTable[cubeIdx][e]!=-1; e+=3) {
-			mesh.addTri( Triangle( triIndices[ mcTriTable[cubeIdx][e+0]] - 1,
-										triIndices[ mcTriTable[cubeIdx][e+1]] - 1,
-										triIndices[ mcTriTable[cubeIdx][e+2]] - 1));
+		DcLevel level;
+		level.size = (child.size + Vec3i(1)) / 2;
+		std::vector< std::vector<DcNode> > slabNodes(level.size.x);
+		knDcMerge(slabNodes, child, level, *this, lev, tolerance, isoValue, invalidTime, numCells);
+		level.assign(slabNodes);
+		levels.push_back(level);
+		knDcCovered(levels[lev-1].nodes, levels[lev-1], levels[lev]);
+	}
+	
+	// number the vertices of the leaves level by level
+	int numVertices = 0;
+	for (size_t lev=0; lev<levels.size(); lev++) {
+		std::vector<DcNode>& nodes = levels[lev].nodes;
+		for (size_t n=0; n<nodes.size(); n++) {
+			if (nodes[n].covered) continue;
+			if (lev==0) {
+				nodes[n].vertex = numVertices;
+				numVertices += nodes[n].numComp;
+			} else if (nodes[n].merged) {
+				nodes[n].vertex = numVertices++;
+			}
 		}
 	}
+	std::vector<Node> vertices(numVertices);
+	for (int lev=(int)levels.size()-1; lev>=0; lev--) {
+		if (lev+1 < (int)levels.size()) 
+			knDcInheritVertex(levels[lev].nodes, levels[lev], levels[lev+1]);
+		knDcCreateVertices(levels[lev].nodes, levels[lev], *this, lev, isoValue, vertices);
+	}
 	
-	//mesh.rebuildCorners();
-	//mesh.rebuildLookup();
+	std::vector< std::vector<Triangle> > slabTris(mSize.x);
+	knDcCreateTris(slabTris, levels[0], *this, vertices, isoValue, invalidTime);
+	
+	// keep only vertices used by triangles
+	std::vector<int> newIndex(numVertices, -1), triOffset(mSize.x+1, 0);
+	knDcMarkUsed(slabTris, newIndex);
+	int numNodes = 0;
+	for (int n=0; n<numVertices; n++) 
+		if (newIndex[n] >= 0) newIndex[n] = numNodes++;
+	for (int x=0; x<mSize.x; x++) 
+		triOffset[x+1] = triOffset[x] + slabTris[x].size();
+	mesh.resizeNodes(numNodes);
+	mesh.resizeTris(triOffset[mSize.x]);
+	knDcWriteNodes(vertices, newIndex, mesh);
+	knDcWriteTris(slabTris, triOffset, newIndex, mesh);
+}
+
+
+//************************************************************************
+// Incremental marching cubes
+
+IncrementalMesher::IncrementalMesher(FluidSolver* parent, int blockSize, Real tolerance)
+	: PbClass(parent), mBlockSize(blockSize), mTolerance(tolerance), mGridSize(0), mNumBlocks(0)
+{
+	if (blockSize < 2)
+		errMsg("IncrementalMesher: block size needs to be at least 2");
+}
+
+void IncrementalMesher::reset() {
+	mBlocks.clear();
+	mPhi.clear();
+	mEdgeNode.clear();
+	mGridSize = mNumBlocks = Vec3i(0);
+}
+
+//! inside/outside/invalid class of a levelset value, a change always triggers remeshing
+static inline int mcPointClass(const Real v, const Real isoValue, const Real invalidTime) {
+	if (v <= invalidTime) return 2;
+	return (-v < isoValue) ? 1 : 0;
+}
+
+static inline Vec3i mcBlockPos(const IndexInt b, const Vec3i& numBlocks) {
+	return Vec3i( b % numBlocks.x, (b / numBlocks.x) % numBlocks.y, b / (numBlocks.x*numBlocks.y) );
+}
+
+//! points [lo,hi) owned by a block, the last block in each dimension also owns the last points
+static inline void mcBlockPoints(const Vec3i& bp, const Vec3i& numBlocks, const Vec3i& size, const int blockSize, Vec3i& lo, Vec3i& hi) {
+	lo = bp * blockSize;
+	hi = lo + Vec3i(blockSize);
+	for (int c=0; c<3; c++) 
+		if (bp[c] == numBlocks[c]-1) hi[c] = size[c];
+}
+
+KERNEL(pts)
+void knMcBlockChanged(std::vector<int>& changed, const Grid<Real>& phi, const std::vector<Real>& old, const Vec3i& numBlocks, 
+		const int blockSize, const Real isoValue, const Real invalidTime, const Real tolerance) {
+	Vec3i lo, hi;
+	mcBlockPoints(mcBlockPos(idx, numBlocks), numBlocks, phi.getSize(), blockSize, lo, hi);
+	changed[idx] = 0;
+	for (int k=lo.z; k<hi.z; k++)
+	for (int j=lo.y; j<hi.y; j++)
+	for (int i=lo.x; i<hi.x; i++) {
+		const IndexInt n = phi.index(i,j,k);
+		const Real v = phi[n], o = old[n];
+		if (std::abs(v-o) > tolerance || mcPointClass(v, isoValue, invalidTime) != mcPointClass(o, isoValue, invalidTime)) {
+			changed[idx] = 1;
+			return;
+		}
+	}
+}
+
+//! vertices depend on values up to two points away, so neighbors of changed blocks are remeshed as well
+KERNEL(pts)
+void knMcBlockDirty(std::vector<int>& dirty, const std::vector<int>& changed, const Vec3i& numBlocks) {
+	const Vec3i bp = mcBlockPos(idx, numBlocks);
+	dirty[idx] = 0;
+	for (int dk=-1; dk<=1; dk++)
+	for (int dj=-1; dj<=1; dj++)
+	for (int di=-1; di<=1; di++) {
+		const Vec3i n = bp + Vec3i(di,dj,dk);
+		if (n.x<0 || n.y<0 || n.z<0 || n.x>=numBlocks.x || n.y>=numBlocks.y || n.z>=numBlocks.z) continue;
+		if (changed[n.x + numBlocks.x*(n.y + numBlocks.y*n.z)]) { dirty[idx] = 1; return; }
+	}
+}
+
+KERNEL(pts)
+void knMcUpdateValues(const std::vector<int>& changed, const Grid<Real>& phi, std::vector<Real>& old, const Vec3i& numBlocks, const int blockSize) {
+	if (!changed[idx]) return;
+	Vec3i lo, hi;
+	mcBlockPoints(mcBlockPos(idx, numBlocks), numBlocks, phi.getSize(), blockSize, lo, hi);
+	for (int k=lo.z; k<hi.z; k++)
+	for (int j=lo.y; j<hi.y; j++)
+	for (int i=lo.x; i<hi.x; i++) 
+		old[phi.index(i,j,k)] = phi(i,j,k);
+}
+
+//! polygonize a block, vertices are stored by the block of the cell creating them
+KERNEL(pts)
+void knMcMeshBlock(const std::vector<int>& dirty, std::vector<McBlock>& blocks, const Grid<Real>& phi, const Vec3i& numBlocks, 
+		const int blockSize, const Real isoValue, const Real invalidTime) {
+	McBlock& block = blocks[dirty[idx]];
+	block.vertKeys.clear(); block.vertPos.clear(); block.vertNormal.clear(); block.triKeys.clear();
+	const Vec3i bp = mcBlockPos(dirty[idx], numBlocks);
+	const Vec3i lo = bp * blockSize;
+	Vec3i hi = lo + Vec3i(blockSize);
+	for (int c=0; c<3; c++) 
+		if (bp[c] == numBlocks[c]-1) hi[c] = phi.getSize()[c]-1;
+
+	// same traversal order as createMesh
+	for(int i=lo.x; i<hi.x; i++)
+	for(int j=lo.y; j<hi.y; j++)
+	for(int k=lo.z; k<hi.z; k++) {
+		const Vec3i c(i,j,k);
+		if (mcSkipCell(phi, c, invalidTime)) continue;
+		int cubeIdx = 0;
+		for (int l=0;l<8;l++) {
+			if (-phi(i+cubieOffsetX[l], j+cubieOffsetY[l], k+cubieOffsetZ[l]) < isoValue) 
+				cubeIdx |= 1<<l;
+		}
+		if (mcEdgeTable[cubeIdx] == 0) continue;
+
+		IndexInt keys[12];
+		for (int e=0; e<12; e++) {
+			if (!(mcEdgeTable[cubeIdx] & (1<<e))) continue;
+			keys[e] = 3*phi.index(c + mcEdgeBase[e]) + mcEdgeAxis[e];
+			Vec3i creator; int creatorEdge;
+			mcEdgeCreator(phi, c, e, invalidTime, creator, creatorEdge);
+			if (creator != c) continue;
+			Node vertex;
+			mcEdgeVertex(phi, c, e, isoValue, vertex);
+			block.vertKeys.push_back(keys[e]);
+			block.vertPos.push_back(vertex.pos);
+			block.vertNormal.push_back(vertex.normal);
+		}
+		for(int e=0; mcTriTable[cubeIdx][e]!=-1; e++) 
+			block.triKeys.push_back(keys[ mcTriTable[cubeIdx][e] ]);
+	}
+}
+
+KERNEL(pts)
+void knMcStitchNodes(const std::vector<McBlock>& blocks, const std::vector<int>& nodeOffset, std::vector<int>& edgeNode, 
+		std::vector<IndexInt>& nodeKeys, Mesh& mesh) {
+	const McBlock& block = blocks[idx];
+	for (size_t v=0; v<block.vertKeys.size(); v++) {
+		const int n = nodeOffset[idx] + v;
+		mesh.nodes(n).pos    = block.vertPos[v];
+		mesh.nodes(n).normal = block.vertNormal[v];
+		edgeNode[block.vertKeys[v]] = n;
+		nodeKeys[n] = block.vertKeys[v];
+	}
+}
+
+//! resolve triangle keys, keys without a matching node flag the block as inconsistent
+KERNEL(pts)
+void knMcStitchTris(const std::vector<McBlock>& blocks, const std::vector<int>& triOffset, const std::vector<int>& edgeNode, 
+		const std::vector<IndexInt>& nodeKeys, Mesh& mesh, std::vector<int>& missing) {
+	const McBlock& block = blocks[idx];
+	missing[idx] = 0;
+	for (size_t t=0; t<block.triKeys.size()/3; t++) {
+		Triangle& tri = mesh.tris(triOffset[idx] + t);
+		for (int c=0; c<3; c++) {
+			const IndexInt key = block.triKeys[3*t+c];
+			const int n = edgeNode[key];
+			if (n<0 || n>=(int)nodeKeys.size() || nodeKeys[n] != key) { missing[idx] = 1; return; }
+			tri.c[c] = n;
+		}
+	}
+}
+
+bool IncrementalMesher::remesh(const LevelsetGrid& phi, const std::vector<int>& dirty, Mesh& mesh) {
+	const Real isoValue = 1e-4;
+	knMcMeshBlock(dirty, mBlocks, phi, mNumBlocks, mBlockSize, isoValue, LevelsetGrid::invalidTimeValue());
+
+	const int numBlocks = mBlocks.size();
+	std::vector<int> nodeOffset(numBlocks), triOffset(numBlocks);
+	int numNodes = 0, numTris = 0;
+	for (int b=0; b<numBlocks; b++) {
+		nodeOffset[b] = numNodes; triOffset[b] = numTris;
+		numNodes += mBlocks[b].vertKeys.size();
+		numTris  += mBlocks[b].triKeys.size()/3;
+	}
+	mesh.clear();
+	mesh.resizeNodes(numNodes);
+	mesh.resizeTris(numTris);
+
+	std::vector<IndexInt> nodeKeys(numNodes);
+	std::vector<int> missing(numBlocks, 0);
+	knMcStitchNodes(mBlocks, nodeOffset, mEdgeNode, nodeKeys, mesh);
+	knMcStitchTris (mBlocks, triOffset, mEdgeNode, nodeKeys, mesh, missing);
+	for (int b=0; b<numBlocks; b++) 
+		if (missing[b]) return false;
+	return true;
 }
 
+//! re-polygonize the blocks around changed values, and assemble the mesh from all blocks
+//! note - the one-ring lookup is not built here, call rebuildQuickCheck before using it
+int IncrementalMesher::update(LevelsetGrid& phi, Mesh& mesh) {
+	assertMsg(phi.is3D(), "Only 3D grids supported so far");
+	const Vec3i size = phi.getSize();
+	const Real isoValue = 1e-4;
+	
+	// (re-)initialize the cache, all blocks changed
+	std::vector<int> changed;
+	if (size != mGridSize || mPhi.empty()) {
+		mGridSize = size;
+		for (int c=0; c<3; c++) 
+			mNumBlocks[c] = std::max(1, (size[c]-1 + mBlockSize-1) / mBlockSize);
+		mBlocks.assign(mNumBlocks.x*mNumBlocks.y*mNumBlocks.z, McBlock());
+		mPhi.assign(&phi[0], &phi[0] + phi.getSizeX()*phi.getSizeY()*phi.getSizeZ());
+		mEdgeNode.assign(3*mPhi.size(), -1);
+		changed.assign(mBlocks.size(), 1);
+	} else {
+		changed.resize(mBlocks.size());
+		knMcBlockChanged(changed, phi, mPhi, mNumBlocks, mBlockSize, isoValue, LevelsetGrid::invalidTimeValue(), mTolerance);
+		knMcUpdateValues(changed, phi, mPhi, mNumBlocks, mBlockSize);
+	}
+	if (size.x < 2 || size.y < 2 || size.z < 2) { 
+		mesh.clear(); 
+		return 0; 
+	}
+
+	std::vector<int> dirtyFlags(mBlocks.size()), dirty;
+	knMcBlockDirty(dirtyFlags, changed, mNumBlocks);
+	for (int b=0; b<(int)mBlocks.size(); b++) 
+		if (dirtyFlags[b]) dirty.push_back(b);
+
+	if (!remesh(phi, dirty, mesh)) {
+		// should not happen, rebuild everything from the current values
+		debMsg("IncrementalMesher: inconsistent block cache, remeshing all blocks", 1);
+		mPhi.assign(&phi[0], &phi[0] + mPhi.size());
+		dirty.resize(mBlocks.size());
+		for (int b=0; b<(int)mBlocks.size(); b++) dirty[b] = b;
+		remesh(phi, dirty, mesh);
+	}
+	return dirty.size();
+}
 
 } //namespace
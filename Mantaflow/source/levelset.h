@@ -25,12 +25,16 @@ public:
 	PYTHON() LevelsetGrid(FluidSolver* parent, bool show = true);
 	
 	//! reconstruct the levelset using fast marching
+	//! fastIterative uses the parallel fast iterative method instead of the serial marching heap
 	PYTHON() void reinitMarching(FlagGrid& flags, Real maxTime=4.0, 
 			MACGrid* velTransport=NULL, bool ignoreWalls=false, bool correctOuterLayer=true, 
-			int obstacleType = FlagGrid::TypeObstacle );
+			int obstacleType = FlagGrid::TypeObstacle, bool fastIterative = false );
 
 	//! create a triangle mesh from the levelset isosurface
 	PYTHON() void createMesh(Mesh& mesh);
+	//! create a closed, adaptive triangle mesh with octree dual contouring, cells up to 2^maxLevel wide
+	//! are merged where the surface stays within tolerance (RMS, in cells) of a plane or sharp feature
+	PYTHON() void createMeshAdaptive(Mesh& mesh, Real tolerance=0.05, int maxLevel=4);
 	
 	//! union with another levelset
 	PYTHON() void join(const LevelsetGrid& o);
@@ -42,5 +46,68 @@ public:
 	static Real invalidTimeValue();
 };
 
+//! Cells of a narrow band around a levelset surface, -inside <= phi <= outside
+/*! collected once per step and passed to the band-aware variants of the narrow band FLIP
+    functions, so that their cost scales with the surface area instead of the domain volume.
+    Can be used as range for KERNEL(pts) */
+class LevelsetBand {
+public:
+	LevelsetBand() : mSizeX(0), mStrideZ(0) {}
+
+	//! collect the band cells of phi, sorted by index
+	void update(const Grid<Real>& phi, Real inside, Real outside);
+
+	inline IndexInt size() const { return mCells.size(); }
+	//! grid index of the n-th band cell
+	inline IndexInt operator[](IndexInt n) const { return mCells[n]; }
+	//! position of the n-th band cell
+	inline Vec3i getPos(IndexInt n) const { 
+		const IndexInt idx = mCells[n];
+		const IndexInt k = mStrideZ ? idx / mStrideZ : 0, r = idx - k * mStrideZ;
+		return Vec3i( r % mSizeX, r / mSizeX, k );
+	}
+
+protected:
+	std::vector<IndexInt> mCells;
+	IndexInt mSizeX, mStrideZ;
+};
+
+//! cached surface of one block of cells, vertices are identified by the key 3*index(edge base)+axis
+//! of their edge, so that blocks can be stitched
+struct McBlock {
+	std::vector<IndexInt> vertKeys;
+	std::vector<Vec3> vertPos, vertNormal;
+	std::vector<IndexInt> triKeys;
+};
+
+//! Marching cubes with a per-block surface cache
+/*! cells are grouped into blocks of blockSize^3 cells, each block keeps the vertices and triangles
+    it produced. update() only re-polygonizes blocks next to levelset values that changed by more 
+    than tolerance (or changed side or validity) since they were last meshed, so its cost tracks 
+    the changed part of the surface. Cached blocks keep the vertices extracted from the older phi,
+    so the mesh is only identical to createMesh (up to numbering, block by block) with tolerance==0 */
+PYTHON() class IncrementalMesher : public PbClass {
+public:
+	PYTHON() IncrementalMesher(FluidSolver* parent, int blockSize=16, Real tolerance=1e-3);
+
+	//! update mesh to the 0-levelset of phi, returns the number of re-polygonized blocks
+	PYTHON() int update(LevelsetGrid& phi, Mesh& mesh);
+	//! drop the cache, the next update meshes all blocks
+	PYTHON() void reset();
+
+protected:
+	//! polygonize the given blocks and assemble the mesh, returns false if the cache was inconsistent
+	bool remesh(const LevelsetGrid& phi, const std::vector<int>& dirty, Mesh& mesh);
+
+	int mBlockSize;
+	Real mTolerance;
+	Vec3i mGridSize, mNumBlocks;
+	std::vector<McBlock> mBlocks;
+	//! levelset values the blocks were meshed with
+	std::vector<Real> mPhi;
+	//! node index per edge key, only valid for the keys of the current mesh
+	std::vector<int> mEdgeNode;
+};
+
 } //namespace
 #endif
@@ -20,7 +20,10 @@
 #include "kernel.h"
 #include "shapes.h"
 #include "noisefield.h"
+#include "unionfind.h"
 #include <stack>
+#include <algorithm>
+#include <limits>
 
 using namespace std;
 namespace Manta {
@@ -38,19 +41,42 @@ Mesh* Mesh::clone() {
 	return nm;
 }
 
-Real Mesh::computeCenterOfMass(Vec3& cm) const {
-	
-	// use double precision for summation, otherwise too much error accumulation
-	double vol=0;
-	Vector3D<double> cmd(0.0);
-	for(size_t tri=0; tri < mTris.size(); tri++) {
-		Vector3D<double> p1(toVec3d(getNode(tri,0)));
-		Vector3D<double> p2(toVec3d(getNode(tri,1)));
-		Vector3D<double> p3(toVec3d(getNode(tri,2)));
+//! triangles per partial sum of KnMeshMoments
+static const int MomentChunk = 4096;
+
+//! volume and first moment of a closed mesh, summed over the signed tetrahedra of all triangles.
+//! One partial sum per chunk of triangles, so that the total doesn't depend on the number of threads.
+//! use double precision for summation, otherwise too much error accumulation
+KERNEL(pts)
+void KnMeshMoments(vector<double>& vol, vector<Vector3D<double> >& moment, const vector<Triangle>& tris, const vector<Node>& nodes) {
+	const int start = idx*MomentChunk, end = std::min((int)tris.size(), start+MomentChunk);
+	double v = 0;
+	Vector3D<double> m(0.);
+	for (int t=start; t<end; t++) {
+		Vector3D<double> p1(toVec3d(nodes[tris[t].c[0]].pos));
+		Vector3D<double> p2(toVec3d(nodes[tris[t].c[1]].pos));
+		Vector3D<double> p3(toVec3d(nodes[tris[t].c[2]].pos));
 		
 		double cvol = dot(cross(p1,p2),p3) / 6.0;        
-		cmd += (p1+p2+p3) * (cvol/4.0);
-		vol += cvol;
+		m += (p1+p2+p3) * (cvol/4.0);
+		v += cvol;
+	}
+	vol[idx] = v;
+	moment[idx] = m;
+}
+
+Real Mesh::computeCenterOfMass(Vec3& cm) const {
+	const int numChunks = (mTris.size() + MomentChunk-1) / MomentChunk;
+	vector<double> chunkVol(numChunks);
+	vector<Vector3D<double> > chunkMoment(numChunks);
+	KnMeshMoments(chunkVol, chunkMoment, mTris, mNodes);
+	
+	// add the chunks in order
+	double vol = 0;
+	Vector3D<double> cmd(0.);
+	for (int c=0; c<numChunks; c++) {
+		vol += chunkVol[c];
+		cmd += chunkMoment[c];
 	}
 	if (vol != 0.0) cmd /= vol;    
 	
@@ -141,44 +167,88 @@ void Mesh::resizeNodes(int numNodes) {
 void Mesh::rebuildQuickCheck() {
 	if(mCorners.size() != 3*mTris.size())
 		rebuildCorners();
-	if(m1RingLookup.size() != mNodes.size())
+	if(m1RingLookup.numNodes() != (int)mNodes.size())
 		rebuildLookup();
 }
 
+//! counting sort of the items [from,to) by key, in CSR layout: items with key n are 
+//! list[start[n]] .. list[start[n+1]-1], in ascending order
+static void bucketByKey(const vector<int>& keys, int from, int to, int numKeys, vector<int>& start, vector<int>& list) {
+	start.assign(numKeys+1, 0);
+	for (int i=from; i<to; i++) 
+		start[keys[i]+1]++;
+	for (int n=0; n<numKeys; n++) 
+		start[n+1] += start[n];
+	vector<int> fill(start.begin(), start.end()-1);
+	list.resize(to-from);
+	for (int i=from; i<to; i++) 
+		list[fill[keys[i]]++] = i;
+}
+
+KERNEL(pts)
+void knSetupCorners(const vector<Triangle>& tris, vector<Corner>& corners, const int from, const int to) {
+	if (idx<from || idx>=to) return;
+	for (int c=0; c<3; c++) {
+		const int i = idx*3+c;
+		corners[i].tri = idx;
+		corners[i].node = tris[idx].c[c];
+		corners[i].next = 3*idx+((c+1)%3);
+		corners[i].prev = 3*idx+((c+2)%3);
+		corners[i].opposite = -1;
+	}
+}
+
+//! lower and higher node of the edge opposite to a corner, for the corners [from,to)
+KERNEL(pts)
+void knOppositeEdgeNodes(const vector<Corner>& corners, vector<int>& lowNode, vector<int>& highNode, const int from, const int to) {
+	if (idx<from || idx>=to) return;
+	const int next = corners[corners[idx].next].node;
+	const int prev = corners[corners[idx].prev].node;
+	lowNode[idx]  = std::min(next,prev);
+	highNode[idx] = std::max(next,prev);
+}
+
+//! match the corners of one bucket (same lower edge node), each corner is linked to the 
+//! next corner with the same edge, the last one back to its predecessor
+KERNEL(pts)
+void knMatchOpposites(const vector<int>& start, vector<int>& list, const vector<int>& highNode, vector<Corner>& corners) {
+	if (idx+1 >= (IndexInt)start.size()) return;
+	const int s = start[idx], e = start[idx+1];
+	// sort by (high node, corner), buckets are tiny
+	for (int i=s+1; i<e; i++) {
+		const int c = list[i];
+		int j = i;
+		for (; j>s && (highNode[list[j-1]] > highNode[c] || (highNode[list[j-1]] == highNode[c] && list[j-1] > c)); j--)
+			list[j] = list[j-1];
+		list[j] = c;
+	}
+	for (int i=s; i<e; ) {
+		int g = i+1;
+		while (g<e && highNode[list[g]] == highNode[list[i]]) g++;
+		for (int k=i; k<g-1; k++) 
+			corners[list[k]].opposite = list[k+1];
+		if (g-i > 1)
+			corners[list[g-1]].opposite = list[g-2];
+		i = g;
+	}
+}
+
 void Mesh::rebuildCorners(int from, int to) {
 	mCorners.resize(3*mTris.size());
 	if (to < 0) to = mTris.size();        
 	
 	// fill in basic info
-	for (int tri=from; tri<to; tri++) {
-		for (int c=0; c<3; c++) {            
-			const int idx = tri*3+c;
-			mCorners[idx].tri = tri;
-			mCorners[idx].node = mTris[tri].c[c];
-			mCorners[idx].next = 3*tri+((c+1)%3);
-			mCorners[idx].prev = 3*tri+((c+2)%3);
-			mCorners[idx].opposite = -1;
-		}
-	}
+	knSetupCorners(mTris, mCorners, from, to);
 	
-	// set opposite info
-	int maxc = to*3;
-	for (int c=from*3; c<maxc; c++) {  
-		int next = mCorners[mCorners[c].next].node;
-		int prev = mCorners[mCorners[c].prev].node;
-		
-		// find corner with same next/prev nodes
-		for (int c2=c+1; c2<maxc; c2++) {
-			int next2 = mCorners[mCorners[c2].next].node;
-			if (next2 != next && next2 != prev) continue;
-			int prev2 = mCorners[mCorners[c2].prev].node;
-			if (prev2 != next && prev2 != prev) continue;
-			
-			// found
-			mCorners[c].opposite = c2;
-			mCorners[c2].opposite = c;
-			break;
-		}
+	// set opposite info: bucket corners by the lower node of their opposite edge, 
+	// and match the higher node within each bucket
+	const int minc = from*3, maxc = to*3;
+	vector<int> lowNode(maxc), highNode(maxc), start, list;
+	knOppositeEdgeNodes(mCorners, lowNode, highNode, minc, maxc);
+	bucketByKey(lowNode, minc, maxc, mNodes.size(), start, list);
+	knMatchOpposites(start, list, highNode, mCorners);
+	
+	for (int c=minc; c<maxc; c++) {
 		if (mCorners[c].opposite < 0) {
 			// didn't find opposite
 			errMsg("can't rebuild corners, index without an opposite");
@@ -188,16 +258,192 @@ void Mesh::rebuildCorners(int from, int to) {
 	rebuildChannels();
 }
 
+void CompactLists::insert(int i, int v) {
+	const int k = std::lower_bound(begin(i), end(i), v) - begin(i);
+	if (k < count[i] && get(i,k) == v) return;
+	if (count[i] == capacity[i]) 
+		reserve(i, std::max(4, 2*capacity[i]));
+	int* list = &data[start[i]];
+	std::copy_backward(list+k, list+count[i], list+count[i]+1);
+	list[k] = v;
+	count[i]++;
+}
+
+void CompactLists::erase(int i, int v) {
+	const int k = std::lower_bound(begin(i), end(i), v) - begin(i);
+	if (k == count[i] || get(i,k) != v) return;
+	int* list = &data[start[i]];
+	std::copy(list+k+1, list+count[i], list+k);
+	count[i]--;
+}
+
+void CompactLists::reserve(int i, int cap) {
+	if (cap <= capacity[i]) return;
+	const int s = data.size();
+	data.resize(s + cap);
+	std::copy(data.begin() + start[i], data.begin() + start[i] + count[i], data.begin() + s);
+	start[i] = s;
+	capacity[i] = cap;
+}
+
+void CompactLists::swap(int i, int j) {
+	std::swap(start[i], start[j]);
+	std::swap(count[i], count[j]);
+	std::swap(capacity[i], capacity[j]);
+}
+
+void CompactLists::resize(int n) {
+	start.resize(n, 0);
+	count.resize(n, 0);
+	capacity.resize(n, 0);
+}
+
+void CompactLists::clear() {
+	start.clear();
+	count.clear();
+	capacity.clear();
+	data.clear();
+}
+
+//! sorted, unique neighbor nodes and triangles of a node, written to the node's corner
+//! range of the scratch arrays, counts returned in numNodes/numTris
+KERNEL(pts)
+void knGatherRing(const vector<int>& cornerStart, const vector<int>& cornerList, const vector<Corner>& corners, 
+		vector<int>& nodeScratch, vector<int>& triScratch, vector<int>& numNodes, vector<int>& numTris) {
+	if (idx+1 >= (IndexInt)cornerStart.size()) return;
+	const int s = cornerStart[idx], e = cornerStart[idx+1];
+	int* nodes = &nodeScratch[0] + 2*s;
+	int* tris  = &triScratch[0] + s;
+	int nn = 0, nt = 0;
+	for (int i=s; i<e; i++) {
+		const Corner& c = corners[cornerList[i]];
+		nodes[nn++] = corners[c.next].node;
+		nodes[nn++] = corners[c.prev].node;
+		// corners are in ascending order, so are their triangles
+		if (nt==0 || tris[nt-1] != c.tri) 
+			tris[nt++] = c.tri;
+	}
+	std::sort(nodes, nodes+nn);
+	numNodes[idx] = std::unique(nodes, nodes+nn) - nodes;
+	numTris[idx]  = nt;
+}
+
+KERNEL(pts)
+void knFillCompactRing(const vector<int>& cornerStart, const vector<int>& nodeScratch, const vector<int>& triScratch, CompactOneRing& ring) {
+	if (idx+1 >= (IndexInt)cornerStart.size()) return;
+	const int s = cornerStart[idx];
+	std::copy(&nodeScratch[2*s], &nodeScratch[2*s] + ring.nodes.num(idx), ring.nodes.data.begin() + ring.nodes.start[idx]);
+	std::copy(&triScratch[s], &triScratch[s] + ring.tris.num(idx), ring.tris.data.begin() + ring.tris.start[idx]);
+}
+
+void Mesh::computeCompact1Ring(CompactOneRing& ring) const {
+	const int numNodes = mNodes.size(), numCorners = 3*mTris.size();
+	if ((int)mCorners.size() != numCorners)
+		errMsg("corners are out of date, call rebuildCorners first");
+	
+	// corners of each node, then their ring per node in parallel
+	vector<int> nodeOfCorner(numCorners), cornerStart, cornerList;
+	for (int c=0; c<numCorners; c++) 
+		nodeOfCorner[c] = mCorners[c].node;
+	bucketByKey(nodeOfCorner, 0, numCorners, numNodes, cornerStart, cornerList);
+	
+	vector<int> nodeScratch(2*numCorners), triScratch(numCorners);
+	ring.clear();
+	ring.resize(numNodes);
+	knGatherRing(cornerStart, cornerList, mCorners, nodeScratch, triScratch, ring.nodes.count, ring.tris.count);
+	
+	// lists are packed without slack
+	int numRingNodes = 0, numRingTris = 0;
+	for (int n=0; n<numNodes; n++) {
+		ring.nodes.start[n] = numRingNodes;
+		ring.tris.start[n]  = numRingTris;
+		numRingNodes += ring.nodes.count[n];
+		numRingTris  += ring.tris.count[n];
+	}
+	ring.nodes.capacity = ring.nodes.count;
+	ring.tris.capacity = ring.tris.count;
+	ring.nodes.data.resize(numRingNodes);
+	ring.tris.data.resize(numRingTris);
+	knFillCompactRing(cornerStart, nodeScratch, triScratch, ring);
+}
+
+//! unite each triangle with its edge neighbors, uf has one set per triangle (corners.size()/3)
+KERNEL(pts)
+void knUniteAcrossEdges(UnionFind& uf, const vector<Corner>& corners) {
+	for (int c=0; c<3; c++) {
+		const int op = corners[3*idx+c].opposite;
+		if (op >= 0) uf.unite(idx, corners[op].tri);
+	}
+}
+
+KERNEL(pts)
+void knFindRoots(vector<int>& label, UnionFind& uf) {
+	label[idx] = uf.find(idx);
+}
+
+KERNEL(pts)
+void knRootToComponent(vector<int>& label, const vector<int>& rootId) {
+	label[idx] = rootId[label[idx]];
+}
+
+KERNEL(pts)
+void knComponentBounds(vector<int>& numTris, vector<Vec3>& bbMin, vector<Vec3>& bbMax, const vector<int>& start, 
+		const vector<int>& list, const vector<Triangle>& tris, const vector<Node>& nodes) {
+	numTris[idx] = start[idx+1] - start[idx];
+	Vec3 lo = nodes[tris[list[start[idx]]].c[0]].pos, hi = lo;
+	for (int i=start[idx]; i<start[idx+1]; i++) {
+		for (int c=0; c<3; c++) {
+			const Vec3& p = nodes[tris[list[i]].c[c]].pos;
+			for (int d=0; d<3; d++) {
+				lo[d] = std::min(lo[d], p[d]);
+				hi[d] = std::max(hi[d], p[d]);
+			}
+		}
+	}
+	bbMin[idx] = lo;
+	bbMax[idx] = hi;
+}
+
+void Mesh::computeComponents(MeshComponents& comps) const {
+	const int numTris = mTris.size();
+	if ((int)mCorners.size() != 3*numTris)
+		errMsg("corners are out of date, call rebuildCorners first");
+	
+	// union over shared edges, the root of each set is its first triangle
+	UnionFind uf(numTris);
+	knUniteAcrossEdges(uf, mCorners);
+	comps.label.resize(numTris);
+	knFindRoots(comps.label, uf);
+	
+	vector<int> rootId(numTris, -1);
+	int num = 0;
+	for (int t=0; t<numTris; t++) 
+		if (comps.label[t] == t) rootId[t] = num++;
+	knRootToComponent(comps.label, rootId);
+	
+	// sizes and bounds per component from the triangle buckets
+	vector<int> start, list;
+	bucketByKey(comps.label, 0, numTris, num, start, list);
+	comps.size.resize(num);
+	comps.bbMin.resize(num);
+	comps.bbMax.resize(num);
+	knComponentBounds(comps.size, comps.bbMin, comps.bbMax, start, list, mTris, mNodes);
+}
+
 void Mesh::rebuildLookup(int from, int to) {
-	if (from==0 && to<0) m1RingLookup.clear();
+	if (from==0 && to<0) {
+		// full rebuild, packed lists built in parallel
+		computeCompact1Ring(m1RingLookup);
+		return;
+	}
 	m1RingLookup.resize(mNodes.size());
 	if (to<0) to = mTris.size();
 	from *=3; to *= 3;
 	for (int i=from; i< to; i++) {
 		const int node = mCorners[i].node;
-		m1RingLookup[node].nodes.insert(mCorners[mCorners[i].next].node);
-		m1RingLookup[node].nodes.insert(mCorners[mCorners[i].prev].node);
-		m1RingLookup[node].tris.insert(mCorners[i].tri);
+		m1RingLookup.nodes.insert(node, mCorners[mCorners[i].next].node);
+		m1RingLookup.nodes.insert(node, mCorners[mCorners[i].prev].node);
+		m1RingLookup.tris.insert(node, mCorners[i].tri);
 	}
 }
 
@@ -208,6 +454,21 @@ void Mesh::rebuildChannels() {
 		mNodeChannels[i]->resize(mNodes.size());   
 }
 
+void Mesh::appendNodeChannels(const vector<int>& a, const vector<int>& b, const vector<Real>& alpha) {
+	for(size_t i=0; i<mNodeChannels.size(); i++)
+		mNodeChannels[i]->appendInterpol(a, b, alpha);
+}
+
+void Mesh::appendTriChannels(const vector<int>& from, const vector<Real>& alpha) {
+	for(size_t i=0; i<mTriChannels.size(); i++)
+		mTriChannels[i]->appendSplit(from, alpha);
+}
+
+void Mesh::appendTriChannels(int num) {
+	for(size_t i=0; i<mTriChannels.size(); i++)
+		mTriChannels[i]->appendNew(num);
+}
+
 KERNEL(pts) returns(vector<Vec3> u(size))
 vector<Vec3> KnAdvectMeshInGrid(vector<Node>& nodes, const FlagGrid& flags, const MACGrid& vel, const Real dt) {
 	if (nodes[idx].flags & Mesh::NfFixed) 
@@ -269,8 +530,8 @@ void Mesh::removeTri(int tri) {
 		// update tri lookup
 		for (int c=0; c<3; c++) {
 			int node = mTris[tri].c[c];
-			m1RingLookup[node].tris.erase(oldtri);
-			m1RingLookup[node].tris.insert(tri);
+			m1RingLookup.tris.erase(node, oldtri);
+			m1RingLookup.tris.insert(node, tri);
 		}
 	} 
 
@@ -346,26 +607,25 @@ void Mesh::removeNodes(const vector<int>& deletedNodes) {
 	// renumber 1-ring
 	for(int i=0; i<(int)new_index.size(); i++) {
 		if(new_index[i]!=-1) {
-			m1RingLookup[new_index[i]].nodes.swap(m1RingLookup[newsize+i].nodes);
-			m1RingLookup[new_index[i]].tris.swap(m1RingLookup[newsize+i].tris);
+			m1RingLookup.nodes.swap(new_index[i], newsize+i);
+			m1RingLookup.tris.swap(new_index[i], newsize+i);
 		}
 	}    
 	m1RingLookup.resize(newsize);
 	vector<int> reStack(new_index.size());
+	CompactLists& cs = m1RingLookup.nodes;
 	for(int i=0; i<newsize; i++) {
-		set<int>& cs = m1RingLookup[i].nodes;
 		int reNum = 0;
 		// find all nodes > newsize
-		set<int>::reverse_iterator itend = cs.rend();
-		for (set<int>::reverse_iterator it = cs.rbegin(); it != itend; ++it) {
-			if (*it < newsize) break;
+		for (const int* it = cs.end(i); it != cs.begin(i); ) {
+			if (*--it < newsize) break;
 			reStack[reNum++] = *it;
 		}
 		// kill them and insert shifted values
 		if (reNum > 0) {
-			cs.erase(cs.find(reStack[reNum-1]), cs.end());        
+			cs.count[i] -= reNum;
 			for (int j=0; j<reNum; j++) {
-				cs.insert(new_index[reStack[j]-newsize]);
+				cs.insert(i, new_index[reStack[j]-newsize]);
 #ifdef DEBUG
 				 if (new_index[reStack[j]-newsize] == -1)
 					errMsg("invalid node present in 1-ring set");
@@ -375,25 +635,106 @@ void Mesh::removeNodes(const vector<int>& deletedNodes) {
 	}
 }
 
+//! new index of each kept element, -1 for deleted ones, returns the number of kept elements
+static int compactIndex(const vector<char>& deleted, vector<int>& newIndex) {
+	newIndex.resize(deleted.size());
+	int num = 0;
+	for (size_t i=0; i<deleted.size(); i++) 
+		newIndex[i] = deleted[i] ? -1 : num++;
+	return num;
+}
+
+KERNEL(pts)
+void knCompactNodes(const vector<Node>& src, vector<Node>& dst, const vector<int>& newNode) {
+	if (newNode[idx] >= 0) 
+		dst[newNode[idx]] = src[idx];
+}
+
+KERNEL(pts)
+void knCompactTris(const vector<Triangle>& src, vector<Triangle>& dst, const vector<int>& newTri, const vector<int>& newNode) {
+	const int t = newTri[idx];
+	if (t < 0) return;
+	dst[t] = src[idx];
+	for (int c=0; c<3; c++) 
+		dst[t].c[c] = newNode[src[idx].c[c]];
+}
+
+//! corners of kept triangles, opposites into deleted triangles are cut
+KERNEL(pts)
+void knCompactCorners(const vector<int>& newTri, const vector<int>& newNode, const vector<Corner>& src, vector<Corner>& dst) {
+	const int t = newTri[idx];
+	if (t < 0) return;
+	for (int c=0; c<3; c++) {
+		const Corner& o = src[3*idx+c];
+		Corner& n = dst[3*t+c];
+		n.tri = t;
+		n.node = newNode[o.node];
+		n.next = 3*t+((c+1)%3);
+		n.prev = 3*t+((c+2)%3);
+		n.opposite = -1;
+		if (o.opposite >= 0 && newTri[o.opposite/3] >= 0) 
+			n.opposite = 3*newTri[o.opposite/3] + o.opposite%3;
+	}
+}
+
+void Mesh::compact(const vector<char>& deletedTris, const vector<char>& deletedNodes) {
+	assertMsg(deletedTris.size() == mTris.size() && deletedNodes.size() == mNodes.size(), "compact: flag arrays don't match mesh size");
+	const bool haveCorners = mCorners.size() == 3*mTris.size();
+	vector<int> newTri, newNode;
+	const int numTris  = compactIndex(deletedTris,  newTri);
+	const int numNodes = compactIndex(deletedNodes, newNode);
+#ifdef DEBUG
+	for (size_t t=0; t<mTris.size(); t++)
+		for (int c=0; c<3; c++)
+			if (newTri[t]>=0 && newNode[mTris[t].c[c]]<0)
+				errMsg("compact: kept triangle references a deleted node");
+#endif
+
+	vector<Node> nodes(numNodes);
+	knCompactNodes(mNodes, nodes, newNode);
+	mNodes.swap(nodes);
+	vector<Triangle> tris(numTris);
+	knCompactTris(mTris, tris, newTri, newNode);
+	mTris.swap(tris);
+
+	for (size_t i=0; i<mNodeChannels.size(); i++)
+		mNodeChannels[i]->compact(newNode, numNodes);
+	for (size_t i=0; i<mTriChannels.size(); i++)
+		mTriChannels[i]->compact(newTri, numTris);
+
+	if (haveCorners) {
+		vector<Corner> corners(3*numTris);
+		knCompactCorners(newTri, newNode, mCorners, corners);
+		mCorners.swap(corners);
+		rebuildLookup();
+	} else {
+		// stale anyway, rebuildQuickCheck will redo both
+		mCorners.clear();
+		m1RingLookup.clear();
+	}
+}
+
 void Mesh::mergeNode(int node, int delnode) {
-	set<int>& ring = m1RingLookup[delnode].nodes;
-	for(set<int>::iterator it = ring.begin(); it != ring.end(); ++it) {
-		m1RingLookup[*it].nodes.erase(delnode);
-		if (*it != node) {
-			m1RingLookup[*it].nodes.insert(node);
-			m1RingLookup[node].nodes.insert(*it);
+	// delnode's lists don't move, only the others grow
+	CompactLists& ring = m1RingLookup.nodes;
+	for (int i=0; i<ring.num(delnode); i++) {
+		const int n = ring.get(delnode, i);
+		ring.erase(n, delnode);
+		if (n != node) {
+			ring.insert(n, node);
+			ring.insert(node, n);
 		}
 	}
-	set<int>& ringt = m1RingLookup[delnode].tris;
-	for(set<int>::iterator it = ringt.begin(); it != ringt.end(); ++it) {
-		const int t = *it;
+	CompactLists& ringt = m1RingLookup.tris;
+	for (int i=0; i<ringt.num(delnode); i++) {
+		const int t = ringt.get(delnode, i);
 		for (int c=0; c<3; c++) {
 			if (mCorners[3*t+c].node == delnode) {
 				mCorners[3*t+c].node = node;
 				mTris[t].c[c] = node;
 			}
 		}
-		m1RingLookup[node].tris.insert(t);
+		ringt.insert(node, t);
 	}
 	for(size_t i=0; i<mNodeChannels.size(); i++) { 
 		// weight is fixed to 1/2 for now
@@ -401,10 +742,22 @@ void Mesh::mergeNode(int node, int delnode) {
 	}
 }
 
+void Mesh::reserveMerge(int node, int delnode) {
+	CompactLists& ring = m1RingLookup.nodes;
+	ring.reserve(node, ring.num(node) + ring.num(delnode));
+	// neighbors swap delnode for node, they only grow if their ring misses delnode
+	for (int i=0; i<ring.num(delnode); i++) {
+		const int n = ring.get(delnode, i);
+		if (!ring.contains(n, delnode)) 
+			ring.reserve(n, ring.num(n)+1);
+	}
+	m1RingLookup.tris.reserve(node, m1RingLookup.tris.num(node) + m1RingLookup.tris.num(delnode));
+}
+
 void Mesh::removeTriFromLookup(int tri) {
 	for(int c=0; c<3; c++) {
 		int node = mTris[tri].c[c];
-		m1RingLookup[node].tris.erase(tri);
+		m1RingLookup.tris.erase(node, tri);
 	}
 }
 
@@ -417,58 +770,116 @@ int Mesh::addTri(Triangle a) {
 	for (int c=0;c<3;c++) {
 		int node = a.c[c];
 		int nextnode = a.c[(c+1)%3];
-		if ((int)m1RingLookup.size() <= node) m1RingLookup.resize(node+1);
-		if ((int)m1RingLookup.size() <= nextnode) m1RingLookup.resize(nextnode+1);
-		m1RingLookup[node].nodes.insert(nextnode);
-		m1RingLookup[nextnode].nodes.insert(node);
-		m1RingLookup[node].tris.insert(mTris.size()-1);
+		if (m1RingLookup.numNodes() <= node) m1RingLookup.resize(node+1);
+		if (m1RingLookup.numNodes() <= nextnode) m1RingLookup.resize(nextnode+1);
+		m1RingLookup.nodes.insert(node, nextnode);
+		m1RingLookup.nodes.insert(nextnode, node);
+		m1RingLookup.tris.insert(node, mTris.size()-1);
 	}
 	return mTris.size()-1;
 }
 
 int Mesh::addNode(Node a) {
 	mNodes.push_back(a);
-	if (m1RingLookup.size() < mNodes.size())
+	if (m1RingLookup.numNodes() < (int)mNodes.size())
 		m1RingLookup.resize(mNodes.size());
 	return mNodes.size()-1;
 }
 
+//! face normal contribution of each triangle corner, weighted by the inverse squared lengths of the adjacent edges
+KERNEL(pts)
+void knCornerNormals(const vector<Triangle>& tris, const vector<Node>& nodes, vector<Vec3>& cornerNormal) {
+	const Vec3 p0 = nodes[tris[idx].c[0]].pos, p1 = nodes[tris[idx].c[1]].pos, p2 = nodes[tris[idx].c[2]].pos;
+	const Vec3 n0 = p0-p1, n1 = p1-p2, n2 = p2-p0;
+	const Real l0 = normSquare(n0), l1 = normSquare(n1), l2 = normSquare(n2);
+	const Vec3 nm = cross(n0,n1);
+	cornerNormal[3*idx+0] = nm * (1.0 / (l0*l2));
+	cornerNormal[3*idx+1] = nm * (1.0 / (l0*l1));
+	cornerNormal[3*idx+2] = nm * (1.0 / (l1*l2));
+}
+
+//! corner normals, and the corners of each node in CSR layout (ascending, ie. in triangle order)
+static void cornerNormalsByNode(const vector<Triangle>& tris, const vector<Node>& nodes, vector<Vec3>& cornerNormal, 
+		vector<int>& start, vector<int>& list) {
+	const int numCorners = 3*tris.size(), numNodes = nodes.size();
+	cornerNormal.resize(numCorners);
+	if (numCorners > 0) knCornerNormals(tris, nodes, cornerNormal);
+	
+	start.assign(numNodes+1, 0);
+	for (int t=0; t<(int)tris.size(); t++) 
+		for (int c=0; c<3; c++) start[tris[t].c[c]+1]++;
+	for (int n=0; n<numNodes; n++) 
+		start[n+1] += start[n];
+	vector<int> fill(start.begin(), start.end()-1);
+	list.resize(numCorners);
+	for (int t=0; t<(int)tris.size(); t++) 
+		for (int c=0; c<3; c++) list[fill[tris[t].c[c]]++] = 3*t+c;
+}
+
+//! normalized sum of the corner normals of a node, same summation order as a serial loop over the triangles
+static inline Vec3 nodeNormal(const vector<Vec3>& cornerNormal, const vector<int>& start, const vector<int>& list, int node) {
+	Vec3 n(0.);
+	for (int i=start[node]; i<start[node+1]; i++) 
+		n += cornerNormal[list[i]];
+	return getNormalized(n);
+}
+
+KERNEL(pts)
+void knNodeNormals(vector<Node>& nodes, const vector<Vec3>& cornerNormal, const vector<int>& start, const vector<int>& list) {
+	nodes[idx].normal = nodeNormal(cornerNormal, start, list, idx);
+}
+
 void Mesh::computeVertexNormals() {
-	for (size_t i=0; i<mNodes.size(); i++) {
-		mNodes[i].normal = 0.0;
-	}
-	for (size_t t=0; t<mTris.size(); t++) {
-		Vec3 p0 = getNode(t,0), p1 = getNode(t,1), p2 = getNode(t,2);        
-		Vec3 n0 = p0-p1, n1 = p1-p2, n2 = p2-p0;
-		Real l0 = normSquare(n0), l1 = normSquare(n1), l2 = normSquare(n2);
-		
-		Vec3 nm = cross(n0,n1);
-		
-		mNodes[mTris[t].c[0]].normal += nm * (1.0 / (l0*l2));
-		mNodes[mTris[t].c[1]].normal += nm * (1.0 / (l0*l1));
-		mNodes[mTris[t].c[2]].normal += nm * (1.0 / (l1*l2));
-	}
-	for (size_t i=0; i<mNodes.size(); i++) {
-		normalize(mNodes[i].normal);
+	if (mNodes.empty()) return;
+	vector<Vec3> cornerNormal;
+	vector<int> start, list;
+	cornerNormalsByNode(mTris, mNodes, cornerNormal, start, list);
+	knNodeNormals(mNodes, cornerNormal, start, list);
+}
+
+KERNEL(pts)
+void knWriteRenderVertices(const vector<Node>& nodes, const vector<Vec3>& cornerNormal, const vector<int>& start, 
+		const vector<int>& list, float* vertexData, const int stride, const int normalOffset) {
+	float* v = vertexData + (size_t)idx*stride;
+	const Vec3 n = nodeNormal(cornerNormal, start, list, idx);
+	for (int d=0; d<3; d++) {
+		v[d] = (float)nodes[idx].pos[d];
+		v[normalOffset+d] = (float)n[d];
 	}
 }
 
+KERNEL(pts)
+void knWriteRenderIndices(const vector<Triangle>& tris, unsigned int* indexData) {
+	for (int c=0; c<3; c++) 
+		indexData[3*idx+c] = (unsigned int)tris[idx].c[c];
+}
+
+void Mesh::exportRenderBuffers(float* vertexData, unsigned int* indexData, int vertexStride, int normalOffset) const {
+	assertMsg(normalOffset >= 3 && normalOffset+3 <= vertexStride, "normals have to fit into the vertex after the position");
+	if (mNodes.empty()) return;
+	vector<Vec3> cornerNormal;
+	vector<int> start, list;
+	cornerNormalsByNode(mTris, mNodes, cornerNormal, start, list);
+	knWriteRenderVertices(mNodes, cornerNormal, start, list, vertexData, vertexStride, normalOffset);
+	if (!mTris.empty()) knWriteRenderIndices(mTris, indexData);
+}
+
 void Mesh::fastNodeLookupRebuild(int corner) {    
 	int node = mCorners[corner].node;
-	m1RingLookup[node].nodes.clear();
-	m1RingLookup[node].tris.clear();
+	m1RingLookup.nodes.clear(node);
+	m1RingLookup.tris.clear(node);
 	int start = mCorners[corner].prev;
 	int current = start;
 	do {
-		m1RingLookup[node].nodes.insert(mCorners[current].node);
-		m1RingLookup[node].tris.insert(mCorners[current].tri);
+		m1RingLookup.nodes.insert(node, mCorners[current].node);
+		m1RingLookup.tris.insert(node, mCorners[current].tri);
 		current = mCorners[mCorners[current].opposite].next;
 		if (current < 0) 
 			errMsg("Can't use fastNodeLookupRebuild on incomplete surfaces");
 	} while (current != start);
 }
 
-void Mesh::sanityCheck(bool strict, vector<int>* deletedNodes, map<int,bool>* taintedTris) {
+void Mesh::sanityCheck(bool strict, const vector<char>* deletedNodes, const vector<char>* taintedTris) {
 	const int nodes = numNodes(), tris = numTris(), corners = 3*tris;
 	for(size_t i=0; i<mNodeChannels.size(); i++) {
 		if (mNodeChannels[i]->size() != nodes)
@@ -478,10 +889,10 @@ void Mesh::sanityCheck(bool strict, vector<int>* deletedNodes, map<int,bool>* ta
 		if (mTriChannels[i]->size() != tris)
 			errMsg("Tri channel size mismatch");
 	}
-	if ((int)m1RingLookup.size() != nodes)
+	if (m1RingLookup.numNodes() != nodes)
 		errMsg("1Ring size wrong");
 	for(size_t t=0; t<mTris.size(); t++) { 
-		if (taintedTris && taintedTris->find(t) != taintedTris->end()) continue;
+		if (taintedTris && (*taintedTris)[t]) continue;
 		for (int c=0; c<3; c++) {
 			int corner = t*3+c;
 			int node = mTris[t].c[c];
@@ -502,32 +913,26 @@ void Mesh::sanityCheck(bool strict, vector<int>* deletedNodes, map<int,bool>* ta
 				errMsg("opposite missing");
 			if (mCorners[ro].opposite != corner)
 				errMsg("invalid opposite ref");
-			set<int>& rnodes = m1RingLookup[node].nodes;
-			set<int>& rtris = m1RingLookup[node].tris;
-			if (rnodes.find(next) == rnodes.end() || rnodes.find(prev) == rnodes.end()) {
+			const CompactLists& rnodes = m1RingLookup.nodes;
+			if (!rnodes.contains(node, next) || !rnodes.contains(node, prev)) {
 				debMsg("Tri "<< t << " " << node << " " << next << " " << prev , 1);
-				for(set<int>::iterator it= rnodes.begin(); it != rnodes.end(); ++it)
+				for(const int* it = rnodes.begin(node); it != rnodes.end(node); ++it)
 					debMsg( *it , 1);
 				errMsg("node missing in 1ring");
 			}
-			if (rtris.find(t) == rtris.end()) {
+			if (!m1RingLookup.tris.contains(node, t)) {
 			   debMsg("Tri "<< t << " " << node , 1);
 			   errMsg("tri missing in 1ring");
 			}
 		}
 	}
 	for (int n=0; n<nodes; n++) {
-		bool docheck=true;
-		if (deletedNodes)
-			for (size_t e=0; e<deletedNodes->size(); e++)
-				if ((*deletedNodes)[e] == n) docheck=false;;
-		
-		if (docheck) {
-			set<int>& sn = m1RingLookup[n].nodes;
-			set<int>& st = m1RingLookup[n].tris;
+		if (!deletedNodes || !(*deletedNodes)[n]) {
+			const CompactLists& sn = m1RingLookup.nodes;
+			const CompactLists& st = m1RingLookup.tris;
 			set<int> sn2;
 			
-			for (set<int>::iterator it=st.begin(); it != st.end(); ++it) {
+			for (const int* it=st.begin(n); it != st.end(n); ++it) {
 				bool found = false;
 				for (int c=0; c<3; c++) {
 					if (mTris[*it].c[c] == n)
@@ -540,14 +945,15 @@ void Mesh::sanityCheck(bool strict, vector<int>* deletedNodes, map<int,bool>* ta
 					for (int c=0; c<3; c++) cout << mTris[*it].c[c] << endl;
 					errMsg("invalid triangle in 1ring");
 				}
-				if (taintedTris && taintedTris->find(*it) != taintedTris->end()) {
+				if (taintedTris && (*taintedTris)[*it]) {
 					cout << *it << endl;
 					errMsg("tainted tri still is use");
 				}
 			}
-			if (sn.size() != sn2.size())
+			if (sn.num(n) != (int)sn2.size())
 				errMsg("invalid nodes in 1ring");
-			for (set<int>::iterator it=sn.begin(), it2=sn2.begin(); it != sn.end(); ++it,++it2) {
+			set<int>::iterator it2=sn2.begin();
+			for (const int* it=sn.begin(n); it != sn.end(n); ++it,++it2) {
 				if (*it != *it2) {
 					cout << "Node " << n << ": " << *it << " vs " << *it2 << endl;
 					errMsg("node ring mismatch");
@@ -687,8 +1093,231 @@ void Mesh::applyMeshToGrid(GridBase* grid, FlagGrid* respectFlags, Real cutoff)
 #	endif
 }
 
-void Mesh::computeLevelset(LevelsetGrid& levelset, Real sigma, Real cutoff) {
-	meshSDF( *this, levelset, sigma, cutoff); 
+//! squared distance of p to triangle abc (closest point regions as in Ericson, Real-Time Collision Detection)
+static inline Real pointTriangleDistSq(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c) {
+	const Vec3 ab = b-a, ac = c-a, ap = p-a;
+	const Real d1 = dot(ab,ap), d2 = dot(ac,ap);
+	if (d1 <= 0 && d2 <= 0) return normSquare(ap);
+	const Vec3 bp = p-b;
+	const Real d3 = dot(ab,bp), d4 = dot(ac,bp);
+	if (d3 >= 0 && d4 <= d3) return normSquare(bp);
+	const Real vc = d1*d4 - d3*d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return normSquare(ap - ab * (d1 / (d1-d3)));
+	const Vec3 cp = p-c;
+	const Real d5 = dot(ab,cp), d6 = dot(ac,cp);
+	if (d6 >= 0 && d5 <= d6) return normSquare(cp);
+	const Real vb = d5*d2 - d1*d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return normSquare(ap - ac * (d2 / (d2-d6)));
+	const Real va = d3*d6 - d5*d4;
+	if (va <= 0 && (d4-d3) >= 0 && (d5-d6) >= 0) return normSquare(bp - (c-b) * ((d4-d3) / ((d4-d3) + (d5-d6))));
+	const Real denom = 1. / (va+vb+vc);
+	return normSquare(ap - ab * (vb*denom) - ac * (vc*denom));
+}
+
+//! intersection of the ray along axis through (qu,qv) with a triangle. Edge functions are evaluated 
+//! with the lower node index first, and rays exactly through edges or vertices are resolved by 
+//! symbolically shifting the ray by (eps, eps^2), so each crossing of a closed surface counts once
+static inline bool rayTriangleHit(const Vec3* p[3], const int* node, const int axis, const Real qu, const Real qv, Real& hit) {
+	const int u = (axis+1)%3, v = (axis+2)%3;
+	Real w[3];
+	for (int e=0; e<3; e++) {
+		int a = (e+1)%3, b = (e+2)%3;
+		if (node[a] > node[b]) std::swap(a,b);
+		const Real du = (*p[b])[u] - (*p[a])[u], dv = (*p[b])[v] - (*p[a])[v];
+		const Real f  = du * (qv - (*p[a])[v])       - dv * (qu - (*p[a])[u]);
+		const Real fz = du * ((*p[e])[v] - (*p[a])[v]) - dv * ((*p[e])[u] - (*p[a])[u]);
+		// parallel to the ray
+		if (fz == 0) return false;
+		const Real fs = (f != 0) ? f : ((dv != 0) ? -dv : du);
+		if ((fs > 0) != (fz > 0)) return false;
+		w[e] = f / fz;
+	}
+	hit = w[0] * (*p[0])[axis] + w[1] * (*p[1])[axis] + w[2] * (*p[2])[axis];
+	return true;
+}
+
+//! bounding volume hierarchy over the triangles of a mesh, for closest distance and ray queries
+class TriangleBvh {
+public:
+	TriangleBvh(Mesh& mesh, const vector<Vec3>& verts) : mMesh(mesh), mVerts(verts) {
+		const int numTris = mesh.numTris();
+		if (numTris == 0) return;
+		mTriIdx.resize(numTris);
+		vector<Vec3> centers(numTris);
+		for (int t=0; t<numTris; t++) {
+			mTriIdx[t] = t;
+			centers[t] = (vert(t,0) + vert(t,1) + vert(t,2)) / 3.;
+		}
+		mNodes.reserve(2*numTris/LeafSize + 1);
+		build(0, numTris, centers);
+	}
+
+	//! distance to the closest triangle, maxDist if there is none closer
+	Real closestDistance(const Vec3& p, const Real maxDist) const {
+		Real best = maxDist*maxDist;
+		if (mNodes.empty()) return maxDist;
+		int stack[64], top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const BvhNode& node = mNodes[stack[--top]];
+			if (boxDistSq(node, p) >= best) continue;
+			if (node.count > 0) {
+				for (int n=node.start; n<node.start+node.count; n++) {
+					const int t = mTriIdx[n];
+					best = std::min(best, pointTriangleDistSq(p, vert(t,0), vert(t,1), vert(t,2)));
+				}
+				continue;
+			}
+			// visit the closer child first
+			const int l = &node - &mNodes[0] + 1, r = node.right;
+			const bool leftFirst = boxDistSq(mNodes[l], p) <= boxDistSq(mNodes[r], p);
+			stack[top++] = leftFirst ? r : l;
+			stack[top++] = leftFirst ? l : r;
+		}
+		return std::sqrt(best);
+	}
+
+	//! positions along axis of all intersections of the axis-aligned ray through (qu,qv)
+	void rayHits(const int axis, const Real qu, const Real qv, vector<Real>& hits) const {
+		if (mNodes.empty()) return;
+		const int u = (axis+1)%3, v = (axis+2)%3;
+		int stack[64], top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const int n = stack[--top];
+			const BvhNode& node = mNodes[n];
+			if (qu < node.bmin[u] || qu > node.bmax[u] || qv < node.bmin[v] || qv > node.bmax[v]) continue;
+			if (node.count > 0) {
+				for (int i=node.start; i<node.start+node.count; i++) {
+					const int t = mTriIdx[i];
+					const Vec3* p[3] = { &vert(t,0), &vert(t,1), &vert(t,2) };
+					Real hit;
+					if (rayTriangleHit(p, mMesh.tris(t).c, axis, qu, qv, hit)) 
+						hits.push_back(hit);
+				}
+				continue;
+			}
+			stack[top++] = node.right;
+			stack[top++] = n+1;
+		}
+	}
+
+protected:
+	static const int LeafSize = 4;
+	//! left child of an inner node directly follows it, leaves have count > 0
+	struct BvhNode { 
+		Vec3 bmin, bmax; 
+		int start, count, right; 
+	};
+
+	inline const Vec3& vert(int t, int c) const { return mVerts[mMesh.tris(t).c[c]]; }
+
+	static inline Real boxDistSq(const BvhNode& node, const Vec3& p) {
+		Real d = 0;
+		for (int c=0; c<3; c++) {
+			const Real e = std::max(std::max(node.bmin[c] - p[c], p[c] - node.bmax[c]), Real(0));
+			d += e*e;
+		}
+		return d;
+	}
+
+	//! median split along the longest axis of the triangle centers
+	int build(const int start, const int end, const vector<Vec3>& centers) {
+		const int n = mNodes.size();
+		mNodes.push_back(BvhNode());
+		Vec3 bmin(std::numeric_limits<Real>::max()), bmax(-std::numeric_limits<Real>::max());
+		Vec3 cmin = bmin, cmax = bmax;
+		for (int i=start; i<end; i++) {
+			const int t = mTriIdx[i];
+			for (int c=0; c<3; c++) {
+				bmin = vmin(bmin, vert(t,c));
+				bmax = vmax(bmax, vert(t,c));
+			}
+			cmin = vmin(cmin, centers[t]);
+			cmax = vmax(cmax, centers[t]);
+		}
+		mNodes[n].bmin = bmin;
+		mNodes[n].bmax = bmax;
+		mNodes[n].start = start;
+		mNodes[n].count = end-start;
+		mNodes[n].right = -1;
+		if (end-start <= LeafSize) return n;
+		
+		const Vec3 ext = cmax - cmin;
+		const int axis = (ext.x >= ext.y && ext.x >= ext.z) ? 0 : (ext.y >= ext.z ? 1 : 2);
+		const int mid = (start+end)/2;
+		std::nth_element(mTriIdx.begin()+start, mTriIdx.begin()+mid, mTriIdx.begin()+end, CenterLess(centers, axis));
+		mNodes[n].count = 0;
+		build(start, mid, centers);
+		const int right = build(mid, end, centers);
+		mNodes[n].right = right;
+		return n;
+	}
+
+	struct CenterLess {
+		CenterLess(const vector<Vec3>& c, int a) : centers(c), axis(a) {}
+		bool operator()(int a, int b) const { return centers[a][axis] < centers[b][axis]; }
+		const vector<Vec3>& centers;
+		int axis;
+	};
+
+	Mesh& mMesh;
+	const vector<Vec3>& mVerts;
+	vector<BvhNode> mNodes;
+	vector<int> mTriIdx;
+};
+
+//! sorted intersections of the rays through the cell centers of one column along axis
+KERNEL(pts)
+void knMeshRayHits(vector< vector<Real> >& hits, const TriangleBvh& bvh, const Vec3i& gridSize, const int axis) {
+	const int u = (axis+1)%3;
+	const int cu = idx % gridSize[u], cv = idx / gridSize[u];
+	hits[idx].clear();
+	bvh.rayHits(axis, cu+0.5, cv+0.5, hits[idx]);
+	std::sort(hits[idx].begin(), hits[idx].end());
+}
+
+//! distance clamped to cutoff, inside if the parity of crossings below the cell is odd for at least two axes
+KERNEL()
+void knMeshSdfExact(LevelsetGrid& phi, const TriangleBvh& bvh, const vector< vector<Real> >& hitsX, 
+		const vector< vector<Real> >& hitsY, const vector< vector<Real> >& hitsZ, const Real cutoff) {
+	const Vec3 p(i+0.5, j+0.5, k+0.5);
+	const vector<Real>* columns[3] = { &hitsX[j + phi.getSizeY()*k], &hitsY[k + phi.getSizeZ()*i], &hitsZ[i + phi.getSizeX()*j] };
+	int votes = 0;
+	for (int a=0; a<3; a++) {
+		const vector<Real>& h = *columns[a];
+		if ((std::upper_bound(h.begin(), h.end(), p[a]) - h.begin()) % 2) votes++;
+	}
+	const Real d = bvh.closestDistance(p, cutoff);
+	phi(i,j,k) = (votes >= 2) ? -d : d;
+}
+
+static void meshSDFExact(Mesh& mesh, LevelsetGrid& levelset, Real cutoff) {
+	assertMsg(levelset.is3D(), "exact mesh levelsets are only supported for 3D grids");
+	const Vec3i gridRes = levelset.getSize();
+	const Vec3 mult = toVec3(gridRes) / toVec3(mesh.getParent()->getGridSize());
+	
+	// work in levelset grid coordinates
+	vector<Vec3> verts(mesh.numNodes());
+	for (int n=0; n<mesh.numNodes(); n++) 
+		verts[n] = mesh.nodes(n).pos * mult;
+	TriangleBvh bvh(mesh, verts);
+	
+	vector< vector<Real> > hits[3];
+	for (int a=0; a<3; a++) {
+		hits[a].resize(gridRes[(a+1)%3] * gridRes[(a+2)%3]);
+		knMeshRayHits(hits[a], bvh, gridRes, a);
+	}
+	knMeshSdfExact(levelset, bvh, hits[0], hits[1], hits[2], cutoff);
+}
+
+void Mesh::computeLevelset(LevelsetGrid& levelset, Real sigma, Real cutoff, int mode) {
+	if (mode == LevelsetExact)
+		meshSDFExact( *this, levelset, (cutoff<0) ? 2*sigma : cutoff);
+	else if (mode == LevelsetSplat)
+		meshSDF( *this, levelset, sigma, cutoff); 
+	else
+		errMsg("Mesh::computeLevelset(): unknown mode " << mode);
 }
 
 void meshSDF(Mesh& mesh, LevelsetGrid& levelset, Real sigma, Real cutoff)
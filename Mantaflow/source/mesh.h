@@ -21,6 +21,7 @@
 #include "manta.h"
 #include "vectorbase.h"
 #include <set>
+#include <algorithm>
 namespace Manta {
 
 // fwd decl
@@ -69,9 +70,21 @@ struct NodeChannel {
     virtual void addInterpol(int a, int b, Real alpha) = 0;
     virtual void mergeWith(int node, int delnode, Real alpha) = 0;
     virtual void renumber(const std::vector<int>& newIndex, int newsize) = 0;
+    //! keep element i at newIndex[i] (-1: removed), newIndex is ascending for kept elements
+    virtual void compact(const std::vector<int>& newIndex, int newsize) = 0;
+    //! append one interpolated element per entry, same as addInterpol(a[i], b[i], alpha[i]) in order
+    virtual void appendInterpol(const std::vector<int>& a, const std::vector<int>& b, const std::vector<Real>& alpha) {
+        for (size_t i=0; i<a.size(); i++) addInterpol(a[i], b[i], alpha[i]);
+    }
 };
 
+//! interpolation used by the simple channels, overload it for element types without arithmetic operators
+template<class T>
+inline T interpolChannel(const T& a, const T& b, Real alpha) { return (1.0-alpha)*a + alpha*b; }
+
 //! Node channel using only a vector
+/*! interpolates through interpolChannel(), so derived channels don't need to override
+    addInterpol/mergeWith, and bulk appends don't go through a virtual call per element */
 template<class T>
 struct SimpleNodeChannel : public NodeChannel {
     SimpleNodeChannel() {};
@@ -79,8 +92,11 @@ struct SimpleNodeChannel : public NodeChannel {
     void resize(int num) { data.resize(num); }
     virtual int size() { return data.size(); }
     virtual void renumber(const std::vector<int>& newIndex, int newsize);
+    virtual void compact(const std::vector<int>& newIndex, int newsize);
     
-    //virtual void addSplit(int from, Real alpha) { data.push_back(data[from]); }    
+    virtual void addInterpol(int a, int b, Real alpha) { data.push_back(interpolChannel(data[a], data[b], alpha)); }
+    virtual void mergeWith(int node, int delnode, Real alpha) { data[node] = interpolChannel(data[node], data[delnode], alpha); }
+    virtual void appendInterpol(const std::vector<int>& a, const std::vector<int>& b, const std::vector<Real>& alpha);
 
     std::vector<T> data;
 };
@@ -95,6 +111,13 @@ struct TriChannel {
     virtual void addNew() = 0;
     virtual void addSplit(int from, Real alpha) = 0;
     virtual void remove(int tri) = 0;
+    //! keep element i at newIndex[i] (-1: removed), newIndex is ascending for kept elements
+    virtual void compact(const std::vector<int>& newIndex, int newsize) = 0;
+    //! append one element per entry, same as addSplit(from[i], alpha[i]) in order
+    virtual void appendSplit(const std::vector<int>& from, const std::vector<Real>& alpha) {
+        for (size_t i=0; i<from.size(); i++) addSplit(from[i], alpha[i]);
+    }
+    virtual void appendNew(int num) { for (int i=0; i<num; i++) addNew(); }
 };
 
 //! Tri channel using only a vector
@@ -108,14 +131,58 @@ struct SimpleTriChannel : public TriChannel {
         
     virtual void addSplit(int from, Real alpha) { data.push_back(data[from]); }    
     virtual void addNew() { data.push_back(T()); }
+    virtual void compact(const std::vector<int>& newIndex, int newsize);
+    virtual void appendSplit(const std::vector<int>& from, const std::vector<Real>& alpha);
+    virtual void appendNew(int num) { data.resize(data.size()+num); }
     
     std::vector<T> data;
 };
 
-struct OneRing {
-    OneRing() {}
-    std::set<int> nodes;
-    std::set<int> tris;
+//! Sorted int lists, one per element, in one shared pool (CSR layout with slack)
+/*! list i is data[start[i]] .. data[start[i]+count[i]-1] with room for capacity[i] entries,
+    a list that outgrows its capacity is moved to the end of the pool */
+struct CompactLists {
+    std::vector<int> start, count, capacity;
+    std::vector<int> data;
+    
+    inline int size() const { return (int)start.size(); }
+    inline int num(int i) const { return count[i]; }
+    inline int get(int i, int j) const { return data[start[i]+j]; }
+    inline const int* begin(int i) const { return data.data() + start[i]; }
+    inline const int* end(int i) const { return data.data() + start[i] + count[i]; }
+    inline bool contains(int i, int v) const { return std::binary_search(begin(i), end(i), v); }
+    
+    //! sorted insert, does nothing if v is already in list i
+    void insert(int i, int v);
+    void erase(int i, int v);
+    inline void clear(int i) { count[i] = 0; }
+    //! room for cap entries in list i. Inserts within the capacity don't touch the pool,
+    //! so different lists can then be filled in parallel
+    void reserve(int i, int cap);
+    void swap(int i, int j);
+    //! added lists are empty
+    void resize(int n);
+    void clear();
+};
+
+//! One-ring lookup, neighbor nodes and adjacent triangles of each node
+struct CompactOneRing {
+    CompactLists nodes, tris;
+    
+    inline int numNodes() const { return nodes.size(); }
+    inline void resize(int n) { nodes.resize(n); tris.resize(n); }
+    inline void clear() { nodes.clear(); tris.clear(); }
+};
+
+//! Edge-connected triangle components
+/*! label[t] is the component of triangle t, components are numbered in order of their first triangle.
+    bbMin/bbMax enclose the nodes of each component */
+struct MeshComponents {
+    std::vector<int> label;
+    std::vector<int> size;
+    std::vector<Vec3> bbMin, bbMax;
+    
+    inline int num() const { return (int)size.size(); }
 };
 
 //! Triangle mesh class
@@ -130,12 +197,21 @@ public:
     enum NodeFlags { NfNone = 0, NfFixed = 1, NfMarked = 2, NfKillme = 4, NfCollide = 8 };
     enum FaceFlags { FfNone = 0, FfDoubled = 1, FfMarked = 2 };
     enum MeshType { TypeNormal = 0, TypeVortexSheet };
+    //! computeLevelset modes: gaussian splatting of surface samples, or exact narrow band distances
+    enum LevelsetMode { LevelsetSplat = 0, LevelsetExact };
     
     virtual MeshType getType() { return TypeNormal; }
         
     Real computeCenterOfMass(Vec3& cm) const;
     void computeVertexNormals();
     
+    //! float layout of one vertex in exportRenderBuffers, matches the Renderer's Vertex (pos, normal, tangentU, texC)
+    enum RenderLayout { RenderVertexStride = 11, RenderNormalOffset = 3 };
+    //! write positions and vertex normals to vertexData (numNodes() vertices of vertexStride floats each, position first)
+    //! and the triangle node indices to indexData (3*numTris()), both allocated by the caller.
+    //! Normals are computed on the fly like computeVertexNormals, the mesh is not modified and other vertex fields are left untouched
+    void exportRenderBuffers(float* vertexData, unsigned int* indexData, int vertexStride=RenderVertexStride, int normalOffset=RenderNormalOffset) const;
+    
     // plugins
     PYTHON() void clear();
     PYTHON() void load (std::string name, bool append = false);
@@ -145,7 +221,9 @@ public:
     PYTHON() void scale(Vec3 s);
     PYTHON() void offset(Vec3 o);
 
-	PYTHON() void computeLevelset(LevelsetGrid& levelset, Real sigma, Real cutoff=-1.);
+	//! LevelsetExact: closest triangle distances up to cutoff (2*sigma if negative) via a BVH, 
+	//! sign from ray parity along the three axes, requires a closed mesh
+	PYTHON() void computeLevelset(LevelsetGrid& levelset, Real sigma, Real cutoff=-1., int mode=LevelsetSplat);
 	//! map mesh to grid with sdf
 	PYTHON() void applyMeshToGrid(GridBase* grid, FlagGrid* respectFlags=0, Real cutoff=-1.);
     
@@ -175,24 +253,41 @@ public:
     inline const Vec3 getNode(int tri, int c) const { return mNodes[mTris[tri].c[c]].pos; }
     inline Vec3& getNode(int tri, int c) { return mNodes[mTris[tri].c[c]].pos; }
     inline const Vec3 getEdge(int tri, int e) const { return getNode(tri,(e+1)%3) - getNode(tri,e); }
-    inline OneRing& get1Ring(int node) { return m1RingLookup[node]; }
+    inline CompactOneRing& get1RingLookup() { return m1RingLookup; }
     inline Real getFaceArea(int t) { Vec3 c0 = mNodes[mTris[t].c[0]].pos; return 0.5*norm(cross(mNodes[mTris[t].c[1]].pos - c0, mNodes[mTris[t].c[2]].pos - c0)); }
     inline Vec3 getFaceNormal(int t) { Vec3 c0 = mNodes[mTris[t].c[0]].pos; return getNormalized(cross(mNodes[mTris[t].c[1]].pos - c0, mNodes[mTris[t].c[2]].pos - c0)); }
     inline Vec3 getFaceCenter(int t) { return (mNodes[mTris[t].c[0]].pos + mNodes[mTris[t].c[1]].pos + mNodes[mTris[t].c[2]].pos) / 3.0; }
     inline std::vector<Node>& getNodeData() { return mNodes; }
+    inline std::vector<Triangle>& getTriData() { return mTris; }
+    inline std::vector<Corner>& getCornerData() { return mCorners; }
     
     void mergeNode(int node, int delnode);
+    //! make room in the 1-ring of node for merging delnode into it. mergeNode then doesn't grow the
+    //! ring storage, and merges with disjoint 1-rings can run in parallel
+    void reserveMerge(int node, int delnode);
     int addNode(Node a);
     int addTri(Triangle a);
     void addCorner(Corner a);
     void removeTri(int tri);
     void removeTriFromLookup(int tri);
     void removeNodes(const std::vector<int>& deletedNodes);
+    //! remove all flagged triangles and nodes in one pass, the remaining ones keep their order.
+    //! Corners and 1-ring are rebuilt if they were up to date
+    void compact(const std::vector<char>& deletedTris, const std::vector<char>& deletedNodes);
     void rebuildCorners(int from=0, int to=-1);
     void rebuildLookup(int from=0, int to=-1);
     void rebuildQuickCheck();
+    //! build the one-ring from the corner table, corners need to be up to date
+    void computeCompact1Ring(CompactOneRing& ring) const;
+    //! label triangles connected across edges, corners need to be up to date
+    void computeComponents(MeshComponents& comps) const;
     void fastNodeLookupRebuild(int corner);
-    void sanityCheck(bool strict=true, std::vector<int>* deletedNodes=0, std::map<int,bool>* taintedTris=0);
+    void sanityCheck(bool strict=true, const std::vector<char>* deletedNodes=0, const std::vector<char>* taintedTris=0);
+    
+    //! bulk channel updates for appended nodes and triangles, one call per channel
+    void appendNodeChannels(const std::vector<int>& a, const std::vector<int>& b, const std::vector<Real>& alpha);
+    void appendTriChannels(const std::vector<int>& from, const std::vector<Real>& alpha);
+    void appendTriChannels(int num);
     
     void addTriChannel(TriChannel* c) { mTriChannels.push_back(c); rebuildChannels(); }
     void addNodeChannel(NodeChannel* c) { mNodeChannels.push_back(c); rebuildChannels(); }
@@ -205,7 +300,7 @@ protected:
     std::vector<Corner> mCorners;
     std::vector<NodeChannel*> mNodeChannels;
     std::vector<TriChannel*> mTriChannels;
-    std::vector<OneRing> m1RingLookup;
+    CompactOneRing m1RingLookup;
 };
 
 
@@ -223,6 +318,40 @@ void SimpleNodeChannel<T>::renumber(const std::vector<int>& newIndex, int newsiz
     data.resize(newsize);
 }
 
+template<class T>
+void SimpleNodeChannel<T>::compact(const std::vector<int>& newIndex, int newsize) {
+    for(size_t i=0; i<newIndex.size(); i++) {
+        if(newIndex[i]>=0)
+            data[newIndex[i]] = data[i];
+    }
+    data.resize(newsize);
+}
+
+template<class T>
+void SimpleNodeChannel<T>::appendInterpol(const std::vector<int>& a, const std::vector<int>& b, const std::vector<Real>& alpha) {
+    const size_t first = data.size();
+    data.resize(first + a.size());
+    for(size_t i=0; i<a.size(); i++)
+        data[first+i] = interpolChannel(data[a[i]], data[b[i]], alpha[i]);
+}
+
+template<class T>
+void SimpleTriChannel<T>::appendSplit(const std::vector<int>& from, const std::vector<Real>& alpha) {
+    const size_t first = data.size();
+    data.resize(first + from.size());
+    for(size_t i=0; i<from.size(); i++)
+        data[first+i] = data[from[i]];
+}
+
+template<class T>
+void SimpleTriChannel<T>::compact(const std::vector<int>& newIndex, int newsize) {
+    for(size_t i=0; i<newIndex.size(); i++) {
+        if(newIndex[i]>=0)
+            data[newIndex[i]] = data[i];
+    }
+    data.resize(newsize);
+}
+
 
 
 } //namespace
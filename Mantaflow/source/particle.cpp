@@ -26,7 +26,7 @@ namespace Manta {
 
 
 ParticleBase::ParticleBase(FluidSolver* parent) : 
-	PbClass(parent), mAllowCompress(true), mFreePdata(false) {
+	PbClass(parent), mAllowCompress(true), mFreePdata(false), mPooled(false), mDefragRatio(0.25), mPoolIds(NULL), mNextId(0) {
 }
 
 ParticleBase::~ParticleBase()
@@ -64,6 +64,7 @@ void ParticleBase::deregister(ParticleDataBase* pdata) {
 				mPartData[i] = mPartData[mPartData.size()-1];
 			mPartData.pop_back();
 			done = true;
+			if(pdata == mPoolIds) mPoolIds = NULL;
 		}
 	} 
 	if(!done)
@@ -128,6 +129,14 @@ void ParticleBase::addAllPdata() {
 }
 
  
+void ParticleBase::addBuffered(const std::vector< std::vector<Vec3> >& buffers) {
+	size_t num = mNewBuffer.size();
+	for(size_t i=0; i<buffers.size(); ++i) num += buffers[i].size();
+	mNewBuffer.reserve(num);
+	for(size_t i=0; i<buffers.size(); ++i) 
+		mNewBuffer.insert(mNewBuffer.end(), buffers[i].begin(), buffers[i].end());
+}
+
 BasicParticleSystem::BasicParticleSystem(FluidSolver* parent)
 	   : ParticleSystem<BasicParticleData>(parent) {
 	this->mAllowCompress = false;
@@ -222,7 +231,7 @@ void BasicParticleSystem::printParts(IndexInt start, IndexInt stop, bool printIn
 
 	for(IndexInt i=s; i<e; ++i) {
 		if(printIndex) sstr << i<<": ";
-		sstr<<mData[i].pos<<" "<<mData[i].flag<<"\n";
+		sstr<<getPos(i)<<" "<<mData[i].flag<<"\n";
 	} 
 	debMsg( sstr.str() , 1 );
 }
@@ -233,8 +242,7 @@ void BasicParticleSystem::readParticles(BasicParticleSystem* from) {
 	assertMsg (from->size() == this->size() , "particle size doesn't match");
 
 	for(int i=0; i<this->size(); ++i) {
-		(*this)[i].pos  = (*from)[i].pos;
-		(*this)[i].flag = (*from)[i].flag;
+		(*this)[i] = (*from)[i];
 	}
 	Vec3i gridSize = from->getParent()->getGridSize();
 	this->transformPositions( Vec3i(gridSize.x,gridSize.y,gridSize.z), this->size() );
@@ -304,6 +312,13 @@ void ParticleDataImpl<T>::copyValueSlow(IndexInt from, IndexInt to) {
 	this->copyValue(from,to);
 }
 template<class T>
+void ParticleDataImpl<T>::reorder(const std::vector<IndexInt>& order) {
+	assertMsg( order.size() <= mData.size(), "ParticleData::reorder: order too long");
+	std::vector<T> tmp(order.size());
+	KnReorderParticles< std::vector<T> >(tmp, mData, order);
+	mData.swap(tmp);
+}
+template<class T>
 ParticleDataBase* ParticleDataImpl<T>::clone() {
 	ParticleDataImpl<T>* npd = new ParticleDataImpl<T>( getParent(), this );
 	return npd;
@@ -19,6 +19,7 @@
 #include "vectorbase.h"
 #include "integrator.h"
 #include "randomstream.h"
+#include "alignedalloc.h"
 namespace Manta {
 
 // fwd decl
@@ -26,6 +27,27 @@ template<class T> class Grid;
 class ParticleDataBase;
 template<class T> class ParticleDataImpl;
 
+//! Range for KERNEL(pts) over chunks of particles, idx is the chunk number
+class ParticleChunks {
+public:
+	ParticleChunks(IndexInt n, IndexInt chunkSize = 16384) : mN(n), mChunkSize(std::max(chunkSize, (IndexInt)1)) {}
+	IndexInt size() const { return (mN + mChunkSize-1) / mChunkSize; }
+	//! particles [start,end) of chunk c
+	IndexInt start(IndexInt c) const { return c * mChunkSize; }
+	IndexInt end(IndexInt c) const   { return std::min(mN, (c+1) * mChunkSize); }
+private:
+	IndexInt mN, mChunkSize;
+};
+
+//! storage of the particles of a ParticleSystem<S>, array of structs by default
+template<class S> struct ParticleStorage {
+	typedef std::vector<S> type;
+};
+
+//! position access for kernels over any particle storage, see BasicParticleArray for the overloads
+template<class S> inline Vec3 getParticlePos(const std::vector<S>& p, IndexInt idx) { return p[idx].pos; }
+template<class S> inline void setParticlePos(std::vector<S>& p, IndexInt idx, const Vec3& pos) { p[idx].pos = pos; }
+
 //! Baseclass for particle systems. Does not implement any data
 PYTHON() class ParticleBase : public PbClass {
 public:
@@ -53,6 +75,8 @@ public:
 
 	//! add a position as potential candidate for new particle (todo, make usable from parallel threads)
 	inline void addBuffered(const Vec3& pos);
+	//! add candidates collected separately per thread or task, in the order of the buffers
+	void addBuffered(const std::vector< std::vector<Vec3> >& buffers);
 
 	//! particle data functions
 
@@ -89,6 +113,16 @@ protected:
 	std::vector< ParticleDataImpl<int> *>  mPdataInt;
 	//! indicate that pdata of this particle system is copied, and needs to be freed
 	bool mFreePdata;
+
+	//! pooled mode, deleted slots are reused by new particles instead of compressing
+	bool mPooled;
+	//! fraction of free slots that triggers a defragmentation in pooled mode
+	Real mDefragRatio;
+	//! deleted slots that can be reused, ascending
+	std::vector<IndexInt> mFreeSlots;
+	//! optional persistent particle ids, and next id to assign
+	ParticleDataImpl<int>* mPoolIds;
+	IndexInt mNextId;
 };
 
 
@@ -101,9 +135,13 @@ public:
 	
 	virtual SystemType getType() const { return S::getType(); };
 	
+	typedef typename ParticleStorage<S>::type Storage;
+	typedef typename Storage::reference Reference;
+	typedef typename Storage::const_reference ConstReference;
+
 	//! accessors
-	inline S& operator[](IndexInt idx)             { DEBUG_ONLY(checkPartIndex(idx)); return mData[idx]; }
-	inline const S& operator[](IndexInt idx) const { DEBUG_ONLY(checkPartIndex(idx)); return mData[idx]; }
+	inline Reference operator[](IndexInt idx)           { DEBUG_ONLY(checkPartIndex(idx)); return mData[idx]; }
+	inline ConstReference operator[](IndexInt idx) const { DEBUG_ONLY(checkPartIndex(idx)); return mData[idx]; }
 	//! return size of container
 	//! note , python binding disabled for now! cannot yet deal with long-long types
 	inline IndexInt size() const { return mData.size(); }
@@ -115,23 +153,42 @@ public:
 	inline bool isActive(IndexInt idx)  { DEBUG_ONLY(checkPartIndex(idx)); return (mData[idx].flag & PDELETE) == 0; }
 	
 	//! safe accessor for python
-	PYTHON() void setPos(IndexInt idx, const Vec3& pos) { DEBUG_ONLY(checkPartIndex(idx)); mData[idx].pos = pos; }
-	PYTHON() Vec3 getPos(IndexInt idx)                  { DEBUG_ONLY(checkPartIndex(idx)); return mData[idx].pos; }
+	PYTHON() void setPos(IndexInt idx, const Vec3& pos) { DEBUG_ONLY(checkPartIndex(idx)); setParticlePos(mData, idx, pos); }
+	PYTHON() Vec3 getPos(IndexInt idx) const            { DEBUG_ONLY(checkPartIndex(idx)); return getParticlePos(mData, idx); }
 	//! copy all positions into pdata vec3 field
 	PYTHON() void getPosPdata(ParticleDataImpl<Vec3>& target);
 	PYTHON() void setPosPdata(ParticleDataImpl<Vec3>& source);
 	//! transform coordinate system from one grid size to another (usually upon load)
 	void transformPositions( Vec3i dimOld, Vec3i dimNew );
 
-	//! explicitly trigger compression from outside
-	void doCompress() { if ( mDeletes > mDeleteChunk) compress(); }
+	//! explicitly trigger compression from outside, should be called once per step after all deletions
+	//! keepOrder preserves the order of the remaining particles (e.g., after sorting them by cell)
+	//! in pooled mode, this only collects the free slots (and defragments once there are too many)
+	PYTHON() void doCompress(bool keepOrder=false) { 
+		if (mPooled) updatePool(); 
+		else if ( mDeletes > mDeleteChunk) compress(keepOrder); }
+	//! pooled mode: particles keep their index until the next defragmentation, deleted slots are 
+	//! recycled by insertBufferedParticles. ids (a registered int pdata channel, saved with the 
+	//! other pdata) receives a persistent id per particle, keepIds continues existing (e.g., loaded) ids.
+	//! note - not for connected particle systems, segments would refer to recycled slots
+	PYTHON() void enablePool(ParticleDataImpl<int>* ids=NULL, Real defragRatio=0.25, bool keepIds=false);
+	PYTHON() void disablePool() { mPooled = false; mPoolIds = NULL; mFreeSlots.clear(); }
+	PYTHON() bool isPooled() const { return mPooled; }
+	//! number of slots that are currently available for reuse
+	PYTHON() IndexInt getNumFreeSlots() const { return mFreeSlots.size(); }
 	//! insert buffered positions as new particles, update additional particle data
 	void insertBufferedParticles();
 	//! resize data vector, and all pdata fields
 	void resizeAll(IndexInt newsize);
+	//! permute particles and all pdata fields, new particle i is old particle order[i]
+	//! order can be shorter than size(), remaining particles are dropped
+	virtual void reorder(const std::vector<IndexInt>& order);
 	
 	//! adding and deleting 
 	inline void kill(IndexInt idx);
+	//! kill for kernels, doesn't count the deletion, report the number with addDeleteCount afterwards
+	inline void killUncounted(IndexInt idx) { DEBUG_ONLY(checkPartIndex(idx)); mData[idx].flag |= PDELETE; }
+	inline void addDeleteCount(IndexInt num) { mDeletes += num; }
 	IndexInt add(const S& data);
 	//! remove all particles, init 0 length arrays (also pdata)
 	PYTHON() void clear();
@@ -152,10 +209,18 @@ protected:
 	//! deletion count , and interval for re-compressing 
 	IndexInt mDeletes, mDeleteChunk;    
 	//! the particle data
-	std::vector<S> mData;    
+	Storage mData;    
 
 	//! reduce storage , called by doCompress
-	virtual void compress(); 
+	virtual void compress(bool keepOrder=false); 
+	//! compute the particles that are moved by compress(), returns the new size
+	//! keepOrder: src holds all remaining particles in order 
+	//! otherwise: deleted particles dst[i] in front are filled with remaining ones src[i] from the back
+	IndexInt getCompressMoves(std::vector<IndexInt>& src, std::vector<IndexInt>& dst, bool keepOrder);
+	//! apply the moves from getCompressMoves, shrinks the system to newSize
+	void applyCompressMoves(const std::vector<IndexInt>& src, const std::vector<IndexInt>& dst, IndexInt newSize, bool keepOrder);
+	//! pooled mode, collect the free slots or defragment
+	void updatePool();
 };
 
 //******************************************************************************
@@ -172,6 +237,69 @@ public:
 	int  flag;
 };
 
+//! Reference to one particle of a BasicParticleArray, behaves like BasicParticleData& for whole
+//! particle copies and for the flag; the position is stored per axis, so it is only available
+//! by value (getPos) and through setPos
+struct BasicParticleRef {
+	BasicParticleRef(Real& x, Real& y, Real& z, int& flag) : x(x), y(y), z(z), flag(flag) {}
+	BasicParticleRef& operator=(const BasicParticleRef& o) { x = o.x; y = o.y; z = o.z; flag = o.flag; return *this; }
+	BasicParticleRef& operator=(const BasicParticleData& o) { setPos(o.pos); flag = o.flag; return *this; }
+	operator BasicParticleData() const { BasicParticleData d(getPos()); d.flag = flag; return d; }
+	inline Vec3 getPos() const { return Vec3(x, y, z); }
+	inline void setPos(const Vec3& p) { x = p.x; y = p.y; z = p.z; }
+
+	Real &x, &y, &z;
+	int&  flag;
+};
+struct BasicParticleConstRef {
+	BasicParticleConstRef(const Real& x, const Real& y, const Real& z, const int& flag) : x(x), y(y), z(z), flag(flag) {}
+	operator BasicParticleData() const { BasicParticleData d(getPos()); d.flag = flag; return d; }
+	inline Vec3 getPos() const { return Vec3(x, y, z); }
+
+	const Real &x, &y, &z;
+	const int&  flag;
+};
+
+//! Particle storage with separate, aligned x, y, z and flag arrays (structure of arrays)
+/*! kernels that only check flags, or only read positions, touch 4 or 12 bytes per particle
+    instead of the full BasicParticleData, and loops over the raw arrays can be vectorized */
+class BasicParticleArray {
+public:
+	typedef BasicParticleData     value_type;
+	typedef BasicParticleRef      reference;
+	typedef BasicParticleConstRef const_reference;
+	typedef std::vector<Real, AlignedAllocator<Real> > RealArray;
+	typedef std::vector<int,  AlignedAllocator<int> >  IntArray;
+
+	inline size_t size() const { return mFlag.size(); }
+	void resize(size_t n) { mX.resize(n, 0.); mY.resize(n, 0.); mZ.resize(n, 0.); mFlag.resize(n, 0); }
+	void clear() { mX.clear(); mY.clear(); mZ.clear(); mFlag.clear(); }
+	void push_back(const BasicParticleData& d) { mX.push_back(d.pos.x); mY.push_back(d.pos.y); mZ.push_back(d.pos.z); mFlag.push_back(d.flag); }
+
+	inline reference       operator[](IndexInt idx)       { return reference      (mX[idx], mY[idx], mZ[idx], mFlag[idx]); }
+	inline const_reference operator[](IndexInt idx) const { return const_reference(mX[idx], mY[idx], mZ[idx], mFlag[idx]); }
+
+	inline Vec3 getPos(IndexInt idx) const { return Vec3(mX[idx], mY[idx], mZ[idx]); }
+	inline void setPos(IndexInt idx, const Vec3& p) { mX[idx] = p.x; mY[idx] = p.y; mZ[idx] = p.z; }
+
+	//! raw access to the arrays, c is the axis
+	inline Real* getPosData(int c)             { return c==0 ? &mX[0] : (c==1 ? &mY[0] : &mZ[0]); }
+	inline const Real* getPosData(int c) const { return c==0 ? &mX[0] : (c==1 ? &mY[0] : &mZ[0]); }
+	inline int*  getFlagData()                 { return &mFlag[0]; }
+	inline const int* getFlagData() const      { return &mFlag[0]; }
+
+protected:
+	RealArray mX, mY, mZ;
+	IntArray  mFlag;
+};
+
+inline Vec3 getParticlePos(const BasicParticleArray& p, IndexInt idx) { return p.getPos(idx); }
+inline void setParticlePos(BasicParticleArray& p, IndexInt idx, const Vec3& pos) { p.setPos(idx, pos); }
+
+template<> struct ParticleStorage<BasicParticleData> {
+	typedef BasicParticleArray type;
+};
+
 PYTHON() class BasicParticleSystem : public ParticleSystem<BasicParticleData> {
 public:
 	PYTHON() BasicParticleSystem(FluidSolver* parent);
@@ -193,7 +321,7 @@ public:
 	PYTHON() void addParticle(Vec3 pos) { add(BasicParticleData(pos)); }
 
 	//! dangerous, get low level access - avoid usage, only used in vortex filament advection for now
-	std::vector<BasicParticleData>& getData() { return mData; }
+	BasicParticleArray& getData() { return mData; }
 
 	PYTHON() void printParts(IndexInt start=-1, IndexInt stop=-1, bool printIndex=false); 
 };
@@ -243,10 +371,12 @@ public:
 	inline const CON& seg(int i) const { return mSegments[i]; }
 		
 	virtual ParticleBase* clone();
+	//! not supported, the segments refer to particle indices
+	virtual void reorder(const std::vector<IndexInt>&) { errMsg("ConnectedParticleSystem: reordering particles would break the segments"); }
 	
 protected:
 	std::vector<CON> mSegments;
-	virtual void compress();    
+	virtual void compress(bool keepOrder=false);    
 };
 
 //******************************************************************************
@@ -267,6 +397,7 @@ public:
 	virtual PdataType getType() const { assertMsg( false , "Dont use, override..."); return TypeNone; } 
 	virtual void resize(IndexInt size)     { assertMsg( false , "Dont use, override..."); return;  }
 	virtual void copyValueSlow(IndexInt from, IndexInt to) { assertMsg( false , "Dont use, override..."); return;  }
+	virtual void reorder(const std::vector<IndexInt>&) { assertMsg( false , "Dont use, override..."); return;  }
 
 	//! set base pointer
 	void setParticleSys(ParticleBase* set) { mpParticleSys = set; }
@@ -307,6 +438,7 @@ public:
 	virtual PdataType getType() const;
 	virtual void resize(IndexInt s);
 	virtual void copyValueSlow(IndexInt from, IndexInt to);
+	virtual void reorder(const std::vector<IndexInt>& order);
 
 	IndexInt  size() const { return mData.size(); }
 
@@ -366,6 +498,7 @@ void ParticleBase::addBuffered(const Vec3& pos) {
 template<class S>
 void ParticleSystem<S>::clear() {
 	mDeleteChunk = mDeletes = 0;
+	mFreeSlots.clear();
 	this->resizeAll(0); // instead of mData.clear
 }
 
@@ -374,6 +507,7 @@ IndexInt ParticleSystem<S>::add(const S& data) {
 	mData.push_back(data); 
 	mDeleteChunk = mData.size() / DELETE_PART;
 	this->addAllPdata();
+	if (mPoolIds) (*mPoolIds)[mData.size()-1] = (int)(mNextId++);
 	return mData.size()-1;
 }
 
@@ -381,7 +515,7 @@ template<class S>
 inline void ParticleSystem<S>::kill(IndexInt idx)     { 
 	assertMsg(idx>=0 && idx<size(), "Index out of bounds");
 	mData[idx].flag |= PDELETE; 
-	if ( (++mDeletes > mDeleteChunk) && (mAllowCompress) ) compress(); 
+	++mDeletes;
 }
 
 template<class S>
@@ -393,7 +527,7 @@ void ParticleSystem<S>::getPosPdata(ParticleDataImpl<Vec3>& target) {
 template<class S>
 void ParticleSystem<S>::setPosPdata(ParticleDataImpl<Vec3>& target) {
 	for(IndexInt i=0; i<(IndexInt)this->size(); ++i) {
-		this->getPos(i) = target[i];
+		this->setPos(i, target[i]);
 	}
 }
 
@@ -406,35 +540,92 @@ void ParticleSystem<S>::transformPositions( Vec3i dimOld, Vec3i dimNew )
 	}
 }
 
-//// check for deletion/invalid position, otherwise return velocity
-//KERNEL(pts) returns(std::vector<Vec3> u(size)) template<class S>
-//std::vector<Vec3> GridAdvectKernel (std::vector<S>& p, const MACGrid& vel, const FlagGrid& flags, Real dt,
-//		bool deleteInObstacle, bool stopInObstacle )
-//{
-//	if (p[idx].flag & ParticleBase::PDELETE) {
-//		u[idx] = 0.; return;
-//	} 
-//	// special handling
-//	if(deleteInObstacle || stopInObstacle) {
-//		if (!flags.isInBounds(p[idx].pos, 1) || flags.isObstacle(p[idx].pos) ) {
-//			if(stopInObstacle)
-//				u[idx] = 0.; 
-//			// for simple tracer particles, its convenient to delete particles right away
-//			// for other sim types, eg flip, we can try to fix positions later on
-//			if(deleteInObstacle) 
-//				p[idx].flag |= ParticleBase::PDELETE; 
-//			return;
-//		} 
-//	}
-//	u[idx] = vel.getInterpolated(p[idx].pos) * dt;
-//};
+// check for deletion/invalid position, otherwise return velocity for the intermediate positions x
+// of particles [start,start+n); u keeps its previous value for particles that are only deleted
+template<class DATA>
+inline void gridAdvectBatchVel(DATA& p, IndexInt start, int n, const Vec3* x, Vec3* u, const MACGrid& vel, const FlagGrid& flags,
+		Real dt, bool deleteInObstacle, bool stopInObstacle)
+{
+	int ids[INTERPOL_BATCH];
+	Vec3 pos[INTERPOL_BATCH], v[INTERPOL_BATCH];
+	int m = 0;
+	for (int l=0; l<n; l++) {
+		const IndexInt i = start + l;
+		if (p[i].flag & ParticleBase::PDELETE) {
+			u[l] = 0.; continue;
+		} 
+		// special handling
+		if(deleteInObstacle || stopInObstacle) {
+			if (!flags.isInBounds(x[l], 1) || flags.isObstacle(x[l]) ) {
+				if(stopInObstacle)
+					u[l] = 0.; 
+				// for simple tracer particles, its convenient to delete particles right away
+				// for other sim types, eg flip, we can try to fix positions later on
+				if(deleteInObstacle) 
+					p[i].flag |= ParticleBase::PDELETE; 
+				continue;
+			} 
+		}
+		ids[m] = l;
+		pos[m++] = x[l];
+	}
+	vel.getInterpolatedBatch(pos, m, v);
+	for (int l=0; l<m; l++) u[ids[l]] = v[l] * dt;
+}
+
+//! advect particles in batches of INTERPOL_BATCH, running all integration stages of a batch 
+//! while it is in cache (same result as integratePointSet, without the full-array passes)
+//! note: with cell sorted particles (see gridParticleIndex reorderInterval) the MAC stencils
+//! of a batch mostly overlap, so the grid lookups of all stages hit the same cache lines
+KERNEL(pts) template<class DATA>
+void KnGridAdvectBatch(InterpolBatches& batches, DATA& p, const MACGrid& vel, const FlagGrid& flags, Real dt,
+		bool deleteInObstacle, bool stopInObstacle, int integrationMode)
+{
+	Vec3 x0[INTERPOL_BATCH], x[INTERPOL_BATCH], u[INTERPOL_BATCH], uTotal[INTERPOL_BATCH];
+	const IndexInt start = batches.start(idx);
+	const int n = batches.count(idx);
+	for (int l=0; l<n; l++) {
+		x0[l] = x[l] = getParticlePos(p, start+l);
+		u[l] = 0.;
+	}
+	gridAdvectBatchVel(p, start, n, x, u, vel, flags, dt, deleteInObstacle, stopInObstacle);
+
+	if (integrationMode == IntEuler) {
+		for (int l=0; l<n; l++) x[l] = x0[l] + u[l];
+	} 
+	else if (integrationMode == IntRK2) {
+		for (int l=0; l<n; l++) x[l] = x0[l] + 0.5*u[l];
+		gridAdvectBatchVel(p, start, n, x, u, vel, flags, dt, deleteInObstacle, stopInObstacle);
+		for (int l=0; l<n; l++) x[l] = x0[l] + u[l];
+	} 
+	else if (integrationMode == IntRK4) {
+		for (int l=0; l<n; l++) {
+			uTotal[l] = u[l];
+			x[l] = x0[l] + 0.5*u[l];
+		}
+		gridAdvectBatchVel(p, start, n, x, u, vel, flags, dt, deleteInObstacle, stopInObstacle);
+		for (int l=0; l<n; l++) {
+			x[l] = x0[l] + 0.5*u[l];
+			uTotal[l] += 2*u[l];
+		}
+		gridAdvectBatchVel(p, start, n, x, u, vel, flags, dt, deleteInObstacle, stopInObstacle);
+		for (int l=0; l<n; l++) {
+			x[l] = x0[l] + u[l];
+			uTotal[l] += 2*u[l];
+		}
+		gridAdvectBatchVel(p, start, n, x, u, vel, flags, dt, deleteInObstacle, stopInObstacle);
+		for (int l=0; l<n; l++) x[l] = x0[l] + (Real)(1./6.) * (uTotal[l] + u[l]);
+	}
+	for (int l=0; l<n; l++) setParticlePos(p, start+l, x[l]);
+}
 
 // final check after advection to make sure particles haven't escaped
 // (similar to particle advection kernel)
-KERNEL(pts) template<class S>
-void KnDeleteInObstacle(std::vector<S>& p, const FlagGrid& flags) {
+KERNEL(pts) template<class DATA>
+void KnDeleteInObstacle(DATA& p, const FlagGrid& flags) {
 	if (p[idx].flag & ParticleBase::PDELETE) return;
-	if (!flags.isInBounds(p[idx].pos,1) || flags.isObstacle(p[idx].pos)) {
+	const Vec3 pos = getParticlePos(p, idx);
+	if (!flags.isInBounds(pos,1) || flags.isObstacle(pos)) {
 		p[idx].flag |= ParticleBase::PDELETE;
 	} 
 }
@@ -453,15 +644,17 @@ static inline Vec3 bisectBacktracePos(const FlagGrid& flags, const Vec3& oldp, c
 }
 
 // at least make sure all particles are inside domain
-KERNEL(pts) template<class S>
-void KnClampPositions(std::vector<S>& p, const FlagGrid& flags, ParticleDataImpl<Vec3> *posOld = NULL, bool stopInObstacle=true)
+KERNEL(pts) template<class DATA>
+void KnClampPositions(DATA& p, const FlagGrid& flags, ParticleDataImpl<Vec3> *posOld = NULL, bool stopInObstacle=true)
 {
 	if (p[idx].flag & ParticleBase::PDELETE) return;
-	if (!flags.isInBounds(p[idx].pos,0) ) {
-		p[idx].pos = clamp( p[idx].pos, Vec3(0.), toVec3(flags.getSize())-Vec3(1.) );
+	Vec3 pos = getParticlePos(p, idx);
+	if (!flags.isInBounds(pos,0) ) {
+		pos = clamp( pos, Vec3(0.), toVec3(flags.getSize())-Vec3(1.) );
+		setParticlePos(p, idx, pos);
 	} 
-	if (stopInObstacle && (flags.isObstacle(p[idx].pos)) ) {
-		p[idx].pos = bisectBacktracePos(flags, (*posOld)[idx], p[idx].pos);
+	if (stopInObstacle && (flags.isObstacle(pos)) ) {
+		setParticlePos(p, idx, bisectBacktracePos(flags, (*posOld)[idx], pos));
 	}
 }
 
@@ -473,18 +666,20 @@ void ParticleSystem<S>::advectInGrid(FlagGrid& flags, MACGrid& vel, int integrat
 	if(!deleteInObstacle) {
 		posOld = new ParticleDataImpl<Vec3>(this->getParent());
 		posOld->resize(mData.size());
-		for(IndexInt i=0; i<(IndexInt)mData.size();++i) (*posOld)[i] = mData[i].pos;
+		for(IndexInt i=0; i<(IndexInt)mData.size();++i) (*posOld)[i] = getPos(i);
 	}
 
 	// update positions
-	GridAdvectKernel<S> kernel(mData, vel, flags, getParent()->getDt(), deleteInObstacle, stopInObstacle );
-	integratePointSet(kernel, integrationMode);
+	if(integrationMode < IntEuler || integrationMode > IntRK4)
+		errMsg("unknown integration type");
+	InterpolBatches batches(mData.size());
+	KnGridAdvectBatch<Storage>(batches, mData, vel, flags, getParent()->getDt(), deleteInObstacle, stopInObstacle, integrationMode);
 
 	if(!deleteInObstacle) {
-		KnClampPositions<S>  ( mData, flags, posOld , stopInObstacle );
+		KnClampPositions<Storage>  ( mData, flags, posOld , stopInObstacle );
 		delete posOld;
 	} else {
-		KnDeleteInObstacle<S>( mData, flags);
+		KnDeleteInObstacle<Storage>( mData, flags);
 	}
 }
 
@@ -496,7 +691,7 @@ void KnProjectParticles(ParticleSystem<S>& part, Grid<Vec3>& gradient) {
 	
 	if (part.isActive(idx)) {
 		// project along levelset gradient
-		Vec3 p = part[idx].pos;
+		Vec3 p = part.getPos(idx);
 		if (gradient.isInBounds(p)) {
 			Vec3 n = gradient.getInterpolated(p);
 			Real dist = normalize(n);
@@ -506,7 +701,7 @@ void KnProjectParticles(ParticleSystem<S>& part, Grid<Vec3>& gradient) {
 		// clamp to outer boundaries (+jitter)
 		const double jlen = 0.1;
 		Vec3 jitter = jlen * rand.getVec3();
-		part[idx].pos = clamp(p, Vec3(1,1,1)+jitter, toVec3(gradient.getSize()-1)-jitter);
+		part.setPos(idx, clamp(p, Vec3(1,1,1)+jitter, toVec3(gradient.getSize()-1)-jitter));
 	}
 }
 
@@ -523,25 +718,181 @@ void ParticleSystem<S>::resizeAll(IndexInt size) {
 		mPartData[i]->resize(size);
 }
 
+//! gather entries in new order, dst[i] = src[order[i]]
+KERNEL(pts) template<class DATA>
+void KnReorderParticles(DATA& dst, const DATA& src, const std::vector<IndexInt>& order) {
+	dst[idx] = src[order[idx]];
+}
+
 template<class S>
-void ParticleSystem<S>::compress() {
-	IndexInt nextRead = mData.size();
-	for (IndexInt i=0; i<(IndexInt)mData.size(); i++) {
-		while ((mData[i].flag & PDELETE) != 0) {
-			nextRead--;
-			mData[i] = mData[nextRead];
-			// ugly, but prevent virtual function calls here:
-			for(IndexInt pd=0; pd<(IndexInt)mPdataReal.size(); ++pd) mPdataReal[pd]->copyValue(nextRead, i);
-			for(IndexInt pd=0; pd<(IndexInt)mPdataVec3.size(); ++pd) mPdataVec3[pd]->copyValue(nextRead, i);
-			for(IndexInt pd=0; pd<(IndexInt)mPdataInt .size(); ++pd) mPdataInt [pd]->copyValue(nextRead, i);
-			mData[nextRead].flag = PINVALID;
+void ParticleSystem<S>::reorder(const std::vector<IndexInt>& order) {
+	assertMsg( (IndexInt)order.size() <= size(), "ParticleSystem::reorder: order too long");
+	Storage tmp;
+	tmp.resize(order.size());
+	KnReorderParticles<Storage>(tmp, mData, order);
+	std::swap(mData, tmp);
+	for(IndexInt i=0; i<(IndexInt)mPartData.size(); ++i)
+		mPartData[i]->reorder(order);
+	mFreeSlots.clear(); // slots moved, recollected by the next doCompress
+}
+
+//! number of remaining particles per chunk, and deleted ones before / remaining ones after newSize
+KERNEL(pts) template<class DATA>
+void KnCountRemaining(const ParticleChunks& chunks, const DATA& p, std::vector<IndexInt>& cnt, 
+		std::vector<IndexInt>& front, std::vector<IndexInt>& back, const IndexInt newSize) {
+	IndexInt c=0, f=0, b=0;
+	for (IndexInt i=chunks.start(idx); i<chunks.end(idx); i++) {
+		const bool active = (p[i].flag & ParticleBase::PDELETE) == 0;
+		if (active) c++;
+		if (i<newSize && !active) f++;
+		if (i>=newSize && active) b++;
+	}
+	cnt[idx] = c; front[idx] = f; back[idx] = b;
+}
+
+//! write the indices of the moved particles, starting at the per chunk offsets
+KERNEL(pts) template<class DATA>
+void KnCompactIndices(const ParticleChunks& chunks, const DATA& p, const std::vector<IndexInt>& frontOffset, 
+		const std::vector<IndexInt>& backOffset, std::vector<IndexInt>& src, std::vector<IndexInt>& dst, 
+		const IndexInt newSize, const bool keepOrder) {
+	IndexInt f = frontOffset[idx], b = backOffset[idx];
+	for (IndexInt i=chunks.start(idx); i<chunks.end(idx); i++) {
+		const bool active = (p[i].flag & ParticleBase::PDELETE) == 0;
+		if (keepOrder) {
+			if (active) src[b++] = i;
+		} else {
+			if (i<newSize && !active) dst[f++] = i;
+			if (i>=newSize && active) src[b++] = i;
 		}
 	}
-	if(nextRead<(IndexInt)mData.size()) debMsg("Deleted "<<((IndexInt)mData.size() - nextRead)<<" particles", 1); // debug info
+}
+
+//! move particles and all pdata fields in one pass, src and dst ranges are disjoint
+KERNEL(pts) template<class DATA>
+void KnCompressMove(const std::vector<IndexInt>& src, const std::vector<IndexInt>& dst, DATA& p, 
+		std::vector< ParticleDataImpl<Real>* >& pdReal, std::vector< ParticleDataImpl<Vec3>* >& pdVec3, 
+		std::vector< ParticleDataImpl<int>* >& pdInt) {
+	const IndexInt from = src[idx], to = dst[idx];
+	p[to] = p[from];
+	// ugly, but prevent virtual function calls here:
+	for(IndexInt pd=0; pd<(IndexInt)pdReal.size(); ++pd) pdReal[pd]->copyValue(from, to);
+	for(IndexInt pd=0; pd<(IndexInt)pdVec3.size(); ++pd) pdVec3[pd]->copyValue(from, to);
+	for(IndexInt pd=0; pd<(IndexInt)pdInt .size(); ++pd) pdInt [pd]->copyValue(from, to);
+}
+
+template<class S>
+IndexInt ParticleSystem<S>::getCompressMoves(std::vector<IndexInt>& src, std::vector<IndexInt>& dst, bool keepOrder) {
+	// first pass gives the new size, second one (unordered only) the holes before it
+	ParticleChunks chunks( mData.size() );
+	std::vector<IndexInt> cnt( chunks.size() ), front( chunks.size() ), back( chunks.size() );
+	KnCountRemaining<Storage>( chunks, mData, cnt, front, back, mData.size() );
+	IndexInt newSize = 0;
+	for (IndexInt c=0; c<chunks.size(); c++) newSize += cnt[c];
+	if (!keepOrder) KnCountRemaining<Storage>( chunks, mData, cnt, front, back, newSize );
+
+	// exclusive prefix sums give the output offsets of each chunk
+	IndexInt nf = 0, nb = 0;
+	for (IndexInt c=0; c<chunks.size(); c++) {
+		const IndexInt f = front[c], b = keepOrder ? cnt[c] : back[c];
+		front[c] = nf; back[c] = nb;
+		nf += f; nb += b;
+	}
+	src.resize(nb);
+	dst.resize(keepOrder ? 0 : nf);
+	KnCompactIndices<Storage>( chunks, mData, front, back, src, dst, newSize, keepOrder );
+	return newSize;
+}
+
+template<class S>
+void ParticleSystem<S>::compress(bool keepOrder) {
+	std::vector<IndexInt> src, dst;
+	const IndexInt newSize = getCompressMoves(src, dst, keepOrder);
+	applyCompressMoves(src, dst, newSize, keepOrder);
+}
+
+template<class S>
+void ParticleSystem<S>::applyCompressMoves(const std::vector<IndexInt>& src, const std::vector<IndexInt>& dst, IndexInt newSize, bool keepOrder) {
+	if(newSize<(IndexInt)mData.size()) debMsg("Deleted "<<((IndexInt)mData.size() - newSize)<<" particles", 1); // debug info
 
-	resizeAll(nextRead);
+	if (keepOrder) {
+		// stable compaction can't be done in place in parallel, gather instead
+		// (non-virtual: derived systems remap their own connectivity before this)
+		if(newSize<(IndexInt)mData.size()) ParticleSystem<S>::reorder(src);
+	} else {
+		KnCompressMove<Storage>( src, dst, mData, mPdataReal, mPdataVec3, mPdataInt );
+		resizeAll(newSize);
+	}
 	mDeletes = 0;
 	mDeleteChunk = mData.size() / DELETE_PART;
+	mFreeSlots.clear();
+}
+
+template<class S>
+void ParticleSystem<S>::enablePool(ParticleDataImpl<int>* ids, Real defragRatio, bool keepIds) {
+	if (ids) {
+		bool registered = false;
+		for(IndexInt pd=0; pd<(IndexInt)mPdataInt.size(); ++pd) registered |= (mPdataInt[pd] == ids);
+		if (!registered) errMsg("ParticleSystem::enablePool: id channel is not registered with this particle system");
+	}
+	mPooled = true;
+	mDefragRatio = defragRatio;
+	mPoolIds = ids;
+	mNextId = 0;
+	if (ids) {
+		for(IndexInt i=0; i<size(); ++i) {
+			if (!keepIds) (*ids)[i] = (int)i;
+			mNextId = std::max(mNextId, (IndexInt)(*ids)[i] + 1);
+		}
+	}
+	updatePool();
+}
+
+template<class S>
+void ParticleSystem<S>::updatePool() {
+	// all deleted slots in ascending order, same passes as for compress with an unchanged size
+	const IndexInt sz = mData.size();
+	ParticleChunks chunks( sz );
+	std::vector<IndexInt> cnt( chunks.size() ), front( chunks.size() ), back( chunks.size(), 0 );
+	KnCountRemaining<Storage>( chunks, mData, cnt, front, back, sz );
+	IndexInt numFree = 0;
+	for (IndexInt c=0; c<chunks.size(); c++) {
+		const IndexInt f = front[c];
+		front[c] = numFree;
+		numFree += f;
+	}
+	mDeletes = 0;
+
+	// amortized defragmentation, only once the holes make up a large part of the system
+	if (numFree > 0 && numFree >= mDefragRatio * sz) {
+		debMsg("Defragmenting particle pool, "<<numFree<<" free slots of "<<sz, 1);
+		compress(true);
+		return;
+	}
+	std::vector<IndexInt> none;
+	mFreeSlots.resize(numFree);
+	KnCompactIndices<Storage>( chunks, mData, front, back, none, mFreeSlots, sz, false );
+}
+KERNEL(pts) template<class DATA>
+void KnClearFlag(DATA& p, const int flag) {
+	p[idx].flag &= ~flag;
+}
+
+//! init new particles and their pdata fields, the first ones go to the given free slots,
+//! the remaining ones are appended starting at offset
+KERNEL(pts) template<class DATA>
+void KnInsertBuffered(const std::vector<Vec3>& buffer, const std::vector<IndexInt>& slots, DATA& p, const IndexInt offset,
+		std::vector< ParticleDataImpl<Real>* >& pdReal, std::vector< ParticleDataImpl<Vec3>* >& pdVec3, 
+		std::vector< ParticleDataImpl<int>* >& pdInt, ParticleDataImpl<int>* ids, const IndexInt firstId) {
+	const IndexInt numSlots = slots.size();
+	const IndexInt i = (idx < numSlots) ? slots[idx] : offset + idx - numSlots;
+	// note, other fields are not initialized here...
+	setParticlePos(p, i, buffer[idx]);
+	p[i].flag = ParticleBase::PNEW;
+	// now init pdata fields from associated grids...
+	for(IndexInt pd=0; pd<(IndexInt)pdReal.size(); ++pd) pdReal[pd]->initNewValue(i, buffer[idx]);
+	for(IndexInt pd=0; pd<(IndexInt)pdVec3.size(); ++pd) pdVec3[pd]->initNewValue(i, buffer[idx]);
+	for(IndexInt pd=0; pd<(IndexInt)pdInt .size(); ++pd) pdInt [pd]->initNewValue(i, buffer[idx]);
+	if (ids) (*ids)[i] = (int)(firstId + idx);
 }
 
 //! insert buffered positions as new particles, update additional particle data
@@ -549,64 +900,45 @@ template<class S>
 void ParticleSystem<S>::insertBufferedParticles() {
 	if(mNewBuffer.size()==0) return;
 	IndexInt newCnt = mData.size();
-	resizeAll(newCnt + mNewBuffer.size());
+
+	// reuse free slots first in pooled mode (lowest ones, to keep the particles dense)
+	const IndexInt numSlots = mPooled ? std::min( (IndexInt)mFreeSlots.size(), (IndexInt)mNewBuffer.size() ) : 0;
+	std::vector<IndexInt> slots( mFreeSlots.begin(), mFreeSlots.begin() + numSlots );
+	mFreeSlots.erase( mFreeSlots.begin(), mFreeSlots.begin() + numSlots );
 
 	// clear new flag everywhere
-	for(IndexInt i=0; i<(IndexInt)mData.size(); ++i) mData[i].flag &= ~PNEW;
-
-	for(IndexInt i=0; i<(IndexInt)mNewBuffer.size(); ++i) {
-		// note, other fields are not initialized here...
-		mData[newCnt].pos  = mNewBuffer[i];
-		mData[newCnt].flag = PNEW;
-		// now init pdata fields from associated grids...
-		for(IndexInt pd=0; pd<(IndexInt)mPdataReal.size(); ++pd) 
-			mPdataReal[pd]->initNewValue(newCnt, mNewBuffer[i] );
-		for(IndexInt pd=0; pd<(IndexInt)mPdataVec3.size(); ++pd) 
-			mPdataVec3[pd]->initNewValue(newCnt, mNewBuffer[i] );
-		for(IndexInt pd=0; pd<(IndexInt)mPdataInt.size(); ++pd) 
-			mPdataInt[pd]->initNewValue(newCnt, mNewBuffer[i] );
-		newCnt++;
-	}
+	KnClearFlag<Storage>( mData, ParticleBase::PNEW );
+	resizeAll(newCnt + mNewBuffer.size() - numSlots);
+	KnInsertBuffered<Storage>( mNewBuffer, slots, mData, newCnt, mPdataReal, mPdataVec3, mPdataInt, mPoolIds, mNextId );
+	if (mPoolIds) mNextId += mNewBuffer.size();
+
 	if(mNewBuffer.size()>0) debMsg("Added & initialized "<<(IndexInt)mNewBuffer.size()<<" particles", 1); // debug info
 	mNewBuffer.clear();
 }
 
-
 template<class DATA, class CON>
-void ConnectedParticleSystem<DATA,CON>::compress() {
+void ConnectedParticleSystem<DATA,CON>::compress(bool keepOrder) {
 	const IndexInt sz = ParticleSystem<DATA>::size();
-	IndexInt *renumber_back = new IndexInt[sz];
-	IndexInt *renumber = new IndexInt[sz];
-	for (IndexInt i=0; i<sz; i++)
-		renumber[i] = renumber_back[i] = -1;
-		
-	// reorder elements
-	std::vector<DATA>& data = ParticleSystem<DATA>::mData;
-	IndexInt nextRead = sz;
-	for (IndexInt i=0; i<nextRead; i++) {
-		if ((data[i].flag & ParticleBase::PDELETE) != 0) {
-			nextRead--;
-			data[i] = data[nextRead];
-			data[nextRead].flag = 0;           
-			renumber_back[i] = nextRead;
-		} else 
-			renumber_back[i] = i;
+	std::vector<IndexInt> src, dst;
+	const IndexInt newSize = this->getCompressMoves(src, dst, keepOrder);
+
+	// new index of each particle, -1 for deleted ones
+	std::vector<IndexInt> renumber( sz, -1 );
+	if (keepOrder) {
+		for (IndexInt i=0; i<newSize; i++) renumber[src[i]] = i;
+	} else {
+		for (IndexInt i=0; i<newSize; i++) renumber[i] = i;
+		for (IndexInt i=0; i<(IndexInt)dst.size(); i++) {
+			renumber[dst[i]] = -1;
+			renumber[src[i]] = dst[i];
+		}
 	}
 	
-	// acceleration structure
-	for (IndexInt i=0; i<nextRead; i++)
-		renumber[renumber_back[i]] = i;
-	
 	// rename indices in filaments
 	for (IndexInt i=0; i<(IndexInt)mSegments.size(); i++)
-		mSegments[i].renumber(renumber);
-		
-	ParticleSystem<DATA>::mData.resize(nextRead);
-	ParticleSystem<DATA>::mDeletes = 0;
-	ParticleSystem<DATA>::mDeleteChunk = ParticleSystem<DATA>::size() / DELETE_PART;
-	
-	delete[] renumber;
-	delete[] renumber_back;
+		mSegments[i].renumber(&renumber[0]);
+
+	this->applyCompressMoves(src, dst, newSize, keepOrder);
 }
 
 template<class S>
@@ -46,6 +46,56 @@ void SemiLagrangeMAC(FlagGrid& flags, MACGrid& vel, MACGrid& dst, MACGrid& src,
 	dst(i,j,k) = Vec3(vx,vy,vz);
 }
 
+//! inner rows of a grid (i.e. bnd=1), for the batched Semi-Lagrange kernels
+static void makeSemiLagrangeRows(const GridBase& grid, vector<Vec3i>& rows) {
+	const Vec3i size = grid.getSize();
+	const int kmin = grid.is3D() ? 1 : 0, kmax = grid.is3D() ? size.z-1 : 1;
+	rows.clear();
+	for (int k=kmin; k<kmax; k++)
+	for (int j=1; j<size.y-1; j++)
+		rows.push_back(Vec3i(0,j,k));
+}
+
+//! Semi-Lagrange interpolation kernel, linear interpolation in batches of INTERPOL_BATCH cells along x
+KERNEL(pts) template<class T>
+void SemiLagrangeBatch(vector<Vec3i>& rows, FlagGrid& flags, MACGrid& vel, Grid<T>& dst, Grid<T>& src, Real dt)
+{
+	const int j = rows[idx].y, k = rows[idx].z;
+	Vec3 pos[INTERPOL_BATCH];
+	T val[INTERPOL_BATCH];
+	for (int i0=1; i0<flags.getSizeX()-1; i0+=INTERPOL_BATCH) {
+		const int n = min(INTERPOL_BATCH, flags.getSizeX()-1-i0);
+		for (int l=0; l<n; l++) 
+			pos[l] = Vec3(i0+l+0.5f,j+0.5f,k+0.5f) - vel.getCentered(i0+l,j,k) * dt;
+		src.getInterpolatedBatch(pos, n, val);
+		for (int l=0; l<n; l++) 
+			dst(i0+l,j,k) = val[l];
+	}
+}
+
+//! Semi-Lagrange interpolation kernel for MAC grids, batched version of SemiLagrangeMAC for linear interpolation
+KERNEL(pts)
+void SemiLagrangeBatchMAC(vector<Vec3i>& rows, FlagGrid& flags, MACGrid& vel, MACGrid& dst, MACGrid& src, Real dt)
+{
+	const int j = rows[idx].y, k = rows[idx].z;
+	Vec3 pos[INTERPOL_BATCH];
+	Real vx[INTERPOL_BATCH], vy[INTERPOL_BATCH], vz[INTERPOL_BATCH];
+	for (int i0=1; i0<flags.getSizeX()-1; i0+=INTERPOL_BATCH) {
+		const int n = min(INTERPOL_BATCH, flags.getSizeX()-1-i0);
+		for (int l=0; l<n; l++) 
+			pos[l] = Vec3(i0+l+0.5f,j+0.5f,k+0.5f) - vel.getAtMACX(i0+l,j,k) * dt;
+		src.getInterpolatedComponentBatch<0>(pos, n, vx);
+		for (int l=0; l<n; l++) 
+			pos[l] = Vec3(i0+l+0.5f,j+0.5f,k+0.5f) - vel.getAtMACY(i0+l,j,k) * dt;
+		src.getInterpolatedComponentBatch<1>(pos, n, vy);
+		for (int l=0; l<n; l++) 
+			pos[l] = Vec3(i0+l+0.5f,j+0.5f,k+0.5f) - vel.getAtMACZ(i0+l,j,k) * dt;
+		src.getInterpolatedComponentBatch<2>(pos, n, vz);
+		for (int l=0; l<n; l++) 
+			dst(i0+l,j,k) = Vec3(vx[l],vy[l],vz[l]);
+	}
+}
+
 
 //! Kernel: Correct based on forward and backward SL steps (for both centered & mac grids)
 KERNEL(idx) template<class T> 
@@ -60,10 +110,9 @@ void MacCormackCorrect(FlagGrid& flags, Grid<T>& dst, Grid<T>& old, Grid<T>& fwd
 	}
 }
 
-//! Kernel: Correct based on forward and backward SL steps (for both centered & mac grids)
-KERNEL() template<class T> 
-void MacCormackCorrectMAC(FlagGrid& flags, Grid<T>& dst, Grid<T>& old, Grid<T>& fwd,  Grid<T>& bwd, 
-					   Real strength, bool isLevelSet, bool isMAC=false )
+//! Helper to correct a single MAC cell, components next to non-fluid cells keep the forward value
+template<class T>
+inline T macCormackCorrectMAC(FlagGrid& flags, const T& old, const T& fwd, const T& bwd, Real strength, bool isMAC, int i, int j, int k)
 {
 	bool skip[3] = { false, false, false };
 
@@ -74,14 +123,24 @@ void MacCormackCorrectMAC(FlagGrid& flags, Grid<T>& dst, Grid<T>& old, Grid<T>&
 		if( (k>0) && (!flags.isFluid(i,j,k-1) )) skip[2] = true; 
 	}
 
+	T dst;
 	for(int c=0; c<3; ++c ) {
 		if ( skip[c] ) {
-			dst(i,j,k)[c] = fwd(i,j,k)[c];
+			dst[c] = fwd[c];
 		} else { 
 			// perform actual correction with given strength
-			dst(i,j,k)[c] = fwd(i,j,k)[c] + strength * 0.5 * (old(i,j,k)[c] - bwd(i,j,k)[c]);
+			dst[c] = fwd[c] + strength * 0.5 * (old[c] - bwd[c]);
 		}
 	}
+	return dst;
+}
+
+//! Kernel: Correct based on forward and backward SL steps (for both centered & mac grids)
+KERNEL() template<class T> 
+void MacCormackCorrectMAC(FlagGrid& flags, Grid<T>& dst, Grid<T>& old, Grid<T>& fwd,  Grid<T>& bwd, 
+					   Real strength, bool isLevelSet, bool isMAC=false )
+{
+	dst(i,j,k) = macCormackCorrectMAC<T>(flags, old(i,j,k), fwd(i,j,k), bwd(i,j,k), strength, isMAC, i,j,k);
 }
 
 // Helper to collect min/max in a template
@@ -174,15 +233,13 @@ inline Real doClampComponentMAC(const Vec3i& gridSize, Real dst, MACGrid& orig,
 	return dst;
 }
 
-//! Kernel: Clamp obtained value to min/max in source area, and reset values that point out of grid or into boundaries
-//          (note - MAC grids are handled below)
-KERNEL(bnd=1) template<class T>
-void MacCormackClamp(FlagGrid& flags, MACGrid& vel, Grid<T>& dst, Grid<T>& orig, Grid<T>& fwd, Real dt)
+//! Helper to clamp a single cell to min/max in source area, and reset values that point out of grid or into boundaries
+template<class T>
+inline T macCormackClamp(FlagGrid& flags, MACGrid& vel, T dval, Grid<T>& orig, const T& fwd, Real dt, int i, int j, int k)
 {
-	T     dval       = dst(i,j,k);
 	Vec3i gridUpper  = flags.getSize() - 1;
 	
-	dval = doClampComponent<T>(gridUpper, dval, orig, fwd(i,j,k), Vec3(i,j,k), vel.getCentered(i,j,k) * dt );
+	dval = doClampComponent<T>(gridUpper, dval, orig, fwd, Vec3(i,j,k), vel.getCentered(i,j,k) * dt );
 
 	// lookup forward/backward , round to closest NB
 	Vec3i posFwd = toVec3i( Vec3(i,j,k) + Vec3(0.5,0.5,0.5) - vel.getCentered(i,j,k) * dt );
@@ -195,18 +252,23 @@ void MacCormackClamp(FlagGrid& flags, MACGrid& vel, Grid<T>& dst, Grid<T>& orig,
 		posBwd.x > gridUpper.x || posBwd.y > gridUpper.y || ((posBwd.z > gridUpper.z)&&flags.is3D()) ||
 		flags.isObstacle(posFwd) || flags.isObstacle(posBwd) ) 
 	{
-		dval = fwd(i,j,k);
+		dval = fwd;
 	}
-	dst(i,j,k) = dval;
+	return dval;
 }
 
-//! Kernel: same as MacCormackClamp above, but specialized version for MAC grids
-KERNEL(bnd=1) 
-void MacCormackClampMAC (FlagGrid& flags, MACGrid& vel, MACGrid& dst, MACGrid& orig, MACGrid& fwd, Real dt)
+//! Kernel: Clamp obtained value to min/max in source area, and reset values that point out of grid or into boundaries
+//          (note - MAC grids are handled below)
+KERNEL(bnd=1) template<class T>
+void MacCormackClamp(FlagGrid& flags, MACGrid& vel, Grid<T>& dst, Grid<T>& orig, Grid<T>& fwd, Real dt)
+{
+	dst(i,j,k) = macCormackClamp<T>(flags, vel, dst(i,j,k), orig, fwd(i,j,k), dt, i,j,k);
+}
+
+//! Helper to clamp a single MAC cell, same as macCormackClamp above
+inline Vec3 macCormackClampMAC(FlagGrid& flags, MACGrid& vel, Vec3 dval, MACGrid& orig, const Vec3& dfwd, Real dt, int i, int j, int k)
 {
 	Vec3  pos(i,j,k);
-	Vec3  dval       = dst(i,j,k);
-	Vec3  dfwd       = fwd(i,j,k);
 	Vec3i gridUpper  = flags.getSize() - 1;
 	
 	dval.x = doClampComponentMAC<0>(gridUpper, dval.x, orig, dfwd.x, pos, vel.getAtMACX(i,j,k) * dt);
@@ -216,9 +278,242 @@ void MacCormackClampMAC (FlagGrid& flags, MACGrid& vel, MACGrid& dst, MACGrid& o
 	// note - the MAC version currently does not check whether source points were inside an obstacle! (unlike centered version)
 	// this would need to be done for each face separately to stay symmetric...
 
-	dst(i,j,k) = dval;
+	return dval;
 }
 
+//! Kernel: same as MacCormackClamp above, but specialized version for MAC grids
+KERNEL(bnd=1) 
+void MacCormackClampMAC (FlagGrid& flags, MACGrid& vel, MACGrid& dst, MACGrid& orig, MACGrid& fwd, Real dt)
+{
+	dst(i,j,k) = macCormackClampMAC(flags, vel, dst(i,j,k), orig, fwd(i,j,k), dt, i,j,k);
+}
+
+
+// fused MacCormack
+
+//! tile resolution and halo width for the fused MacCormack kernels
+static const int MACCORMACK_TILE      = 16;
+static const int MACCORMACK_TILE_2D   = 32;
+static const int MACCORMACK_TILE_HALO = 2;
+
+//! Forward SL step for a single cell, same as SemiLagrange kernel (zero in outer layer)
+template<class T>
+struct SLForwardStep {
+	SLForwardStep(FlagGrid& flags, MACGrid& vel, Grid<T>& src, Real dt) : flags(flags), vel(vel), src(src), dt(dt) {}
+	inline T operator() (int i, int j, int k) const {
+		if (!flags.isInBounds(Vec3i(i,j,k),1)) return T(0.);
+		Vec3 pos = Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getCentered(i,j,k) * dt;
+		return src.getInterpolatedHi(pos, 1);
+	}
+	FlagGrid& flags; MACGrid& vel; Grid<T>& src; Real dt;
+};
+
+//! Forward SL step for a single MAC cell, same as SemiLagrangeMAC kernel (zero in outer layer)
+struct SLForwardStepMAC {
+	SLForwardStepMAC(FlagGrid& flags, MACGrid& vel, MACGrid& src, Real dt) : flags(flags), vel(vel), src(src), dt(dt) {}
+	inline Vec3 operator() (int i, int j, int k) const {
+		if (!flags.isInBounds(Vec3i(i,j,k),1)) return Vec3(0.);
+		Vec3 xpos = Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getAtMACX(i,j,k) * dt;
+		Vec3 ypos = Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getAtMACY(i,j,k) * dt;
+		Vec3 zpos = Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getAtMACZ(i,j,k) * dt;
+		return Vec3(src.getInterpolatedComponent<0>(xpos), src.getInterpolatedComponent<1>(ypos), src.getInterpolatedComponent<2>(zpos));
+	}
+	FlagGrid& flags; MACGrid& vel; MACGrid& src; Real dt;
+};
+
+//! Forward values of one tile incl. halo, lookups outside of the tile are evaluated on the fly
+template<class T, class FWD>
+struct MacCormackTile {
+	MacCormackTile(const FWD& fwd, const Vec3i& lo, const Vec3i& hi) : fwd(fwd), lo(lo), hi(hi), size(hi-lo), data((IndexInt)size.x*size.y*size.z) {
+		IndexInt n = 0;
+		for (int k=lo.z; k<hi.z; k++) 
+		for (int j=lo.y; j<hi.y; j++) 
+		for (int i=lo.x; i<hi.x; i++) 
+			data[n++] = fwd(i,j,k);
+	}
+	inline T operator() (int i, int j, int k) const {
+		if (i<lo.x || j<lo.y || k<lo.z || i>=hi.x || j>=hi.y || k>=hi.z) return fwd(i,j,k);
+		return data[(i-lo.x) + (IndexInt)size.x * ((j-lo.y) + (IndexInt)size.y * (k-lo.z))];
+	}
+	const FWD& fwd;
+	Vec3i lo, hi, size;
+	vector<T> data;
+};
+
+//! split domain into tiles for the fused MacCormack kernels
+static void makeMacCormackTiles(const GridBase& grid, vector<Vec3i>& tiles, Vec3i& tileSize) {
+	const Vec3i size = grid.getSize();
+	tileSize = grid.is3D() ? Vec3i(MACCORMACK_TILE) : Vec3i(MACCORMACK_TILE_2D, MACCORMACK_TILE_2D, 1);
+	tiles.clear();
+	for (int k=0; k<size.z; k+=tileSize.z)
+	for (int j=0; j<size.y; j+=tileSize.y)
+	for (int i=0; i<size.x; i+=tileSize.x)
+		tiles.push_back(Vec3i(i,j,k));
+}
+
+//! tile extent [tlo,thi), and extent incl. halo [lo,hi) clamped to the grid
+static inline void getMacCormackTileBox(const GridBase& grid, const Vec3i& tileStart, const Vec3i& tileSize, Vec3i& tlo, Vec3i& thi, Vec3i& lo, Vec3i& hi) {
+	const Vec3i size = grid.getSize();
+	const Vec3i halo = grid.is3D() ? Vec3i(MACCORMACK_TILE_HALO) : Vec3i(MACCORMACK_TILE_HALO, MACCORMACK_TILE_HALO, 0);
+	for (int c=0; c<3; c++) {
+		tlo[c] = tileStart[c];
+		thi[c] = min(tileStart[c] + tileSize[c], size[c]);
+		lo[c]  = max(tlo[c] - halo[c], 0);
+		hi[c]  = min(thi[c] + halo[c], size[c]);
+	}
+}
+
+//! Traceback weights of one tile, shared by all grids advected with the same velocity
+struct MacCormackWeights {
+	MacCormackWeights(FlagGrid& flags, MACGrid& vel, Real dt, const Vec3i& tileStart, const Vec3i& tileSize) {
+		const Vec3i size = flags.getSize();
+		getMacCormackTileBox(flags, tileStart, tileSize, tlo, thi, lo, hi);
+		boxSize = hi - lo;
+
+		// forward step for tile and halo
+		fwd.resize((IndexInt)boxSize.x * boxSize.y * boxSize.z);
+		fwdInner.resize(fwd.size());
+		IndexInt n = 0;
+		for (int k=lo.z; k<hi.z; k++) 
+		for (int j=lo.y; j<hi.y; j++) 
+		for (int i=lo.x; i<hi.x; i++, n++) {
+			fwdInner[n] = flags.isInBounds(Vec3i(i,j,k),1);
+			if (fwdInner[n]) fwd[n] = getInterpolWeights(size, Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getCentered(i,j,k) * dt);
+		}
+
+		// backward step for the tile only
+		const Real bdt = -dt;
+		const Vec3i tileRes = thi - tlo;
+		bwd.resize((IndexInt)tileRes.x * tileRes.y * tileRes.z);
+		bwdInner.resize(bwd.size());
+		n = 0;
+		for (int k=tlo.z; k<thi.z; k++) 
+		for (int j=tlo.y; j<thi.y; j++) 
+		for (int i=tlo.x; i<thi.x; i++, n++) {
+			bwdInner[n] = flags.isInBounds(Vec3i(i,j,k),1);
+			if (bwdInner[n]) bwd[n] = getInterpolWeights(size, Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getCentered(i,j,k) * bdt);
+		}
+	}
+	inline bool inBox(int i, int j, int k) const {
+		return i>=lo.x && j>=lo.y && k>=lo.z && i<hi.x && j<hi.y && k<hi.z;
+	}
+	inline IndexInt boxIndex(int i, int j, int k) const {
+		return (i-lo.x) + (IndexInt)boxSize.x * ((j-lo.y) + (IndexInt)boxSize.y * (k-lo.z));
+	}
+
+	Vec3i tlo, thi, lo, hi, boxSize;
+	vector<InterpolWeights> fwd, bwd;
+	vector<char> fwdInner, bwdInner;
+};
+
+//! Forward SL step using the cached tile weights, falls back to SLForwardStep outside of the tile box
+template<class T>
+struct SLForwardStepCached {
+	SLForwardStepCached(const SLForwardStep<T>& step, const MacCormackWeights& w) : step(step), w(w) {}
+	inline T operator() (int i, int j, int k) const {
+		if (!w.inBox(i,j,k)) return step(i,j,k);
+		const IndexInt n = w.boxIndex(i,j,k);
+		if (!w.fwdInner[n]) return T(0.);
+		return interpolWeighted<T>(step.src.getData(), step.src.getSize(), w.fwd[n]);
+	}
+	const SLForwardStep<T>& step;
+	const MacCormackWeights& w;
+};
+
+//! fused MacCormack step of a single grid within one tile
+template<class T>
+void macCormackFusedTile(FlagGrid& flags, MACGrid& vel, Grid<T>& dst, Grid<T>& orig, const MacCormackWeights& w, Real dt, Real strength)
+{
+	SLForwardStep<T> step(flags, vel, orig, dt);
+	SLForwardStepCached<T> cached(step, w);
+	MacCormackTile<T, SLForwardStepCached<T> > fwd(cached, w.lo, w.hi);
+
+	IndexInt n = 0;
+	for (int k=w.tlo.z; k<w.thi.z; k++) 
+	for (int j=w.tlo.y; j<w.thi.y; j++) 
+	for (int i=w.tlo.x; i<w.thi.x; i++, n++) {
+		const bool inner = w.bwdInner[n];
+		const T f = fwd(i,j,k);
+
+		// backwards step
+		T b = T(0.);
+		if (inner) b = interpolWeightedLookup<T>(fwd, w.bwd[n]);
+
+		// correction, and clamping
+		T d = f;
+		if (flags.isFluid(i,j,k)) d += strength * 0.5 * (orig(i,j,k) - b);
+		if (inner) d = macCormackClamp<T>(flags, vel, d, orig, f, dt, i,j,k);
+		dst(i,j,k) = d;
+	}
+}
+
+//! Kernel: fused MacCormack step (forward, backward, correction and clamping)
+//! forward values are only kept for the current tile and its halo, instead of in full grids
+KERNEL(pts) template<class T>
+void MacCormackFused(vector<Vec3i>& tiles, FlagGrid& flags, MACGrid& vel, Grid<T>& dst, Grid<T>& orig, Real dt, Real strength, Vec3i tileSize)
+{
+	MacCormackWeights w(flags, vel, dt, tiles[idx], tileSize);
+	macCormackFusedTile<T>(flags, vel, dst, orig, w, dt, strength);
+}
+
+//! Kernel: fused MacCormack step for several grids, traceback weights are computed once per cell
+KERNEL(pts)
+void MacCormackFusedMulti(vector<Vec3i>& tiles, FlagGrid& flags, MACGrid& vel, vector<Grid<Real>*>& dstReal, vector<Grid<Real>*>& origReal, 
+	vector<Grid<Vec3>*>& dstVec3, vector<Grid<Vec3>*>& origVec3, Real dt, Real strength, Vec3i tileSize)
+{
+	MacCormackWeights w(flags, vel, dt, tiles[idx], tileSize);
+	for (size_t n=0; n<origReal.size(); n++)
+		macCormackFusedTile<Real>(flags, vel, *dstReal[n], *origReal[n], w, dt, strength);
+	for (size_t n=0; n<origVec3.size(); n++)
+		macCormackFusedTile<Vec3>(flags, vel, *dstVec3[n], *origVec3[n], w, dt, strength);
+}
+
+//! Kernel: Semi-Lagrange interpolation for several grids, traceback and weights are computed once per cell
+KERNEL(bnd=1)
+void SemiLagrangeMulti(FlagGrid& flags, MACGrid& vel, vector<Grid<Real>*>& dstReal, vector<Grid<Real>*>& srcReal, 
+	vector<Grid<Vec3>*>& dstVec3, vector<Grid<Vec3>*>& srcVec3, Real dt)
+{
+	const Vec3 pos = Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getCentered(i,j,k) * dt;
+	const InterpolWeights w = getInterpolWeights(flags.getSize(), pos);
+	const IndexInt idx = flags.index(i,j,k);
+	for (size_t n=0; n<srcReal.size(); n++)
+		(*dstReal[n])[idx] = interpolWeighted<Real>(srcReal[n]->getData(), flags.getSize(), w);
+	for (size_t n=0; n<srcVec3.size(); n++)
+		(*dstVec3[n])[idx] = interpolWeighted<Vec3>(srcVec3[n]->getData(), flags.getSize(), w);
+}
+
+//! Kernel: same as MacCormackFused above, but specialized version for MAC grids
+KERNEL(pts)
+void MacCormackFusedMAC(vector<Vec3i>& tiles, FlagGrid& flags, MACGrid& vel, MACGrid& dst, MACGrid& orig, Real dt, Real strength, Vec3i tileSize)
+{
+	const Vec3i size = flags.getSize();
+	Vec3i tlo, thi, lo, hi;
+	getMacCormackTileBox(flags, tiles[idx], tileSize, tlo, thi, lo, hi);
+
+	const Real bdt = -dt;
+	SLForwardStepMAC fwdStep(flags, vel, orig, dt);
+	MacCormackTile<Vec3, SLForwardStepMAC> fwd(fwdStep, lo, hi);
+
+	for (int k=tlo.z; k<thi.z; k++) 
+	for (int j=tlo.y; j<thi.y; j++) 
+	for (int i=tlo.x; i<thi.x; i++) {
+		const bool inner = flags.isInBounds(Vec3i(i,j,k),1);
+		const Vec3 f = fwd(i,j,k);
+
+		// backwards step
+		Vec3 b(0.);
+		if (inner) {
+			b.x = interpolComponentWeightedLookup<0>(fwd, getInterpolWeights(size, Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getAtMACX(i,j,k) * bdt));
+			b.y = interpolComponentWeightedLookup<1>(fwd, getInterpolWeights(size, Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getAtMACY(i,j,k) * bdt));
+			b.z = interpolComponentWeightedLookup<2>(fwd, getInterpolWeights(size, Vec3(i+0.5f,j+0.5f,k+0.5f) - vel.getAtMACZ(i,j,k) * bdt));
+		}
+
+		// correction, and clamping
+		Vec3 d = macCormackCorrectMAC<Vec3>(flags, orig(i,j,k), f, b, strength, true, i,j,k);
+		if (inner) d = macCormackClampMAC(flags, vel, d, orig, f, dt, i,j,k);
+		dst(i,j,k) = d;
+	}
+}
 
 //! template function for performing SL advection
 //! (Note boundary width only needed for specialization for MAC grids below)
@@ -229,9 +524,25 @@ void fnAdvectSemiLagrange(FluidSolver* parent, FlagGrid& flags, MACGrid& vel, Gr
 	Real dt = parent->getDt();
 	bool levelset = orig.getType() & GridBase::TypeLevelset;
 	
+	if (order == 2 && orderSpace == 1) { // MacCormack, fused into a single pass
+		GridType newGrid(parent);
+		vector<Vec3i> tiles;
+		Vec3i tileSize;
+		makeMacCormackTiles(flags, tiles, tileSize);
+		MacCormackFused<T> (tiles, flags, vel, newGrid, orig, dt, strength, tileSize);
+		orig.swap(newGrid);
+		return;
+	}
+
 	// forward step
 	GridType fwd(parent);
-	SemiLagrange<T> (flags, vel, fwd, orig, dt, levelset, orderSpace);
+	if (orderSpace == 1) {
+		vector<Vec3i> rows;
+		makeSemiLagrangeRows(flags, rows);
+		SemiLagrangeBatch<T> (rows, flags, vel, fwd, orig, dt);
+	} else {
+		SemiLagrange<T> (flags, vel, fwd, orig, dt, levelset, orderSpace);
+	}
 	
 	if (order == 1) {
 		orig.swap(fwd);
@@ -337,11 +648,29 @@ template<>
 void fnAdvectSemiLagrange<MACGrid>(FluidSolver* parent, FlagGrid& flags, MACGrid& vel, MACGrid& orig, int order, Real strength, int orderSpace, bool openBounds, int bWidth) {
 	Real dt = parent->getDt();
 	
+	if (orderSpace != 1) { debMsg("Warning higher order for MAC grids not yet implemented...",1); }
+
+	if (order == 2 && orderSpace == 1) { // MacCormack, fused into a single pass
+		MACGrid newGrid(parent);
+		vector<Vec3i> tiles;
+		Vec3i tileSize;
+		makeMacCormackTiles(flags, tiles, tileSize);
+		MacCormackFusedMAC (tiles, flags, vel, newGrid, orig, dt, strength, tileSize);
+		
+		if (openBounds) applyOutflowBC(flags, newGrid, orig, dt, bWidth);
+		orig.swap(newGrid);
+		return;
+	}
+
 	// forward step
 	MACGrid fwd(parent);    
-	SemiLagrangeMAC (flags, vel, fwd, orig, dt, orderSpace);
-	
-	if (orderSpace != 1) { debMsg("Warning higher order for MAC grids not yet implemented...",1); }
+	if (orderSpace == 1) {
+		vector<Vec3i> rows;
+		makeSemiLagrangeRows(flags, rows);
+		SemiLagrangeBatchMAC (rows, flags, vel, fwd, orig, dt);
+	} else {
+		SemiLagrangeMAC (flags, vel, fwd, orig, dt, orderSpace);
+	}
 
 	if (order == 1) {
 		if (openBounds) applyOutflowBC(flags, fwd, orig, dt, bWidth);
@@ -387,5 +716,66 @@ PYTHON() void advectSemiLagrange (FlagGrid* flags, MACGrid* vel, GridBase* grid,
 		errMsg("AdvectSemiLagrange: Grid Type is not supported (only Real, Vec3, MAC, Levelset)");    
 }
 
+//! Advect several grids with the same velocity field, the traceback is only computed once per cell
+//! MAC grids and higher order interpolation in space are advected one by one after the batched grids,
+//! vel itself last, so every grid sees the same velocity as with separate advectSemiLagrange calls
+void advectSemiLagrangeList(FlagGrid* flags, MACGrid* vel, const vector<GridBase*>& grids, int order, Real strength, int orderSpace)
+{
+	assertMsg(order==1 || order==2, "AdvectSemiLagrange: Only order 1 (regular SL) and 2 (MacCormack) supported");
+	FluidSolver* parent = flags->getParent();
+
+	vector<Grid<Real>*> origReal, dstReal;
+	vector<Grid<Vec3>*> origVec3, dstVec3;
+	vector<GridBase*> separate;
+	bool advectVel = false;
+	for (size_t n=0; n<grids.size(); n++) {
+		GridBase* grid = grids[n];
+		if (!grid) continue;
+		if (grid == vel) 
+			advectVel = true;
+		else if (orderSpace != 1 || (grid->getType() & GridBase::TypeMAC)) 
+			separate.push_back(grid);
+		else if (grid->getType() & GridBase::TypeReal) 
+			origReal.push_back((Grid<Real>*) grid);
+		else if (grid->getType() & GridBase::TypeVec3) 
+			origVec3.push_back((Grid<Vec3>*) grid);
+		else
+			errMsg("AdvectSemiLagrange: Grid Type is not supported (only Real, Vec3, MAC, Levelset)");
+	}
+
+	if (!origReal.empty() || !origVec3.empty()) {
+		for (size_t n=0; n<origReal.size(); n++) dstReal.push_back(new Grid<Real>(parent));
+		for (size_t n=0; n<origVec3.size(); n++) dstVec3.push_back(new Grid<Vec3>(parent));
+
+		const Real dt = parent->getDt();
+		if (order == 1) {
+			SemiLagrangeMulti(*flags, *vel, dstReal, origReal, dstVec3, origVec3, dt);
+		} else {
+			vector<Vec3i> tiles;
+			Vec3i tileSize;
+			makeMacCormackTiles(*flags, tiles, tileSize);
+			MacCormackFusedMulti(tiles, *flags, *vel, dstReal, origReal, dstVec3, origVec3, dt, strength, tileSize);
+		}
+
+		for (size_t n=0; n<origReal.size(); n++) { origReal[n]->swap(*dstReal[n]); delete dstReal[n]; }
+		for (size_t n=0; n<origVec3.size(); n++) { origVec3[n]->swap(*dstVec3[n]); delete dstVec3[n]; }
+	}
+
+	for (size_t n=0; n<separate.size(); n++) 
+		advectSemiLagrange(flags, vel, separate[n], order, strength, orderSpace);
+	if (advectVel) 
+		advectSemiLagrange(flags, vel, vel, order, strength, orderSpace);
+}
+
+//! Perform semi-lagrangian advection of up to six Real- or Vec3 grids with a shared traceback
+PYTHON() void advectSemiLagrangeMulti (FlagGrid* flags, MACGrid* vel, GridBase* grid0, GridBase* grid1 = 0, GridBase* grid2 = 0, 
+						   GridBase* grid3 = 0, GridBase* grid4 = 0, GridBase* grid5 = 0, int order = 1, Real strength = 1.0, int orderSpace = 1)
+{
+	vector<GridBase*> grids;
+	grids.push_back(grid0); grids.push_back(grid1); grids.push_back(grid2);
+	grids.push_back(grid3); grids.push_back(grid4); grids.push_back(grid5);
+	advectSemiLagrangeList(flags, vel, grids, order, strength, orderSpace);
+}
+
 } // end namespace DDF 
 
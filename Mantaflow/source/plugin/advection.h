@@ -23,5 +23,8 @@ namespace Manta
 {
 
 void advectSemiLagrange(FlagGrid* flags, MACGrid* vel, GridBase* grid, int order = 1, Real strength = 1.0, int orderSpace = 1, bool openBounds = false, int boundaryWidth = 1);
+void advectSemiLagrangeList(FlagGrid* flags, MACGrid* vel, const std::vector<GridBase*>& grids, int order = 1, Real strength = 1.0, int orderSpace = 1);
+void advectSemiLagrangeMulti(FlagGrid* flags, MACGrid* vel, GridBase* grid0, GridBase* grid1 = 0, GridBase* grid2 = 0, 
+	GridBase* grid3 = 0, GridBase* grid4 = 0, GridBase* grid5 = 0, int order = 1, Real strength = 1.0, int orderSpace = 1);
 
 } // namespace
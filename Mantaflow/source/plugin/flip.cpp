@@ -141,61 +141,166 @@ inline Real calculateRadiusFactor(Grid<Real>& grid, Real factor) {
 	return (grid.is3D() ? sqrt(3.) : sqrt(2.) ) * (factor+.01); // note, a 1% safety factor is added here
 } 
 
-//! re-sample particles based on an input levelset 
-// optionally skip seeding new particles in "exclude" SDF
-PYTHON() void adjustNumber( BasicParticleSystem& parts, MACGrid& vel, FlagGrid& flags, 
-		int minParticles, int maxParticles, LevelsetGrid& phi, Real radiusFactor=1. , Real narrowBand=-1. ,
-		Grid<Real>* exclude=NULL ) 
+//! count particles per chunk and z-slab (y-rows in 2D), and store the cell index of each particle
+KERNEL(pts)
+void knSlabCount(const ParticleChunks& chunks, BasicParticleSystem& parts, const GridBase& grid, 
+		std::vector<IndexInt>& cellOf, std::vector<IndexInt>& hist, const IndexInt planeSize, const int numSlabs) 
 {
-	// which levelset to use as threshold
-	const Real SURFACE_LS = -1.0 * calculateRadiusFactor(phi, radiusFactor);
-	Grid<int> tmp( vel.getParent() );
-	std::ostringstream out;
+	IndexInt* h = &hist[idx*numSlabs];
+	for (IndexInt i=chunks.start(idx); i<chunks.end(idx); i++) {
+		cellOf[i] = -1;
+		if (!parts.isActive(i)) continue;
+		Vec3i p = toVec3i( parts.getPos(i) );
+		if (! grid.isInBounds(p)) continue;
+		cellOf[i] = grid.index(p);
+		h[ cellOf[i] / planeSize ]++;
+	}
+}
 
-	// count particles in cells, and delete excess particles
-	for (IndexInt idx=0; idx<(int)parts.size(); idx++) {
-		if (parts.isActive(idx)) {
-			Vec3i p = toVec3i( parts.getPos(idx) );
-			if (!tmp.isInBounds(p) ) {
-				parts.kill(idx); // out of domain, remove
-				continue;
-			}
+//! scatter particle ids into their slabs, keeps the particle order within each slab
+KERNEL(pts)
+void knSlabScatter(const ParticleChunks& chunks, const std::vector<IndexInt>& cellOf, const std::vector<IndexInt>& hist, 
+		std::vector<IndexInt>& order, const IndexInt planeSize, const int numSlabs) 
+{
+	std::vector<IndexInt> offset( hist.begin()+idx*numSlabs, hist.begin()+(idx+1)*numSlabs );
+	for (IndexInt i=chunks.start(idx); i<chunks.end(idx); i++) {
+		if (cellOf[i] < 0) continue;
+		order[ offset[cellOf[i] / planeSize]++ ] = i;
+	}
+}
 
-			Real phiv = phi.getInterpolated( parts.getPos(idx) );
-			if( phiv > 0 ) { parts.kill(idx); continue; }
-			if( narrowBand>0. && phiv < -narrowBand) { parts.kill(idx); continue; }
-
-			bool atSurface = false;
-			if (phiv > SURFACE_LS) atSurface = true;
-			int num = tmp(p);
-			
-			// dont delete particles in non fluid cells here, the particles are "always right"
-			if ( num > maxParticles && (!atSurface) ) {
-				parts.kill(idx);
-			} else {
-				tmp(p) = num+1;
+//! active particles sorted into the z-slabs (y-rows in 2D) of a grid
+/*! each slab can then be processed by one thread without write conflicts on the grid cells,
+    within a slab the particles are in the same order as in the particle system */
+struct ParticleSlabs {
+	ParticleSlabs(BasicParticleSystem& parts, const GridBase& grid) {
+		numSlabs  = grid.is3D() ? grid.getSizeZ() : grid.getSizeY();
+		planeSize = grid.getSizeX() * (grid.is3D() ? grid.getSizeY() : 1);
+		ParticleChunks chunks( parts.size() );
+		cellOf.resize( parts.size() );
+		std::vector<IndexInt> hist( chunks.size() * numSlabs, 0 );
+		knSlabCount( chunks, parts, grid, cellOf, hist, planeSize, numSlabs );
+
+		// turn counts into offsets per chunk and slab, slab-major so each slab is contiguous
+		start.resize( numSlabs+1 );
+		IndexInt num = 0;
+		for (int s=0; s<numSlabs; s++) {
+			start[s] = num;
+			for (IndexInt c=0; c<chunks.size(); c++) {
+				const IndexInt cnt = hist[c*numSlabs + s];
+				hist[c*numSlabs + s] = num;
+				num += cnt;
 			}
 		}
+		start[numSlabs] = num;
+
+		order.resize( num );
+		knSlabScatter( chunks, cellOf, hist, order, planeSize, numSlabs );
 	}
 
-	// seed new particles
-	RandomStream mRand(9832);
-	FOR_IJK(tmp) {
-		int cnt = tmp(i,j,k);
+	//! range for KERNEL(pts), one slab per entry
+	IndexInt size() const { return numSlabs; }
+	//! number of particles in bounds
+	IndexInt numSorted() const { return start[numSlabs]; }
+
+	int numSlabs;
+	IndexInt planeSize;
+	//! cell of each particle, -1 for deleted or out of bounds particles
+	std::vector<IndexInt> cellOf;
+	//! particle indices sorted by slab, slab s is order[start[s]] to order[start[s+1]-1]
+	std::vector<IndexInt> order, start;
+};
+
+//! kill excess particles of the cells in one slab, in the same order as a serial loop over all particles
+KERNEL(pts)
+void knAdjustKillSlab(const ParticleSlabs& slabs, BasicParticleSystem& parts, Grid<int>& tmp, 
+		const LevelsetGrid& phi, const Real surfaceLs, const Real narrowBand, const int maxParticles, std::vector<IndexInt>& killed) 
+{
+	IndexInt numKilled = 0;
+	for (IndexInt n=slabs.start[idx]; n<slabs.start[idx+1]; n++) {
+		const IndexInt pi = slabs.order[n];
+		Real phiv = phi.getInterpolated( parts.getPos(pi) );
+		if( phiv > 0 || (narrowBand>0. && phiv < -narrowBand) ) { parts.killUncounted(pi); numKilled++; continue; }
+
+		bool atSurface = false;
+		if (phiv > surfaceLs) atSurface = true;
+		const IndexInt c = slabs.cellOf[pi];
+		int num = tmp[c];
 		
+		// dont delete particles in non fluid cells here, the particles are "always right"
+		if ( num > maxParticles && (!atSurface) ) {
+			parts.killUncounted(pi); numKilled++;
+		} else {
+			tmp[c] = num+1;
+		}
+	}
+	killed[idx] = numKilled;
+}
+
+//! kill particles that are out of the domain
+KERNEL(pts)
+void knAdjustKillOutside(const ParticleChunks& chunks, BasicParticleSystem& parts, const ParticleSlabs& slabs, std::vector<IndexInt>& killed) 
+{
+	IndexInt numKilled = 0;
+	for (IndexInt i=chunks.start(idx); i<chunks.end(idx); i++) {
+		if (slabs.cellOf[i] < 0 && parts.isActive(i)) { parts.killUncounted(i); numKilled++; }
+	}
+	killed[idx] = numKilled;
+}
+
+//! seed new particles in the cells of one slab, each cell has its own random stream per solver step
+KERNEL(pts)
+void knAdjustSeedSlab(const ParticleSlabs& slabs, const Grid<int>& tmp, const FlagGrid& flags, 
+		const LevelsetGrid& phi, const Grid<Real>* exclude, const Real surfaceLs, const Real narrowBand, const int minParticles, 
+		const int step, std::vector< std::vector<Vec3> >& buffers) 
+{
+	const IndexInt sx = flags.getSizeX(), sy = flags.getSizeY();
+	for (IndexInt c=idx*slabs.planeSize; c<(idx+1)*slabs.planeSize; c++) {
+		int cnt = tmp[c];
+
 		// skip cells near surface
-		if (phi(i,j,k) > SURFACE_LS) continue;
-		if( narrowBand>0. && phi(i,j,k) < -narrowBand ) { continue; }
-		if( exclude && ( (*exclude)(i,j,k) < 0.) ) { continue; }
+		if (phi[c] > surfaceLs) continue;
+		if( narrowBand>0. && phi[c] < -narrowBand ) { continue; }
+		if( exclude && ( (*exclude)[c] < 0.) ) { continue; }
 
-		if (flags.isFluid(i,j,k) && cnt < minParticles) {
+		if (flags.isFluid(c) && cnt < minParticles) {
+			const Vec3 cell( c % sx, (c / sx) % sy, flags.is3D() ? c / (sx*sy) : 0 );
+			CounterRandomStream rnd(9832, c, step);
 			for (int m=cnt; m < minParticles; m++) { 
-				Vec3 pos = Vec3(i,j,k) + mRand.getVec3();
-				//Vec3 pos (i + 0.5, j + 0.5, k + 0.5); // cell center
-				parts.addBuffered( pos ); 
+				buffers[idx].push_back( cell + rnd.getVec3() );
 			}
 		}
 	}
+}
+
+//! re-sample particles based on an input levelset 
+// optionally skip seeding new particles in "exclude" SDF
+PYTHON() void adjustNumber( BasicParticleSystem& parts, MACGrid& vel, FlagGrid& flags, 
+		int minParticles, int maxParticles, LevelsetGrid& phi, Real radiusFactor=1. , Real narrowBand=-1. ,
+		Grid<Real>* exclude=NULL ) 
+{
+	// which levelset to use as threshold
+	const Real SURFACE_LS = -1.0 * calculateRadiusFactor(phi, radiusFactor);
+	Grid<int> tmp( vel.getParent() );
+	std::ostringstream out;
+
+	// count particles in cells, and delete excess particles
+	ParticleSlabs slabs( parts, tmp );
+	std::vector<IndexInt> killed( slabs.numSlabs );
+	knAdjustKillSlab( slabs, parts, tmp, phi, SURFACE_LS, narrowBand, maxParticles, killed );
+	ParticleChunks chunks( parts.size() );
+	std::vector<IndexInt> killedOutside( chunks.size() );
+	knAdjustKillOutside( chunks, parts, slabs, killedOutside );
+	IndexInt numKilled = 0;
+	for (size_t i=0; i<killed.size(); i++) numKilled += killed[i];
+	for (size_t i=0; i<killedOutside.size(); i++) numKilled += killedOutside[i];
+	parts.addDeleteCount( numKilled );
+
+	// seed new particles, collected per slab so that their order doesn't depend on the threads
+	std::vector< std::vector<Vec3> > buffers( slabs.numSlabs );
+	knAdjustSeedSlab( slabs, tmp, flags, phi, exclude, SURFACE_LS, narrowBand, minParticles, 
+		flags.getParent()->getStepCount(), buffers );
+	parts.addBuffered( buffers );
 
 	parts.doCompress();
 	parts.insertBufferedParticles();
@@ -208,60 +313,68 @@ PYTHON() void debugIntToReal( Grid<int>& source, Grid<Real>& dest, Real factor=1
 	FOR_IJK( source ) { dest(i,j,k) = (Real)source(i,j,k) * factor; }
 }
 
+//! counting sort of the particles of one slab into the cells of that slab
+KERNEL(pts)
+void knPindexSortSlab(const ParticleSlabs& slabs, Grid<int>& index, Grid<int>& counter, ParticleIndexSystem& indexSys) 
+{
+	const IndexInt c0 = idx * slabs.planeSize, c1 = c0 + slabs.planeSize;
+	for (IndexInt c=c0; c<c1; c++) counter[c] = 0;
+	for (IndexInt n=slabs.start[idx]; n<slabs.start[idx+1]; n++) counter[ slabs.cellOf[slabs.order[n]] ]++;
+
+	// convert per cell number to continuous index
+	IndexInt off = slabs.start[idx];
+	for (IndexInt c=c0; c<c1; c++) {
+		index[c] = off;
+		off += counter[c];
+		counter[c] = 0;
+	}
+
+	// add particles to indexed array, counter ends up with the number of particles per cell
+	for (IndexInt n=slabs.start[idx]; n<slabs.start[idx+1]; n++) {
+		const IndexInt pi = slabs.order[n];
+		const IndexInt c = slabs.cellOf[pi];
+		indexSys[ index[c] + counter[c] ].sourceIndex = pi;
+		counter[c]++;
+	}
+}
+
 // build a grid that contains indices for a particle system
 // the particles in a cell i,j,k are particles[index(i,j,k)] to particles[index(i+1,j,k)-1]
 // (ie,  particles[index(i+1,j,k)] alreadu belongs to cell i+1,j,k)
+// if reorderInterval>0, the particles are sorted by cell every reorderInterval solver steps, 
+// so that particles of neighboring cells are close in memory
 PYTHON() void gridParticleIndex( BasicParticleSystem& parts, ParticleIndexSystem& indexSys, 
-		FlagGrid& flags, Grid<int>& index, Grid<int>* counter=NULL) 
+		FlagGrid& flags, Grid<int>& index, Grid<int>* counter=NULL, int reorderInterval=0) 
 {
 	bool delCounter = false;
 	if(!counter) { counter = new Grid<int>(  flags.getParent() ); delCounter=true; }
-	else         { counter->clear(); }
-	
-	// count particles in cells, and delete excess particles
-	index.clear();
-	int inactive = 0;
-	for (IndexInt idx=0; idx<(IndexInt)parts.size(); idx++) {
-		if (parts.isActive(idx)) {
-			// check index for validity...
-			Vec3i p = toVec3i( parts.getPos(idx) );
-			if (! index.isInBounds(p)) { inactive++; continue; }
-
-			index(p)++;
-		} else {
-			inactive++;
-		}
-	}
 
-	// note - this one might be smaller...
-	indexSys.resize( parts.size()-inactive );
+	// the grid is split into z-slabs (y-rows in 2D), each slab is sorted by one thread
+	ParticleSlabs slabs( parts, index );
+	const IndexInt num = slabs.numSorted();
 
-	// convert per cell number to continuous index
-	IndexInt idx=0;
-	FOR_IJK( index ) {
-		int num = index(i,j,k);
-		index(i,j,k) = idx;
-		idx += num;
-	}
-
-	// add particles to indexed array, we still need a per cell particle counter
-	for (IndexInt idx=0; idx<(IndexInt)parts.size(); idx++) {
-		if (!parts.isActive(idx)) continue;
-		Vec3i p = toVec3i( parts.getPos(idx) );
-		if (! index.isInBounds(p)) { continue; }
-
-		// initialize position and index into original array
-		//indexSys[ index(p)+(*counter)(p) ].pos        = parts[idx].pos;
-		indexSys[ index(p)+(*counter)(p) ].sourceIndex = idx;
-		(*counter)(p)++;
+	// note - this one might be smaller...
+	indexSys.resize( num );
+	knPindexSortSlab( slabs, index, *counter, indexSys );
+
+	const int step = flags.getParent()->getStepCount();
+	if (reorderInterval > 0 && step > 0 && step % reorderInterval == 0) {
+		// sorted particles first, followed by inactive and out of bounds ones
+		std::vector<IndexInt> order( parts.size() );
+		for (IndexInt n=0; n<num; n++) order[n] = indexSys[n].sourceIndex;
+		IndexInt rest = num;
+		for (IndexInt i=0; i<(IndexInt)parts.size(); i++) {
+			if (slabs.cellOf[i] < 0) order[rest++] = i;
+		}
+		parts.reorder(order);
+		for (IndexInt n=0; n<num; n++) indexSys[n].sourceIndex = n;
 	}
 
 	if(delCounter) delete counter;
 }
 
-KERNEL()
-void ComputeUnionLevelsetPindex(Grid<int>& index, BasicParticleSystem& parts, ParticleIndexSystem& indexSys, 
-		LevelsetGrid& phi, Real radius=1.) 
+static inline Real unionLevelsetValue(int i, int j, int k, const Grid<int>& index, BasicParticleSystem& parts, 
+		const ParticleIndexSystem& indexSys, const LevelsetGrid& phi, Real radius) 
 {
 	const Vec3 gridPos = Vec3(i,j,k) + Vec3(0.5); // shifted by half cell
 	Real phiv = radius * 1.0;  // outside
@@ -282,20 +395,42 @@ void ComputeUnionLevelsetPindex(Grid<int>& index, BasicParticleSystem& parts, Pa
 		// now loop over particles in cell
 		for(IndexInt p=pStart; p<pEnd; ++p) {
 			const IndexInt psrc = indexSys[p].sourceIndex;
-			const Vec3 pos = parts[psrc].pos; 
+			const Vec3 pos = parts.getPos(psrc); 
 			phiv = std::min( phiv , fabs( norm(gridPos-pos) )-radius );
 		}
 	}
-	phi(i,j,k) = phiv;
+	return phiv;
+}
+
+KERNEL()
+void ComputeUnionLevelsetPindex(Grid<int>& index, BasicParticleSystem& parts, ParticleIndexSystem& indexSys, 
+		LevelsetGrid& phi, Real radius=1.) 
+{
+	phi(i,j,k) = unionLevelsetValue(i,j,k, index, parts, indexSys, phi, radius);
+}
+
+KERNEL(pts)
+void ComputeUnionLevelsetPindexBand(const LevelsetBand& band, Grid<int>& index, BasicParticleSystem& parts, 
+		ParticleIndexSystem& indexSys, LevelsetGrid& phi, Real radius) 
+{
+	const Vec3i p = band.getPos(idx);
+	phi[band[idx]] = unionLevelsetValue(p.x,p.y,p.z, index, parts, indexSys, phi, radius);
 }
  
+//! with band, only the band cells are computed, all others are set to outside 
+//! (the band has to contain all cells within radius of the particles)
 PYTHON() void unionParticleLevelset( BasicParticleSystem& parts, ParticleIndexSystem& indexSys, 
-		FlagGrid& flags, Grid<int>& index, LevelsetGrid& phi, Real radiusFactor=1. ) 
+		FlagGrid& flags, Grid<int>& index, LevelsetGrid& phi, Real radiusFactor=1., const LevelsetBand* band=NULL ) 
 {
 	// use half a cell diagonal as base radius
 	const Real radius = 0.5 * calculateRadiusFactor(phi, radiusFactor);
-	// no reset of phi necessary here 
-	ComputeUnionLevelsetPindex(index, parts, indexSys, phi, radius);
+	if(!band) {
+		// no reset of phi necessary here 
+		ComputeUnionLevelsetPindex(index, parts, indexSys, phi, radius);
+	} else {
+		phi.setConst(radius);
+		ComputeUnionLevelsetPindexBand(*band, index, parts, indexSys, phi, radius);
+	}
 
 	phi.setBound(0.5, 0);
 }
@@ -329,7 +464,7 @@ void ComputeAveragedLevelsetWeight(BasicParticleSystem& parts,
 		else                           pEnd = indexSys.size();
 		for(IndexInt p=pStart; p<pEnd; ++p) {
 			IndexInt   psrc = indexSys[p].sourceIndex;
-			Vec3  pos  = parts[psrc].pos; 
+			Vec3  pos  = parts.getPos(psrc); 
 			Real  s    = normSquare(gridPos-pos) * sradiusInv;
 			//Real  w = std::max(0., cubed(1.-s) );
 			Real  w = std::max(0., (1.-s) ); // a bit smoother
@@ -449,13 +584,24 @@ void knMapLinearVec3ToMACGrid( BasicParticleSystem& p, FlagGrid& flags, MACGrid&
 {
 	unusedParameter(flags);
 	if (!p.isActive(idx)) return;
-	vel.setInterpolated( p[idx].pos, pvel[idx], &tmp[0] );
+	vel.setInterpolated( p.getPos(idx), pvel[idx], &tmp[0] );
+}
+
+//! stomp small weights and normalize, for the band cells only
+KERNEL(pts)
+void knNormalizeMACBand(const LevelsetBand& band, MACGrid& vel, Grid<Vec3>& weight, Real threshold) {
+	const IndexInt c = band[idx];
+	for (int d=0; d<3; d++) {
+		if(weight[c][d] < threshold) weight[c][d] = 0.;
+		vel[c][d] = safeDivide(vel[c][d], weight[c][d]);
+	}
 }
 
 // optionally , this function can use an existing vec3 grid to store the weights
 // this is useful in combination with the simple extrapolation function
+// with band, velocities are only normalized in the band cells (the band has to contain all particles)
 PYTHON() void mapPartsToMAC( FlagGrid& flags, MACGrid& vel , MACGrid& velOld , 
-		BasicParticleSystem& parts , ParticleDataImpl<Vec3>& partVel , Grid<Vec3>* weight=NULL ) 
+		BasicParticleSystem& parts , ParticleDataImpl<Vec3>& partVel , Grid<Vec3>* weight=NULL, const LevelsetBand* band=NULL ) 
 {
 	// interpol -> grid. tmpgrid for particle contribution weights
 	bool freeTmp = false;
@@ -469,8 +615,12 @@ PYTHON() void mapPartsToMAC( FlagGrid& flags, MACGrid& vel , MACGrid& velOld ,
 	knMapLinearVec3ToMACGrid( parts, flags, vel, *weight, partVel );
 
 	// stomp small values in weight to zero to prevent roundoff errors
-	knStompVec3PerComponent( *weight, VECTOR_EPSILON );
-	vel.safeDivide(*weight);
+	if(band) {
+		knNormalizeMACBand( *band, vel, *weight, VECTOR_EPSILON );
+	} else {
+		knStompVec3PerComponent( *weight, VECTOR_EPSILON );
+		vel.safeDivide(*weight);
+	}
 	
 	// store original state
 	velOld.copyFrom( vel );
@@ -483,7 +633,7 @@ void knMapLinear( BasicParticleSystem& p, FlagGrid& flags, Grid<T>& target, Grid
 {
 	unusedParameter(flags);
 	if (!p.isActive(idx)) return;
-	target.setInterpolated( p[idx].pos, psource[idx], gtmp );
+	target.setInterpolated( p.getPos(idx), psource[idx], gtmp );
 } 
 template<class T>
 void mapLinearRealHelper( FlagGrid& flags, Grid<T>& target , 
@@ -506,56 +656,184 @@ PYTHON() void mapPartsToGridVec3( FlagGrid& flags, Grid<Vec3>& target , BasicPar
 //	mapLinearRealHelper<int >(flags,target,parts,source);
 //}
 
+//! collect positions of the active particles in one batch, returns number of positions
+static inline int getActiveBatch(BasicParticleSystem& p, const InterpolBatches& batches, IndexInt batch, IndexInt* ids, Vec3* pos) {
+	int n = 0;
+	const IndexInt start = batches.start(batch), end = start + batches.count(batch);
+	for (IndexInt i=start; i<end; i++) {
+		if (!p.isActive(i)) continue;
+		ids[n] = i;
+		pos[n++] = p.getPos(i);
+	}
+	return n;
+}
+
 KERNEL(pts) template<class T>
-void knMapFromGrid( BasicParticleSystem& p, Grid<T>& gsrc, ParticleDataImpl<T>& target ) 
+void knMapFromGrid( InterpolBatches& batches, BasicParticleSystem& p, Grid<T>& gsrc, ParticleDataImpl<T>& target ) 
 {
-	if (!p.isActive(idx)) return;
-	target[idx] = gsrc.getInterpolated( p[idx].pos );
+	IndexInt ids[INTERPOL_BATCH];
+	Vec3 pos[INTERPOL_BATCH];
+	T val[INTERPOL_BATCH];
+	const int n = getActiveBatch(p, batches, idx, ids, pos);
+	gsrc.getInterpolatedBatch(pos, n, val);
+	for (int l=0; l<n; l++) target[ids[l]] = val[l];
 } 
 PYTHON() void mapGridToParts    ( Grid<Real>& source , BasicParticleSystem& parts , ParticleDataImpl<Real>& target ) {
-	knMapFromGrid<Real>(parts, source, target);
+	InterpolBatches batches(parts.size());
+	knMapFromGrid<Real>(batches, parts, source, target);
 }
 PYTHON() void mapGridToPartsVec3( Grid<Vec3>& source , BasicParticleSystem& parts , ParticleDataImpl<Vec3>& target ) {
-	knMapFromGrid<Vec3>(parts, source, target);
+	InterpolBatches batches(parts.size());
+	knMapFromGrid<Vec3>(batches, parts, source, target);
 }
 
 
 // Get velocities from grid
 
 KERNEL(pts) 
-void knMapLinearMACGridToVec3_PIC( BasicParticleSystem& p, FlagGrid& flags, MACGrid& vel, ParticleDataImpl<Vec3>& pvel ) 
+void knMapLinearMACGridToVec3_PIC( InterpolBatches& batches, BasicParticleSystem& p, FlagGrid& flags, MACGrid& vel, ParticleDataImpl<Vec3>& pvel ) 
 {
-	if (!p.isActive(idx)) return;
+	IndexInt ids[INTERPOL_BATCH];
+	Vec3 pos[INTERPOL_BATCH], v[INTERPOL_BATCH];
+	const int n = getActiveBatch(p, batches, idx, ids, pos);
 	// pure PIC
-	pvel[idx] = vel.getInterpolated( p[idx].pos );
+	vel.getInterpolatedBatch(pos, n, v);
+	for (int l=0; l<n; l++) pvel[ids[l]] = v[l];
 }
 PYTHON() void mapMACToParts(FlagGrid& flags, MACGrid& vel , 
 		BasicParticleSystem& parts , ParticleDataImpl<Vec3>& partVel ) {
-	knMapLinearMACGridToVec3_PIC( parts, flags, vel, partVel );
+	InterpolBatches batches(parts.size());
+	knMapLinearMACGridToVec3_PIC( batches, parts, flags, vel, partVel );
 }
 
 // with flip delta interpolation 
 KERNEL(pts) 
-void knMapLinearMACGridToVec3_FLIP( BasicParticleSystem& p, FlagGrid& flags, MACGrid& vel, MACGrid& oldVel, ParticleDataImpl<Vec3>& pvel , Real flipRatio) 
+void knMapLinearMACGridToVec3_FLIP( InterpolBatches& batches, BasicParticleSystem& p, FlagGrid& flags, MACGrid& vel, MACGrid& oldVel, ParticleDataImpl<Vec3>& pvel , Real flipRatio) 
 {
-	if (!p.isActive(idx)) return; 
-	Vec3 v     =        vel.getInterpolated(p[idx].pos);
-	Vec3 delta = v - oldVel.getInterpolated(p[idx].pos); 
-	pvel[idx] = flipRatio * (pvel[idx] + delta) + (1.0 - flipRatio) * v;    
+	IndexInt ids[INTERPOL_BATCH];
+	Vec3 pos[INTERPOL_BATCH], v[INTERPOL_BATCH], vOld[INTERPOL_BATCH];
+	const int n = getActiveBatch(p, batches, idx, ids, pos);
+	if (n == 0) return;
+	// both grids are sampled at the same positions, share weights
+	InterpolWeightsBatchMAC w;
+	getInterpolWeightsBatchMAC(vel.getSize(), vel.getStrideZ(), pos, n, w);
+	vel.getInterpolatedBatch(w, n, v);
+	oldVel.getInterpolatedBatch(w, n, vOld);
+	for (int l=0; l<n; l++) {
+		const Vec3 delta = v[l] - vOld[l];
+		pvel[ids[l]] = flipRatio * (pvel[ids[l]] + delta) + (1.0 - flipRatio) * v[l];
+	}
 }
 
 PYTHON() void flipVelocityUpdate(FlagGrid& flags, MACGrid& vel , MACGrid& velOld , 
 		BasicParticleSystem& parts , ParticleDataImpl<Vec3>& partVel , Real flipRatio ) {
-	knMapLinearMACGridToVec3_FLIP( parts, flags, vel, velOld, partVel, flipRatio );
+	InterpolBatches batches(parts.size());
+	knMapLinearMACGridToVec3_FLIP( batches, parts, flags, vel, velOld, partVel, flipRatio );
+}
+
+//******************************************************************************
+// APIC (affine particle-in-cell) 
+// each particle carries the gradient of each velocity component (cx, cy, cz) in addition to its velocity
+
+//! trilinear weights, weight gradients and node offsets of the 2x2x2 face nodes of MAC component c around pos
+struct ApicStencil {
+	ApicStencil(const MACGrid& vel, const Vec3& pos, const int c) {
+		const Vec3i& size = vel.getSize();
+		Vec3 shift(0.);
+		shift[c] = 0.5;
+		const InterpolWeights iw = getInterpolWeights(size, pos + shift);
+		const Real gz = vel.is3D() ? 1. : 0.;
+		const Real wx[2] = { iw.s0, iw.s1 }, wy[2] = { iw.t0, iw.t1 }, wz[2] = { gz ? iw.f0 : 1, gz ? iw.f1 : 0 };
+		const Real gx[2] = { -1., 1. }, gy[2] = { -1., 1. }, gzz[2] = { -gz, gz };
+		// face c of cell n is located at n, shifted by half a cell along the other axes
+		const Vec3 node0 = Vec3(iw.xi, iw.yi, iw.zi) + Vec3(0.5) - shift - pos;
+		num = vel.is3D() ? 8 : 4;
+		for (int n=0; n<num; n++) {
+			const int a = n&1, b = (n>>1)&1, d = (n>>2)&1;
+			idx[n]    = vel.index(iw.xi+a, iw.yi+b, d ? iw.zi1 : iw.zi);
+			w[n]      = wx[a] * wy[b] * wz[d];
+			grad[n]   = Vec3( gx[a]*wy[b]*wz[d], wx[a]*gy[b]*wz[d], wx[a]*wy[b]*gzz[d] );
+			offset[n] = node0 + Vec3(a, b, d);
+			if (!vel.is3D()) offset[n].z = 0.;
+		}
+	}
+	int num;
+	IndexInt idx[8];
+	Real w[8];
+	Vec3 grad[8], offset[8];
+};
+
+KERNEL(pts, single) 
+void knApicMapLinearVec3ToMACGrid( BasicParticleSystem& p, MACGrid& vel, Grid<Vec3>& tmp, const ParticleDataImpl<Vec3>& pvel, 
+	const ParticleDataImpl<Vec3>& cpx, const ParticleDataImpl<Vec3>& cpy, const ParticleDataImpl<Vec3>& cpz ) 
+{
+	if (!p.isActive(idx)) return;
+	const Vec3 pos = p.getPos(idx);
+	const Vec3 cp[3] = { cpx[idx], cpy[idx], cpz[idx] };
+	for (int c=0; c<3; c++) {
+		const ApicStencil st(vel, pos, c);
+		for (int n=0; n<st.num; n++) {
+			// velocity at the node from the affine velocity field of the particle
+			vel[st.idx[n]][c] += st.w[n] * ( pvel[idx][c] + dot(cp[c], st.offset[n]) );
+			tmp[st.idx[n]][c] += st.w[n];
+		}
+	}
+}
+
+//! APIC variant of mapPartsToMAC, transfers the particle velocities including their affine components cpx, cpy, cpz
+PYTHON() void apicMapPartsToMAC( FlagGrid& flags, MACGrid& vel, BasicParticleSystem& parts, ParticleDataImpl<Vec3>& partVel, 
+		ParticleDataImpl<Vec3>& cpx, ParticleDataImpl<Vec3>& cpy, ParticleDataImpl<Vec3>& cpz, Grid<Vec3>* weight=NULL ) 
+{
+	bool freeTmp = false;
+	if(!weight) {
+		weight = new Grid<Vec3>(flags.getParent());
+		freeTmp = true;
+	} else {
+		weight->clear(); // make sure we start with a zero grid!
+	}
+	vel.clear();
+	knApicMapLinearVec3ToMACGrid( parts, vel, *weight, partVel, cpx, cpy, cpz );
+
+	// stomp small values in weight to zero to prevent roundoff errors
+	knStompVec3PerComponent( *weight, VECTOR_EPSILON );
+	vel.safeDivide(*weight);
+	if(freeTmp) delete weight;
+}
+
+KERNEL(pts) 
+void knApicMapLinearMACGridToVec3( BasicParticleSystem& p, const MACGrid& vel, ParticleDataImpl<Vec3>& pvel, 
+	ParticleDataImpl<Vec3>& cpx, ParticleDataImpl<Vec3>& cpy, ParticleDataImpl<Vec3>& cpz ) 
+{
+	if (!p.isActive(idx)) return;
+	const Vec3 pos = p.getPos(idx);
+	Vec3* cp[3] = { &cpx[idx], &cpy[idx], &cpz[idx] };
+	Vec3 v(0.);
+	for (int c=0; c<3; c++) {
+		const ApicStencil st(vel, pos, c);
+		Vec3 grad(0.);
+		for (int n=0; n<st.num; n++) {
+			const Real u = vel[st.idx[n]][c];
+			v[c] += st.w[n] * u;
+			grad  += st.grad[n] * u;
+		}
+		*cp[c] = grad;
+	}
+	pvel[idx] = v;
+}
+
+//! APIC variant of mapMACToParts, also updates the affine components cpx, cpy, cpz (gradients of the velocity components)
+PYTHON() void apicMapMACToParts( MACGrid& vel, BasicParticleSystem& parts, ParticleDataImpl<Vec3>& partVel, 
+		ParticleDataImpl<Vec3>& cpx, ParticleDataImpl<Vec3>& cpy, ParticleDataImpl<Vec3>& cpz ) 
+{
+	knApicMapLinearMACGridToVec3( parts, vel, partVel, cpx, cpy, cpz );
 }
 
 
 //******************************************************************************
 // narrow band 
 
-KERNEL()
-void knCombineVels(MACGrid& vel, Grid<Vec3>& w, MACGrid& combineVel, LevelsetGrid* phi, Real narrowBand, Real thresh ) {
-	int idx = vel.index(i,j,k);
+static inline void combineVelsCell(int i, int j, int k, MACGrid& vel, Grid<Vec3>& w, MACGrid& combineVel, LevelsetGrid* phi, Real narrowBand, Real thresh ) {
+	const IndexInt idx = vel.index(i,j,k);
 
 	for(int c=0; c<3; ++c)
 	{
@@ -578,10 +856,22 @@ void knCombineVels(MACGrid& vel, Grid<Vec3>& w, MACGrid& combineVel, LevelsetGri
 	}
 }
 
-//! narrow band velocity combination
+KERNEL()
+void knCombineVels(MACGrid& vel, Grid<Vec3>& w, MACGrid& combineVel, LevelsetGrid* phi, Real narrowBand, Real thresh ) {
+	combineVelsCell(i,j,k, vel, w, combineVel, phi, narrowBand, thresh);
+}
+
+KERNEL(pts)
+void knCombineVelsBand(const LevelsetBand& band, MACGrid& vel, Grid<Vec3>& w, MACGrid& combineVel, LevelsetGrid* phi, Real narrowBand, Real thresh ) {
+	const Vec3i p = band.getPos(idx);
+	combineVelsCell(p.x,p.y,p.z, vel, w, combineVel, phi, narrowBand, thresh);
+}
+
+//! narrow band velocity combination, with band only the band cells are combined
 PYTHON() void combineGridVel( MACGrid& vel, Grid<Vec3>& weight, MACGrid& combineVel, LevelsetGrid* phi=NULL,
-    Real narrowBand=0.0, Real thresh=0.0) {
-	knCombineVels(vel, weight, combineVel, phi, narrowBand, thresh);
+    Real narrowBand=0.0, Real thresh=0.0, const LevelsetBand* band=NULL) {
+	if(band) knCombineVelsBand(*band, vel, weight, combineVel, phi, narrowBand, thresh);
+	else     knCombineVels(vel, weight, combineVel, phi, narrowBand, thresh);
 }
 
 
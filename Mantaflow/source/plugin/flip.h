@@ -26,7 +26,7 @@ void sampleFlagsWithParticles(FlagGrid& flags, BasicParticleSystem& parts, int d
 
 void sampleLevelsetWithParticles(LevelsetGrid& phi, FlagGrid& flags, BasicParticleSystem& parts, int discretization, Real randomness, bool reset = false, bool refillEmpty = false);
 
-void mapPartsToMAC(FlagGrid& flags, MACGrid& vel, MACGrid& velOld, BasicParticleSystem& parts, ParticleDataImpl<Vec3>& partVel, Grid<Vec3>* weight = NULL);
+void mapPartsToMAC(FlagGrid& flags, MACGrid& vel, MACGrid& velOld, BasicParticleSystem& parts, ParticleDataImpl<Vec3>& partVel, Grid<Vec3>* weight = NULL, const LevelsetBand* band = NULL);
 
 void markFluidCells(BasicParticleSystem& parts, FlagGrid& flags, Grid<Real>* phiObs = NULL);
 
@@ -34,6 +34,10 @@ void adjustNumber(BasicParticleSystem& parts, MACGrid& vel, FlagGrid& flags, int
 
 void flipVelocityUpdate(FlagGrid& flags, MACGrid& vel, MACGrid& velOld, BasicParticleSystem& parts, ParticleDataImpl<Vec3>& partVel, Real flipRatio);
 
+void apicMapPartsToMAC(FlagGrid& flags, MACGrid& vel, BasicParticleSystem& parts, ParticleDataImpl<Vec3>& partVel, ParticleDataImpl<Vec3>& cpx, ParticleDataImpl<Vec3>& cpy, ParticleDataImpl<Vec3>& cpz, Grid<Vec3>* weight = NULL);
+
+void apicMapMACToParts(MACGrid& vel, BasicParticleSystem& parts, ParticleDataImpl<Vec3>& partVel, ParticleDataImpl<Vec3>& cpx, ParticleDataImpl<Vec3>& cpy, ParticleDataImpl<Vec3>& cpz);
+
 void mapGridToPartsVec3(Grid<Vec3>& source , BasicParticleSystem& parts , ParticleDataImpl<Vec3>& target);
 
 void pushOutofObs(BasicParticleSystem& parts, FlagGrid& flags, Grid<Real>& phiObs, Real shift = 0.05, Real thresh = 0.0);
@@ -44,13 +48,13 @@ void testInitGridWithPos(Grid<Real>& grid);
 // build a grid that contains indices for a particle system
 // the particles in a cell i,j,k are particles[index(i,j,k)] to particles[index(i+1,j,k)-1]
 // (ie,  particles[index(i+1,j,k)] already belongs to cell i+1,j,k)
-void gridParticleIndex( BasicParticleSystem& parts, ParticleIndexSystem& indexSys, FlagGrid& flags, Grid<int>& index, Grid<int>* counter = nullptr);
+void gridParticleIndex( BasicParticleSystem& parts, ParticleIndexSystem& indexSys, FlagGrid& flags, Grid<int>& index, Grid<int>* counter = nullptr, int reorderInterval = 0);
 
-void unionParticleLevelset(BasicParticleSystem& parts, ParticleIndexSystem& indexSys, FlagGrid& flags, Grid<int>& index, LevelsetGrid& phi, Real radiusFactor = 1.0);
+void unionParticleLevelset(BasicParticleSystem& parts, ParticleIndexSystem& indexSys, FlagGrid& flags, Grid<int>& index, LevelsetGrid& phi, Real radiusFactor = 1.0, const LevelsetBand* band = NULL);
 
 void averagedParticleLevelset(BasicParticleSystem& parts, ParticleIndexSystem& indexSys, FlagGrid& flags, Grid<int>& index, LevelsetGrid& phi, Real radiusFactor = 1.0, int smoothen = 1 , int smoothenNeg = 1);
 
 void combineGridVel(MACGrid& vel, Grid<Vec3>& weight, MACGrid& combineVel, LevelsetGrid* phi = NULL,
-                    Real narrowBand = 0.0, Real thresh = 0.0);
+                    Real narrowBand = 0.0, Real thresh = 0.0, const LevelsetBand* band = NULL);
 
 } // namespace
@@ -25,15 +25,47 @@
 #include "kernel.h"
 #include "edgecollapse.h"
 #include <mesh.h>
-#include <stack>
 
 using namespace std;
 
 namespace Manta { 
 
+//! one Jacobi step of the umbrella operator: unit edge vectors to the 1-ring nodes, normalized by the 
+//! total edge length. Nodes with an edge shorter than minLength don't move
+KERNEL(pts)
+void knSmoothNodes(const vector<Node>& nodes, vector<Vec3>& temp, const CompactOneRing& ring, const Real str, const Real minLength) {
+	const Vec3 pos = nodes[idx].pos;
+	temp[idx] = pos;
+	Vec3 dx(0.0);
+	Real totalLen = 0;
+	for (const int* it=ring.nodes.begin(idx); it!=ring.nodes.end(idx); ++it) {
+		Vec3 edge = nodes[*it].pos - pos;
+		Real len = norm(edge);
+		if (len <= minLength) return;
+		dx += edge * (1.0/len);
+		totalLen += len;
+	}
+	if (totalLen != 0)
+		temp[idx] += dx * (str / totalLen);
+}
+
+KERNEL(pts)
+void knSetNodePositions(vector<Node>& nodes, const vector<Vec3>& pos) {
+	if (!(nodes[idx].flags & Mesh::NfFixed))
+		nodes[idx].pos = pos[idx];
+}
+
+KERNEL(pts)
+void knScaleAroundCM(vector<Node>& nodes, const Vec3 origCM, const Vec3 newCM, const Real beta) {
+	if (!(nodes[idx].flags & Mesh::NfFixed))
+		nodes[idx].pos = origCM + (nodes[idx].pos - newCM) * beta;
+}
+
 //! Mesh smoothing 
-/*! see Desbrun 99 "Implicit fairing of of irregular meshes using diffusion and curvature flow"*/
-PYTHON() void smoothMesh(Mesh& mesh, Real strength, int steps = 1, Real minLength=1e-5) {
+/*! see Desbrun 99 "Implicit fairing of of irregular meshes using diffusion and curvature flow".
+    taubin > 0 follows each step with an inflating step of strength -taubin*strength 
+    (Taubin 95, typically 1.02 - 1.1), which counters the shrinkage */
+PYTHON() void smoothMesh(Mesh& mesh, Real strength, int steps = 1, Real minLength=1e-5, Real taubin=0.) {
 	const Real dt = mesh.getParent()->getDt();
 	const Real str = min(dt * strength, (Real)1);
 	mesh.rebuildQuickCheck(); 
@@ -42,48 +74,16 @@ PYTHON() void smoothMesh(Mesh& mesh, Real strength, int steps = 1, Real minLengt
 	Vec3 origCM;
 	Real origVolume = mesh.computeCenterOfMass(origCM);
 	
-	// temp vertices
-	const int numCorners = mesh.numTris() * 3;
-	const int numNodes= mesh.numNodes();            
-	vector<Vec3> temp(numNodes);
-	vector<bool> visited(numNodes);
+	const CompactOneRing& ring = mesh.get1RingLookup();
+	vector<Vec3> temp(mesh.numNodes());
 	
 	for (int s = 0; s<steps; s++) {
-		// reset markers
-		for(size_t i=0; i<visited.size(); i++) visited[i] = false;
-		
-		for (int c = 0; c < numCorners; c++) {
-			const int node = mesh.corners(c).node;
-			if (visited[node]) continue;
-			
-			const Vec3 pos = mesh.nodes(node).pos;
-			Vec3 dx(0.0);
-			Real totalLen = 0;
-				
-			// rotate around vertex
-			set<int>& ring = mesh.get1Ring(node).nodes;
-			for(set<int>::iterator it=ring.begin(); it!=ring.end(); it++) {
-				Vec3 edge = mesh.nodes(*it).pos - pos;
-				Real len = norm(edge);
-
-				if (len > minLength) {
-					dx += edge * (1.0/len);
-					totalLen += len;
-				} else {
-					totalLen = 0.0;
-					break;
-				}                
-			}
-			visited[node] = true;
-			temp[node] = pos;            
-			if (totalLen != 0)
-				temp[node] += dx * (str / totalLen);
+		knSmoothNodes(mesh.getNodeData(), temp, ring, str, minLength);
+		knSetNodePositions(mesh.getNodeData(), temp);
+		if (taubin > 0) {
+			knSmoothNodes(mesh.getNodeData(), temp, ring, -taubin * str, minLength);
+			knSetNodePositions(mesh.getNodeData(), temp);
 		}
-		
-		// copy back
-		for (int n=0; n<numNodes; n++)
-			if (!mesh.isNodeFixed(n))
-				mesh.nodes(n).pos = temp[n];
 	}
 	
 	// calculate new mesh volume
@@ -98,524 +98,637 @@ PYTHON() void smoothMesh(Mesh& mesh, Real strength, int steps = 1, Real minLengt
 	beta = cbrt( origVolume/newVolume );
 #	endif
 
-	for (int n=0; n<numNodes; n++)
-		if (!mesh.isNodeFixed(n))
-			mesh.nodes(n).pos = origCM + (mesh.nodes(n).pos - newCM) * beta;
+	knScaleAroundCM(mesh.getNodeData(), origCM, newCM, beta);
 }
 
-//! Subdivide and edgecollapse to guarantee mesh with edgelengths between
-//! min/maxLength and an angle below minAngle
-PYTHON() void subdivideMesh(Mesh& mesh, Real minAngle, Real minLength, Real maxLength, bool cutTubes = false) {
-	// gather some statistics
-	int edgeSubdivs = 0, edgeCollsAngle = 0, edgeCollsLen = 0, edgeKill = 0;
-	mesh.rebuildQuickCheck(); 
+//*****************************************************************************
+// Batched remeshing: independent edges are split or collapsed in parallel rounds,
+// deleted triangles and nodes are only flagged and removed by one compaction
 
-	vector<int> deletedNodes;
-	map<int,bool> taintedTris;
-	priority_queue<pair<Real,int> > pq;
-	
-	//////////////////////////////////////////
-	// EDGE COLLAPSE                        //
-	//    - particles marked for deletation //
-	//////////////////////////////////////////
-	
-	for (int t=0; t<mesh.numTris(); t++) {
-		if(taintedTris.find(t)!=taintedTris.end())
-			continue;
-		
+enum CollapseCriterion { CollapseKill = 0, CollapseAngle, CollapseLength };
+static const int MaxCollapseRounds = 64;
+
+//! edge of triangle t to collapse for the given criterion, as corner "which" opposite to it.
+//! key orders the candidates, smaller keys are collapsed first. Returns false if t needs no collapse
+static bool collapseCandidate(Mesh& mesh, const int t, const int criterion, const Real threshold, 
+							  int& which, Vec3& edgevect, Vec3& endpoint, Real& key) 
+{
+	if (criterion == CollapseKill) {
 		// check if at least 2 nodes are marked for delete
 		bool k[3];
-		int numKill = 0;
-		for (int i=0; i<3; i++) {
+		for (int i=0; i<3; i++)
 			k[i] = mesh.nodes(mesh.tris(t).c[i]).flags & Mesh::NfKillme;
-			if (k[i]) numKill++;
-		}        
-		if (numKill<2) continue;
-		
-		if (k[0] && k[1])
-			CollapseEdge(mesh, t, 2, mesh.getEdge(t,0), mesh.getNode(t,0), deletedNodes, taintedTris, edgeKill, cutTubes);
-		else if (k[1] && k[2])
-			CollapseEdge(mesh, t, 0, mesh.getEdge(t,1), mesh.getNode(t,1), deletedNodes, taintedTris, edgeKill, cutTubes);
-		else if (k[2] && k[0])
-			CollapseEdge(mesh, t, 1, mesh.getEdge(t,2), mesh.getNode(t,2), deletedNodes, taintedTris, edgeKill, cutTubes);
+		int e;
+		if (k[0] && k[1])      { which = 2; e = 0; }
+		else if (k[1] && k[2]) { which = 0; e = 1; }
+		else if (k[2] && k[0]) { which = 1; e = 2; }
+		else return false;
+		edgevect = mesh.getEdge(t,e);
+		endpoint = mesh.getNode(t,e);
+		key = normSquare(edgevect);
+		return true;
 	}
-			
-	//////////////////////////////////////////
-	// EDGE COLLAPSING                      //
-	//      - based on small triangle angle //
-	//////////////////////////////////////////
 	
-	if (minAngle > 0) {
-		for(int t=0; t<mesh.numTris(); t++) {
-			// we only want to run through the edge list ONCE.
-			// we achieve this in a method very similar to the above subdivision method.
-
-			// if this triangle has already been deleted, ignore it
-			if(taintedTris.find(t)!=taintedTris.end())
-				continue;
-			
-			// first we find the angles of this triangle
-			Vec3 e0 = mesh.getEdge(t,0), e1 = mesh.getEdge(t,1), e2 = mesh.getEdge(t,2);
-			Vec3 ne0 = e0;
-			Vec3 ne1 = e1;
-			Vec3 ne2 = e2;
-			normalize(ne0);
-			normalize(ne1);
-			normalize(ne2);
-
-			//Real thisArea = sqrMag(cross(-e2,e0));
-			// small angle approximation says sin(x) = arcsin(x) = x,
-			// arccos(x) = pi/2 - arcsin(x),
-			// cos(x) = dot(A,B),
-			// so angle is approximately 1 - dot(A,B).
-			Real angle[3];
-			angle[0] = 1.0-dot(ne0,-ne2);
-			angle[1] = 1.0-dot(ne1,-ne0);
-			angle[2] = 1.0-dot(ne2,-ne1);
-			Real worstAngle = angle[0];
-			int which = 0;
-			if(angle[1]<worstAngle) {
-				worstAngle = angle[1];
-				which = 1;
-			}
-			if(angle[2]<worstAngle) {
-				worstAngle = angle[2];
-				which = 2;
-			}
+	Vec3 e0 = mesh.getEdge(t,0), e1 = mesh.getEdge(t,1), e2 = mesh.getEdge(t,2);
+	if (criterion == CollapseAngle) {
+		Vec3 ne0 = e0;
+		Vec3 ne1 = e1;
+		Vec3 ne2 = e2;
+		normalize(ne0);
+		normalize(ne1);
+		normalize(ne2);
 
-			// then we see if the angle is too small
-			if(worstAngle<minAngle) {
-				Vec3 edgevect;
-				Vec3 endpoint;
-				switch(which) {
-				case 0:
-					endpoint = mesh.getNode(t,1);
-					edgevect = e1;
-					break;
-				case 1:
-					endpoint = mesh.getNode(t,2);
-					edgevect = e2;
-					break;
-				case 2:
-					endpoint = mesh.getNode(t,0);
-					edgevect = e0;
-					break;
-				default:
-					break;
-				}
-
-				CollapseEdge(mesh, t,which,edgevect,endpoint,deletedNodes,taintedTris, edgeCollsAngle, cutTubes);
-			}
+		// small angle approximation says sin(x) = arcsin(x) = x,
+		// arccos(x) = pi/2 - arcsin(x),
+		// cos(x) = dot(A,B),
+		// so angle is approximately 1 - dot(A,B).
+		Real angle[3];
+		angle[0] = 1.0-dot(ne0,-ne2);
+		angle[1] = 1.0-dot(ne1,-ne0);
+		angle[2] = 1.0-dot(ne2,-ne1);
+		Real worstAngle = angle[0];
+		which = 0;
+		if(angle[1]<worstAngle) {
+			worstAngle = angle[1];
+			which = 1;
+		}
+		if(angle[2]<worstAngle) {
+			worstAngle = angle[2];
+			which = 2;
 		}
+		const int e = (which+1)%3;
+		endpoint = mesh.getNode(t,e);
+		edgevect = (e==0) ? e0 : (e==1 ? e1 : e2);
+		key = worstAngle;
+		return worstAngle < threshold;
 	}
 	
-	//////////////////////
-	// EDGE SUBDIVISION //
-	//////////////////////
+	// CollapseLength: find the minimum length edge in this triangle
+	Real d0 = normSquare(e0);
+	Real d1 = normSquare(e1);
+	Real d2 = normSquare(e2);
+	if(d0<d1) {
+		if(d0<d2) {
+			key = d0;
+			edgevect = e0;
+			endpoint = mesh.getNode(t,0);
+			which = 2;  // 2 opposite of edge 0-1
+		} else {
+			key = d2;
+			edgevect = e2;
+			endpoint =  mesh.getNode(t,2);
+			which = 1;  // 1 opposite of edge 2-0
+		}
+	} else {
+		if(d1<d2) {
+			key = d1;
+			edgevect = e1;
+			endpoint =  mesh.getNode(t,1);
+			which = 0;  // 0 opposite of edge 1-2
+		} else {
+			key = d2;
+			edgevect = e2;
+			endpoint =  mesh.getNode(t,2);
+			which = 1;  // 1 opposite of edge 2-0
+		}
+	}
+	return key < threshold;
+}
 
-	Real maxLength2 = maxLength*maxLength;
-	for (int t=0; t<mesh.numTris(); t++) {
-		// first we find the maximum length edge in this triangle
-		Vec3 e0 = mesh.getEdge(t,0), e1 = mesh.getEdge(t,1), e2 = mesh.getEdge(t,2);
-		Real d0 = normSquare(e0);
-		Real d1 = normSquare(e1);
-		Real d2 = normSquare(e2);
-
-		Real longest = max(d0,max(d1,d2));        
-		if(longest > maxLength2) {
-			pq.push(pair<Real,int>(longest,t));
+//! candidate a is collapsed before b, ties are broken by triangle index
+static inline bool betterCollapse(const int a, const int b, const vector<Real>& key) {
+	if (a < 0) return false;
+	if (b < 0) return true;
+	return key[a] < key[b] || (key[a] == key[b] && a < b);
+}
+
+//! collapse candidates among the given triangles, simple ones only need the plain edge collapse
+KERNEL(pts)
+void knCollapseCandidates(const vector<int>& tris, vector<int>& cand, vector<char>& simple, vector<Real>& key, 
+						  Mesh& mesh, const vector<char>& taintedTris, const int criterion, const Real threshold) {
+	const int t = tris[idx];
+	cand[t] = -1;
+	simple[t] = false;
+	if (taintedTris[t]) return;
+	int which; 
+	Vec3 edgevect, endpoint;
+	if (!collapseCandidate(mesh, t, criterion, threshold, which, edgevect, endpoint, key[t])) return;
+	cand[t] = which;
+	simple[t] = IsSimpleCollapse(mesh, t, which);
+}
+
+//! a candidate is applied if no better one has an endpoint within two rings of its endpoints,
+//! so that the neighborhoods of the applied collapses are disjoint. bestAtNode is the best candidate per endpoint
+KERNEL(pts)
+void knSelectCollapses(const vector<int>& candTris, vector<char>& selected, Mesh& mesh, const vector<int>& cand, 
+					   const vector<int>& bestAtNode, const vector<Real>& key) {
+	const int t = candTris[idx];
+	const CompactLists& ring = mesh.get1RingLookup().nodes;
+	selected[idx] = false;
+	for (int e=1; e<3; e++) {
+		const int n = mesh.tris(t).c[(cand[t]+e)%3];
+		if (betterCollapse(bestAtNode[n], t, key)) return;
+		for (const int* it=ring.begin(n); it!=ring.end(n); ++it) {
+			if (betterCollapse(bestAtNode[*it], t, key)) return;
+			for (const int* it2=ring.begin(*it); it2!=ring.end(*it); ++it2)
+				if (betterCollapse(bestAtNode[*it2], t, key)) return;
 		}
 	}
-	if (maxLength > 0) {        
-		
-		while(!pq.empty() && pq.top().first>maxLength2) {
-			// we only want to run through the edge list ONCE
-			// and we want to subdivide the original edges before we subdivide any newer, shorter edges,
-			// so whenever we subdivide, we add the 2 new triangles on the end of the SurfaceTri vector
-			// and mark the original subdivided triangles for deletion.
-			//  when we are done subdividing, we delete the obsolete triangles
-		
-			int triA = pq.top().second;
-			pq.pop();
-
-			if(taintedTris.find(triA)!=taintedTris.end())
-				continue;
-
-			// first we find the maximum length edge in this triangle
-			Vec3 e0 = mesh.getEdge(triA,0), e1 = mesh.getEdge(triA,1), e2 = mesh.getEdge(triA,2);
-			Real d0 = normSquare(e0);
-			Real d1 = normSquare(e1);
-			Real d2 = normSquare(e2);
-
-			Vec3 edgevect;
-			Vec3 endpoint;
-			int which;
-			if(d0>d1) {
-				if(d0>d2) {
-					edgevect = e0;
-					endpoint = mesh.getNode(triA, 0);;
-					which = 2;  // 2 opposite of edge 0-1
-				} else {
-					edgevect = e2;
-					endpoint = mesh.getNode(triA, 2);
-					which = 1;  // 1 opposite of edge 2-0
-				}
-			} else {
-				if(d1>d2) {
-					edgevect = e1;
-					endpoint = mesh.getNode(triA, 1);
-					which = 0;  // 0 opposite of edge 1-2
-				} else {
-					edgevect = e2;
-					endpoint = mesh.getNode(triA, 2);
-					which = 1;  // 1 opposite of edge 2-0
-				}
-			}
-			// This edge is too long, so we split it in the middle
-
-			//         *
-			//        / \.
-			//       /C0 \.
-			//      /     \.
-			//     /       \.
-			//    /    B    \.
-			//   /           \.
-			//  /C1        C2 \.
-			// *---------------*
-			//  \C2        C1 /
-			//   \           /
-			//    \    A    /
-			//     \       /
-			//      \     /
-			//       \C0 /
-			//        \ /
-			//         *
-			//
-			//      BECOMES
-			//
-			//         *
-			//        /|\.
-			//       / | \.
-			//      /C0|C0\.
-			//     /   |   \.
-			//    / B1 | B2 \.
-			//   /     |     \.
-			//  /C1  C2|C1 C2 \.
-			// *-------*-------*
-			//  \C2  C1|C2  C1/
-			//   \     |     /
-			//    \ A2 | A1 /
-			//     \   |   /
-			//      \C0|C0/
-			//       \ | /
-			//        \|/
-			//         *
+	selected[idx] = true;
+}
+
+KERNEL(pts)
+void knApplyCollapses(const vector<int>& collapses, Mesh& mesh, const int criterion, const Real threshold, 
+					  vector<char>& deletedNodes, vector<char>& taintedTris) {
+	const int t = collapses[idx];
+	int which;
+	Vec3 edgevect, endpoint;
+	Real key;
+	collapseCandidate(mesh, t, criterion, threshold, which, edgevect, endpoint, key);
+	CollapseSimpleEdge(mesh, t, which, edgevect, endpoint, deletedNodes, taintedTris);
+}
+
+//! collapse all edges matching the criterion: plain collapses in parallel rounds of independent edges,
+//! the remaining cases (tets, tubes, open edges) with a serial sweep
+static void collapseEdges(Mesh& mesh, const int criterion, const Real threshold, vector<char>& deletedNodes, 
+						  vector<char>& taintedTris, int& numCollapses, bool cutTubes) 
+{
+	const int numTris = mesh.numTris(), numNodes = mesh.numNodes();
+	vector<int> cand(numTris, -1), bestAtNode(numNodes, -1), active(numTris);
+	vector<char> simple(numTris, false), queued(numTris, false);
+	vector<Real> key(numTris);
+	for (int t=0; t<numTris; t++) 
+		active[t] = t;
 	
-			int triB = -1; bool haveB = false;
-			Corner ca_old[3],cb_old[3];
-			ca_old[0] = mesh.corners(triA, which);
-			ca_old[1] = mesh.corners(ca_old[0].next);
-			ca_old[2] = mesh.corners(ca_old[0].prev);
-			if (ca_old[0].opposite>=0) {
-				cb_old[0] = mesh.corners(ca_old[0].opposite);
-				cb_old[1] = mesh.corners(cb_old[0].next);
-				cb_old[2] = mesh.corners(cb_old[0].prev);
-				triB = cb_old[0].tri;
-				haveB = true;
-			} 
-			//else throw Error("nonmanifold");
-			
-			// subdivide in the middle of the edge and create new triangles
-			Node newNode;
-			newNode.flags = 0;
-			
-			newNode.pos = endpoint + 0.5*edgevect; // fallback: linear average            
-			// default: use butterfly
-			if (haveB)
-				newNode.pos = ModifiedButterflySubdivision(mesh, ca_old[0], cb_old[0], newNode.pos);
-
-			// find indices of two points of 'which'-edge
-			// merge flags
-			int P0 = ca_old[1].node;
-			int P1 = ca_old[2].node;
-			newNode.flags = mesh.nodes(P0).flags | mesh.nodes(P1).flags;
-			
-			Real len0 = norm(mesh.nodes(P0).pos - newNode.pos);
-			Real len1 = norm(mesh.nodes(P1).pos - newNode.pos);
-			
-			// remove P0/P1 1-ring connection
-			mesh.get1Ring(P0).nodes.erase(P1);
-			mesh.get1Ring(P1).nodes.erase(P0);
-			mesh.get1Ring(P0).tris.erase(triA);
-			mesh.get1Ring(P1).tris.erase(triA);
-			mesh.get1Ring(ca_old[0].node).tris.erase(triA);
-			if (haveB) {
-				mesh.get1Ring(P0).tris.erase(triB);
-				mesh.get1Ring(P1).tris.erase(triB);
-				mesh.get1Ring(cb_old[0].node).tris.erase(triB);
-			}
-			
-			// init channel properties for new node
-			for(int i=0; i<mesh.numNodeChannels(); i++) {
-				mesh.nodeChannel(i)->addInterpol(P0, P1, len0/(len0+len1));
-			}
-			
-			// write to array
-			mesh.addTri(Triangle(ca_old[0].node, ca_old[1].node, mesh.numNodes()));
-			mesh.addTri(Triangle(ca_old[0].node, mesh.numNodes(), ca_old[2].node));
-			if (haveB) {
-				mesh.addTri(Triangle(cb_old[0].node, cb_old[1].node, mesh.numNodes()));
-				mesh.addTri(Triangle(cb_old[0].node, mesh.numNodes(), cb_old[2].node));
-			}
-			mesh.addNode(newNode);
-			
-			const int nt = haveB ? 4 : 2;
-			int triA1 = mesh.numTris()-nt;
-			int triA2 = mesh.numTris()-nt+1;            
-			int triB1=0, triB2=0;
-			if (haveB) {
-				triB1 = mesh.numTris()-nt+2;
-				triB2 = mesh.numTris()-nt+3;
+	for (int round=0; round<MaxCollapseRounds && !active.empty(); round++) {
+		knCollapseCandidates(active, cand, simple, key, mesh, taintedTris, criterion, threshold);
+		vector<int> candTris;
+		for (size_t i=0; i<active.size(); i++) {
+			const int t = active[i];
+			if (cand[t] < 0 || !simple[t]) continue;
+			candTris.push_back(t);
+			for (int e=1; e<3; e++) {
+				const int n = mesh.tris(t).c[(cand[t]+e)%3];
+				if (betterCollapse(t, bestAtNode[n], key)) 
+					bestAtNode[n] = t;
 			}
-			mesh.tris(triA1).flags = mesh.tris(triA).flags;
-			mesh.tris(triA2).flags = mesh.tris(triA).flags;
-			mesh.tris(triB1).flags = mesh.tris(triB).flags;
-			mesh.tris(triB2).flags = mesh.tris(triB).flags;
-			
-			// connect new triangles to outside triangles,
-			// and connect outside triangles to these new ones
-			for (int c=0; c<3; c++) mesh.addCorner(Corner(triA1,mesh.tris(triA1).c[c]));
-			for (int c=0; c<3; c++) mesh.addCorner(Corner(triA2,mesh.tris(triA2).c[c]));
-			if (haveB) {
-				for (int c=0; c<3; c++) mesh.addCorner(Corner(triB1,mesh.tris(triB1).c[c]));
-				for (int c=0; c<3; c++) mesh.addCorner(Corner(triB2,mesh.tris(triB2).c[c]));            
-			}
-			
-			int baseIdx = 3*(mesh.numTris()-nt);
-			Corner* cBase = &mesh.corners(baseIdx);
-			
-			// set next/prev
-			for (int t=0; t<nt; t++)
-				for (int c=0; c<3; c++) {
-					cBase[t*3+c].next = baseIdx+t*3+((c+1)%3);
-					cBase[t*3+c].prev = baseIdx+t*3+((c+2)%3);                        
-				}
-				
-			// set opposites
-			// A1
-			cBase[0].opposite = haveB ? (baseIdx+9) : -1;
-			cBase[1].opposite = baseIdx+5;
-			cBase[2].opposite = -1;
-			if (ca_old[2].opposite>=0) {
-				cBase[2].opposite = ca_old[2].opposite;
-				mesh.corners(cBase[2].opposite).opposite = baseIdx+2;
+		}
+		vector<char> selected(candTris.size());
+		knSelectCollapses(candTris, selected, mesh, cand, bestAtNode, key);
+		
+		vector<int> collapses, movedNodes;
+		for (size_t i=0; i<candTris.size(); i++) {
+			const int t = candTris[i];
+			for (int e=1; e<3; e++) 
+				bestAtNode[mesh.tris(t).c[(cand[t]+e)%3]] = -1;
+			if (selected[i]) {
+				collapses.push_back(t);
+				movedNodes.push_back(mesh.tris(t).c[(cand[t]+2)%3]);
+				// the merged rings then grow in place, the collapses can run in parallel
+				mesh.reserveMerge(mesh.tris(t).c[(cand[t]+2)%3], mesh.tris(t).c[(cand[t]+1)%3]);
 			}
-			// A2
-			cBase[3].opposite = haveB ? (baseIdx+6) : -1;
-			cBase[4].opposite = -1;
-			if (ca_old[1].opposite>=0) {
-				cBase[4].opposite = ca_old[1].opposite;
-				mesh.corners(cBase[4].opposite).opposite = baseIdx+4;
+		}
+		if (collapses.empty()) break;
+		knApplyCollapses(collapses, mesh, criterion, threshold, deletedNodes, taintedTris);
+		numCollapses += collapses.size();
+		
+		// only the remaining candidates and the triangles around the moved nodes can be candidates next round
+		vector<int> next;
+		for (size_t i=0; i<active.size(); i++) {
+			const int t = active[i];
+			if (cand[t] >= 0 && !taintedTris[t] && !queued[t]) {
+				queued[t] = true;
+				next.push_back(t);
 			}
-			cBase[5].opposite = baseIdx+1;
-			if (haveB) {
-				// B1
-				cBase[6].opposite = baseIdx+3;
-				cBase[7].opposite = baseIdx+11;
-				cBase[8].opposite = -1;
-				if (cb_old[2].opposite>=0) {
-					cBase[8].opposite = cb_old[2].opposite;
-					mesh.corners(cBase[8].opposite).opposite = baseIdx+8;
-				}
-				// B2
-				cBase[9].opposite = baseIdx+0;
-				cBase[10].opposite = -1;
-				if (cb_old[1].opposite>=0) {
-					cBase[10].opposite = cb_old[1].opposite;
-					mesh.corners(cBase[10].opposite).opposite = baseIdx+10;
+		}
+		const CompactLists& ringt = mesh.get1RingLookup().tris;
+		for (size_t i=0; i<movedNodes.size(); i++) {
+			const int n = movedNodes[i];
+			for (const int* it=ringt.begin(n); it!=ringt.end(n); ++it) {
+				if (!taintedTris[*it] && !queued[*it]) {
+					queued[*it] = true;
+					next.push_back(*it);
 				}
-				cBase[11].opposite = baseIdx+7;
 			}
-			
-			////////////////////
-			// mark the two original triangles for deletion
-			taintedTris[triA] = true;
-			mesh.removeTriFromLookup(triA);
-			if (haveB) {
-				taintedTris[triB] = true;
-				mesh.removeTriFromLookup(triB);
-			}
-			
-			Real areaA1 = mesh.getFaceArea(triA1), areaA2 = mesh.getFaceArea(triA2);
-			Real areaB1=0, areaB2=0;
-			if (haveB) {
-				areaB1 = mesh.getFaceArea(triB1);
-				areaB2 = mesh.getFaceArea(triB2);                
-			}
-			
-			// add channel props for new triangles
-			for(int i=0; i<mesh.numTriChannels(); i++) {                
-				mesh.triChannel(i)->addSplit(triA, areaA1/(areaA1+areaA2));
-				mesh.triChannel(i)->addSplit(triA, areaA2/(areaA1+areaA2));
-				if (haveB) {
-					mesh.triChannel(i)->addSplit(triB, areaB1/(areaB1+areaB2));
-					mesh.triChannel(i)->addSplit(triB, areaB2/(areaB1+areaB2));
+		}
+		for (size_t i=0; i<next.size(); i++) 
+			queued[next[i]] = false;
+		active.swap(next);
+	}
+	
+	for (int t=0; t<mesh.numTris(); t++) {
+		// if this triangle has already been deleted, ignore it
+		if (taintedTris[t]) continue;
+		int which;
+		Vec3 edgevect, endpoint;
+		Real key;
+		if (collapseCandidate(mesh, t, criterion, threshold, which, edgevect, endpoint, key))
+			CollapseEdge(mesh, t, which, edgevect, endpoint, deletedNodes, taintedTris, numCollapses, cutTubes);
+	}
+}
+
+//! longest edge of the given triangles if it is longer than maxLength, as corner opposite to it, -1 otherwise
+KERNEL(pts)
+void knSplitCandidates(const vector<int>& tris, vector<int>& cand, Mesh& mesh, const Real maxLength2) {
+	const int t = tris[idx];
+	Real d0 = normSquare(mesh.getEdge(t,0));
+	Real d1 = normSquare(mesh.getEdge(t,1));
+	Real d2 = normSquare(mesh.getEdge(t,2));
+	int which;
+	if(d0>d1) 
+		which = (d0>d2) ? 2 : 1; // 2 opposite of edge 0-1, 1 opposite of edge 2-0
+	else      
+		which = (d1>d2) ? 0 : 1; // 0 opposite of edge 1-2
+	cand[t] = (max(d0,max(d1,d2)) > maxLength2) ? which : -1;
+}
+
+//! edge ea of length la is split before eb, ties are broken by the edge id
+static inline bool betterSplit(const Real la, const int ea, const Real lb, const int eb) {
+	if (ea < 0) return false;
+	if (eb < 0) return true;
+	return la > lb || (la == lb && ea < eb);
+}
+
+//! longest edge of a triangle claimed by it or its neighbor, edges are identified by their lower corner
+KERNEL(pts)
+void knBestSplit(const vector<int>& tris, vector<int>& best, vector<Real>& bestLen, Mesh& mesh, const vector<int>& cand) {
+	const int t = tris[idx];
+	int b = -1;
+	Real bl = 0;
+	for (int c=0; c<3; c++) {
+		const int e = 3*t+c;
+		const Corner& cr = mesh.corners(e);
+		const int o = cr.opposite;
+		if (cand[t] != c && (o < 0 || cand[o/3] != o%3)) continue;
+		const int id = (o >= 0 && o < e) ? o : e;
+		const Real l = normSquare(mesh.nodes(mesh.corners(cr.next).node).pos - mesh.nodes(mesh.corners(cr.prev).node).pos);
+		if (betterSplit(l, id, bl, b)) {
+			b = id;
+			bl = l;
+		}
+	}
+	best[t] = b;
+	bestLen[t] = bl;
+}
+
+//! best split of a triangle and its edge neighbors
+KERNEL(pts)
+void knBestSplitAround(const vector<int>& tris, vector<int>& best2, Mesh& mesh, const vector<int>& best, const vector<Real>& bestLen) {
+	const int t = tris[idx];
+	int b = best[t];
+	Real bl = bestLen[t];
+	for (int c=0; c<3; c++) {
+		const int o = mesh.corners(t,c).opposite;
+		if (o < 0) continue;
+		if (betterSplit(bestLen[o/3], best[o/3], bl, b)) {
+			b = best[o/3];
+			bl = bestLen[o/3];
+		}
+	}
+	best2[t] = b;
+}
+
+//! an edge is split if it is the best one around both of its triangles, the two triangles of
+//! a split are then never adjacent to the triangles of another split. Returns the edge at its lower corner
+KERNEL(pts)
+void knSelectSplits(const vector<int>& tris, vector<int>& split, Mesh& mesh, const vector<int>& best2) {
+	const int t = tris[idx];
+	split[idx] = -1;
+	const int e = best2[t];
+	if (e < 0 || e/3 != t) return;
+	const Corner& ca = mesh.corners(e);
+	if (ca.opposite >= 0) {
+		const int triB = ca.opposite/3;
+		if (best2[triB] != e || triB == t) return;
+		// skip degenerate pairs sharing more than one edge
+		const Corner& cb = mesh.corners(ca.opposite);
+		if (mesh.corners(ca.next).opposite/3 == triB || mesh.corners(ca.prev).opposite/3 == triB || 
+			mesh.corners(cb.next).opposite/3 == t    || mesh.corners(cb.prev).opposite/3 == t)
+			return;
+	}
+	split[idx] = e;
+}
+
+//! new node position from the butterfly stencil, and its interpolation weight along the edge
+KERNEL(pts)
+void knSplitPositions(const vector<int>& splits, Mesh& mesh, vector<Vec3>& pos, vector<Real>& alpha) {
+	const Corner& ca = mesh.corners(splits[idx]);
+	const Vec3 p0 = mesh.nodes(mesh.corners(ca.next).node).pos;
+	const Vec3 p1 = mesh.nodes(mesh.corners(ca.prev).node).pos;
+	
+	pos[idx] = 0.5*(p0+p1); // fallback: linear average
+	// default: use butterfly
+	if (ca.opposite >= 0)
+		pos[idx] = ModifiedButterflySubdivision(mesh, ca, mesh.corners(ca.opposite), pos[idx]);
+	
+	const Real len0 = norm(p0 - pos[idx]), len1 = norm(p1 - pos[idx]);
+	alpha[idx] = len0/(len0+len1);
+}
+
+static inline void setupCorners(Mesh& mesh, const int t) {
+	for (int c=0; c<3; c++) {
+		Corner& cr = mesh.corners(t,c);
+		cr.tri = t;
+		cr.node = mesh.tris(t).c[c];
+		cr.next = 3*t+((c+1)%3);
+		cr.prev = 3*t+((c+2)%3);
+	}
+}
+
+// This edge is too long, so we split it in the middle
+//
+//         *
+//        / \.
+//       /C0 \.
+//      /     \.
+//     /       \.
+//    /    B    \.
+//   /           \.
+//  /C1        C2 \.
+// *---------------*
+//  \C2        C1 /
+//   \           /
+//    \    A    /
+//     \       /
+//      \     /
+//       \C0 /
+//        \ /
+//         *
+//
+//      BECOMES
+//
+//         *
+//        /|\.
+//       / | \.
+//      /C0|C0\.
+//     /   |   \.
+//    / B1 | B2 \.
+//   /     |     \.
+//  /C1  C2|C1 C2 \.
+// *-------*-------*
+//  \C2  C1|C2  C1/
+//   \     |     /
+//    \ A2 | A1 /
+//     \   |   /
+//      \C0|C0/
+//       \ | /
+//        \|/
+//         *
+//
+// A1 and B1 replace A and B, A2 and B2 are appended at newTri, newTri+1
+KERNEL(pts)
+void knApplySplits(const vector<int>& splits, const vector<int>& newTri, const int firstNode, Mesh& mesh) {
+	Corner ca[3], cb[3];
+	ca[0] = mesh.corners(splits[idx]);
+	ca[1] = mesh.corners(ca[0].next);
+	ca[2] = mesh.corners(ca[0].prev);
+	const bool haveB = ca[0].opposite >= 0;
+	if (haveB) {
+		cb[0] = mesh.corners(ca[0].opposite);
+		cb[1] = mesh.corners(cb[0].next);
+		cb[2] = mesh.corners(cb[0].prev);
+	}
+	const int node = firstNode + idx;
+	const int triA1 = ca[0].tri, triA2 = newTri[idx];
+	const int triB1 = haveB ? cb[0].tri : -1, triB2 = triA2+1;
+	
+	const int flagsA = mesh.tris(triA1).flags;
+	mesh.tris(triA1) = Triangle(ca[0].node, ca[1].node, node);
+	mesh.tris(triA2) = Triangle(ca[0].node, node, ca[2].node);
+	mesh.tris(triA1).flags = mesh.tris(triA2).flags = flagsA;
+	setupCorners(mesh, triA1);
+	setupCorners(mesh, triA2);
+	mesh.corners(triA1,0).opposite = haveB ? 3*triB2 : -1;
+	mesh.corners(triA1,1).opposite = 3*triA2+2;
+	mesh.corners(triA1,2).opposite = ca[2].opposite;
+	mesh.corners(triA2,0).opposite = haveB ? 3*triB1 : -1;
+	mesh.corners(triA2,1).opposite = ca[1].opposite;
+	mesh.corners(triA2,2).opposite = 3*triA1+1;
+	if (ca[2].opposite >= 0) mesh.corners(ca[2].opposite).opposite = 3*triA1+2;
+	if (ca[1].opposite >= 0) mesh.corners(ca[1].opposite).opposite = 3*triA2+1;
+	if (!haveB) return;
+	
+	const int flagsB = mesh.tris(triB1).flags;
+	mesh.tris(triB1) = Triangle(cb[0].node, cb[1].node, node);
+	mesh.tris(triB2) = Triangle(cb[0].node, node, cb[2].node);
+	mesh.tris(triB1).flags = mesh.tris(triB2).flags = flagsB;
+	setupCorners(mesh, triB1);
+	setupCorners(mesh, triB2);
+	mesh.corners(triB1,0).opposite = 3*triA2;
+	mesh.corners(triB1,1).opposite = 3*triB2+2;
+	mesh.corners(triB1,2).opposite = cb[2].opposite;
+	mesh.corners(triB2,0).opposite = 3*triA1;
+	mesh.corners(triB2,1).opposite = cb[1].opposite;
+	mesh.corners(triB2,2).opposite = 3*triB1+1;
+	if (cb[2].opposite >= 0) mesh.corners(cb[2].opposite).opposite = 3*triB1+2;
+	if (cb[1].opposite >= 0) mesh.corners(cb[1].opposite).opposite = 3*triB2+1;
+}
+
+//! split the longest edge of triangles with an edge longer than maxLength, in parallel rounds of independent edges.
+//! Split and new triangles are re-queued until no edge is longer than maxLength.
+//! Needs a corner table without deleted triangles, returns the number of splits
+static int splitEdges(Mesh& mesh, const Real maxLength) {
+	const Real maxLength2 = maxLength*maxLength;
+	int numSplits = 0;
+	
+	vector<int> cand(mesh.numTris(), -1), best(mesh.numTris(), -1), best2(mesh.numTris(), -1);
+	vector<Real> bestLen(mesh.numTris(), 0);
+	vector<char> mark(mesh.numTris(), false);
+	vector<int> modified(mesh.numTris()), candTris;
+	for (int t=0; t<mesh.numTris(); t++) 
+		modified[t] = t;
+	knSplitCandidates(modified, cand, mesh, maxLength2);
+	for (int t=0; t<mesh.numTris(); t++) 
+		if (cand[t] >= 0) candTris.push_back(t);
+	
+	for (;;) {
+		const int numTris = mesh.numTris();
+		
+		// candidates and their neighbors, the only triangles with a claimed edge
+		vector<int> region;
+		for (size_t i=0; i<candTris.size(); i++) {
+			const int t = candTris[i];
+			for (int c=-1; c<3; c++) {
+				const int n = (c<0) ? t : mesh.corners(t,c).opposite/3;
+				if (n >= 0 && !mark[n]) {
+					mark[n] = true;
+					region.push_back(n);
 				}
 			}
-			
-			// add the four new triangles to the prority queue
-			for(int i=mesh.numTris()-nt; i<mesh.numTris(); i++) {
-				// find the maximum length edge in this triangle
-				Vec3 ne0 = mesh.getEdge(i, 0), ne1 = mesh.getEdge(i, 1), ne2 = mesh.getEdge(i, 2);                
-				Real nd0 = normSquare(ne0);
-				Real nd1 = normSquare(ne1);
-				Real nd2 = normSquare(ne2);
-				Real longest = max(nd0,max(nd1,nd2));
-				//longest = (int)(longest * 1e2) / 1e2; // HACK: truncate
-				pq.push(pair<Real,int>(longest,i));                
+		}
+		for (size_t i=0; i<region.size(); i++) 
+			mark[region[i]] = false;
+		
+		vector<int> split(region.size());
+		knBestSplit(region, best, bestLen, mesh, cand);
+		knBestSplitAround(region, best2, mesh, best, bestLen);
+		knSelectSplits(region, split, mesh, best2);
+		
+		// new triangles are appended in the order of the split edges
+		vector<int> splits;
+		for (size_t i=0; i<region.size(); i++) {
+			best[region[i]] = -1;
+			if (split[i] >= 0) 
+				splits.push_back(split[i]);
+		}
+		if (splits.empty()) break;
+		sort(splits.begin(), splits.end());
+		
+		const int num = splits.size(), firstNode = mesh.numNodes();
+		vector<int> newTri(num), triB(num);
+		int nt = numTris;
+		modified.clear();
+		for (int s=0; s<num; s++) {
+			const int o = mesh.corners(splits[s]).opposite;
+			newTri[s] = nt;
+			triB[s] = (o >= 0) ? o/3 : -1;
+			nt += (o >= 0) ? 2 : 1;
+			modified.push_back(splits[s]/3);
+			if (o >= 0) modified.push_back(o/3);
+		}
+		for (int t=numTris; t<nt; t++) 
+			modified.push_back(t);
+		
+		vector<Vec3> pos(num);
+		vector<Real> alpha(num);
+		knSplitPositions(splits, mesh, pos, alpha);
+		
+		// append nodes, channel properties are interpolated in one pass per channel
+		vector<int> from0(num), from1(num);
+		for (int s=0; s<num; s++) {
+			const Corner& ca = mesh.corners(splits[s]);
+			from0[s] = mesh.corners(ca.next).node;
+			from1[s] = mesh.corners(ca.prev).node;
+			Node newNode(pos[s]);
+			newNode.flags = mesh.nodes(from0[s]).flags | mesh.nodes(from1[s]).flags;
+			mesh.getNodeData().push_back(newNode);
+		}
+		mesh.appendNodeChannels(from0, from1, alpha);
+		mesh.getTriData().resize(nt);
+		mesh.getCornerData().resize(3*nt);
+		knApplySplits(splits, newTri, firstNode, mesh);
+		
+		// channel props for the new triangles, in order of their index
+		if (mesh.numTriChannels() > 0) {
+			vector<int> fromTri;
+			vector<Real> areaRatio;
+			for (int s=0; s<num; s++) {
+				const int triA = splits[s]/3;
+				Real areaA1 = mesh.getFaceArea(triA), areaA2 = mesh.getFaceArea(newTri[s]);
+				fromTri.push_back(triA);
+				areaRatio.push_back(areaA2/(areaA1+areaA2));
+				if (triB[s] < 0) continue;
+				Real areaB1 = mesh.getFaceArea(triB[s]), areaB2 = mesh.getFaceArea(newTri[s]+1);
+				fromTri.push_back(triB[s]);
+				areaRatio.push_back(areaB2/(areaB1+areaB2));
 			}
-			edgeSubdivs++;            
+			mesh.appendTriChannels(fromTri, areaRatio);
+		}
+		
+		// existing nodes never move, so only split and new triangles change their candidate edge
+		cand.resize(nt, -1);
+		best.resize(nt, -1);
+		best2.resize(nt, -1);
+		bestLen.resize(nt, 0);
+		mark.resize(nt, false);
+		for (size_t i=0; i<modified.size(); i++) {
+			cand[modified[i]] = -1;
+			mark[modified[i]] = true;
+		}
+		knSplitCandidates(modified, cand, mesh, maxLength2);
+		vector<int> remaining;
+		for (size_t i=0; i<candTris.size(); i++) 
+			if (!mark[candTris[i]] && cand[candTris[i]] >= 0) remaining.push_back(candTris[i]);
+		for (size_t i=0; i<modified.size(); i++) {
+			mark[modified[i]] = false;
+			if (cand[modified[i]] >= 0) remaining.push_back(modified[i]);
 		}
+		candTris.swap(remaining);
+		numSplits += num;
 	}
+	if (numSplits > 0) 
+		mesh.rebuildLookup();
+	return numSplits;
+}
+
+//! Subdivide and edgecollapse to guarantee mesh with edgelengths between
+//! min/maxLength and an angle below minAngle
+PYTHON() void subdivideMesh(Mesh& mesh, Real minAngle, Real minLength, Real maxLength, bool cutTubes = false) {
+	// gather some statistics
+	int edgeSubdivs = 0, edgeCollsAngle = 0, edgeCollsLen = 0, edgeKill = 0;
+	mesh.rebuildQuickCheck(); 
+
+	vector<char> deletedNodes(mesh.numNodes(), false);
+	vector<char> taintedTris(mesh.numTris(), false);
+	
+	//////////////////////////////////////////
+	// EDGE COLLAPSE                        //
+	//    - particles marked for deletation //
+	//////////////////////////////////////////
+	collapseEdges(mesh, CollapseKill, 0., deletedNodes, taintedTris, edgeKill, cutTubes);
 	
 	//////////////////////////////////////////
 	// EDGE COLLAPSING                      //
-	//      - based on short edge length    //
+	//      - based on small triangle angle //
 	//////////////////////////////////////////
-	if (minLength > 0) {
-		const Real minLength2 = minLength*minLength;
-		for(int t=0; t<mesh.numTris(); t++) {
-			// we only want to run through the edge list ONCE.
-			// we achieve this in a method very similar to the above subdivision method.
-
-			// NOTE:
-			// priority queue does not work so great in the edge collapse case,
-			// because collapsing one triangle affects the edge lengths 
-			// of many neighbor triangles,
-			// and we do not update their maximum edge length in the queue.
-
-			// if this triangle has already been deleted, ignore it
-			//if(taintedTris[t])
-			//  continue;
-
-			if(taintedTris.find(t)!=taintedTris.end())
-				continue;
-			
-			// first we find the minimum length edge in this triangle
-			Vec3 e0 = mesh.getEdge(t,0), e1 = mesh.getEdge(t,1), e2 = mesh.getEdge(t,2);
-			Real d0 = normSquare(e0);
-			Real d1 = normSquare(e1);
-			Real d2 = normSquare(e2);
-
-			Vec3 edgevect;
-			Vec3 endpoint;
-			Real dist2;
-			int which;
-			if(d0<d1) {
-				if(d0<d2) {
-					dist2 = d0;
-					edgevect = e0;
-					endpoint = mesh.getNode(t,0);
-					which = 2;  // 2 opposite of edge 0-1
-				} else {
-					dist2 = d2;
-					edgevect = e2;
-					endpoint =  mesh.getNode(t,2);
-					which = 1;  // 1 opposite of edge 2-0
-				}
-			} else {
-				if(d1<d2) {
-					dist2 = d1;
-					edgevect = e1;
-					endpoint =  mesh.getNode(t,1);
-					which = 0;  // 0 opposite of edge 1-2
-				} else {
-					dist2 = d2;
-					edgevect = e2;
-					endpoint =  mesh.getNode(t,2);
-					which = 1;  // 1 opposite of edge 2-0
-				}
-			}
-			// then we see if the min length edge is too short
-			if(dist2<minLength2) {
-				CollapseEdge(mesh, t,which,edgevect,endpoint, deletedNodes,taintedTris, edgeCollsLen, cutTubes);
-			}
-		}
+	if (minAngle > 0) 
+		collapseEdges(mesh, CollapseAngle, minAngle, deletedNodes, taintedTris, edgeCollsAngle, cutTubes);
+	
+	//////////////////////
+	// EDGE SUBDIVISION //
+	//////////////////////
+	if (maxLength > 0) {
+		// splitting works on the corner table, so remove the collapsed elements first
+		mesh.compact(taintedTris, deletedNodes);
+		edgeSubdivs = splitEdges(mesh, maxLength);
+		deletedNodes.assign(mesh.numNodes(), false);
+		taintedTris.assign(mesh.numTris(), false);
 	}
-	// cleanup nodes and triangles marked for deletion
 	
-	//  we run backwards through the deleted array, 
-	//  replacing triangles with ones from the back
-	//          (this avoids the potential problem of overwriting a triangle
-	//              with a to-be-deleted triangle)    
-	std::map<int,bool>::reverse_iterator tti = taintedTris.rbegin();
-	for(;tti!=taintedTris.rend(); tti++)
-		mesh.removeTri(tti->first);
+	//////////////////////////////////////////
+	// EDGE COLLAPSING                      //
+	//      - based on short edge length    //
+	//////////////////////////////////////////
+	if (minLength > 0) 
+		collapseEdges(mesh, CollapseLength, minLength*minLength, deletedNodes, taintedTris, edgeCollsLen, cutTubes);
 	
-	mesh.removeNodes(deletedNodes);
+	// cleanup nodes and triangles marked for deletion
+	mesh.compact(taintedTris, deletedNodes);
 	cout << "Surface subdivision finished with " << mesh.numNodes() << " surface nodes and " << mesh.numTris();
 	cout << " surface triangles, edgeSubdivs:" << edgeSubdivs << ", edgeCollapses: " << edgeCollsLen;
 	cout << " + " << edgeCollsAngle << " + " << edgeKill << endl;
 	//mesh.sanityCheck();
-	
 }
 	
+KERNEL(pts)
+void knFlagSmallComponents(vector<char>& deletedTris, const MeshComponents& comps, const int elements) {
+	deletedTris[idx] = comps.size[comps.label[idx]] < elements;
+}
+
+KERNEL(pts, reduce=+) returns(int cnt=0)
+int knCountFlags(const vector<char>& flags) {
+	if (flags[idx]) cnt++;
+}
+
 PYTHON() void killSmallComponents(Mesh& mesh, int elements = 10) {
-	const int num = mesh.numTris();
-	vector<int> comp(num);
-	vector<int> numEl;
-	vector<int> deletedNodes;
-	vector<bool> isNodeDel(mesh.numNodes());
-	map<int,bool> taintedTris;
-	// enumerate components
-	int cur=0;
-	for (int i=0; i<num; i++) {
-		if (comp[i]==0) {
-			cur++;
-			comp[i] = cur;
-			
-			stack<int> stack;
-			stack.push(i);
-			int cnt = 1;
-			while(!stack.empty()) {
-				int tri = stack.top();
-				stack.pop();
-				for (int c=0; c<3; c++) {
-					int op = mesh.corners(tri,c).opposite;
-					if (op < 0) continue;
-					int ntri = mesh.corners(op).tri;
-					if (comp[ntri]==0) {
-						comp[ntri] = cur;
-						stack.push(ntri);
-						cnt++;
-					}
-				}
-			}
-			numEl.push_back(cnt);
-		}
-	}
+	MeshComponents comps;
+	mesh.computeComponents(comps);
+	
 	// kill small components
-	for (int j=0; j<num; j++) {
-		if (numEl[comp[j]-1] < elements) {
-			taintedTris[j] = true;
-			for (int c=0; c<3; c++) {
-				int n=mesh.tris(j).c[c];
-				if (!isNodeDel[n]) {
-					isNodeDel[n] = true;
-					deletedNodes.push_back(n);
-				}
-			}
-		}
+	vector<char> deletedNodes(mesh.numNodes(), false);
+	vector<char> deletedTris(mesh.numTris(), false);
+	knFlagSmallComponents(deletedTris, comps, elements);
+	const int numDelTris = knCountFlags(deletedTris);
+	if (numDelTris == 0) return;
+	for (int t=0; t<mesh.numTris(); t++) {
+		if (!deletedTris[t]) continue;
+		for (int c=0; c<3; c++)
+			deletedNodes[mesh.tris(t).c[c]] = true;
 	}
+	const int numDelNodes = knCountFlags(deletedNodes);
 	
-	std::map<int,bool>::reverse_iterator tti = taintedTris.rbegin();
-	for(;tti!=taintedTris.rend(); tti++)
-		mesh.removeTri(tti->first);
-	
-	mesh.removeNodes(deletedNodes);
-	
-	if (!taintedTris.empty())
-		cout << "Killed small components : " << deletedNodes.size() << " nodes, " << taintedTris.size() << " tris deleted." << endl;
+	mesh.compact(deletedTris, deletedNodes);
+	cout << "Killed small components : " << numDelNodes << " nodes, " << numDelTris << " tris deleted." << endl;
 }
    
 	
@@ -24,7 +24,8 @@ namespace Manta {
 // - MGDynamic: Multigrid preconditioner, rebuilt for each solve
 // - MGStatic: Multigrid preconditioner, built only once (faster than
 //       MGDynamic, but works only if Poisson equation does not change)
-enum Preconditioner { PcNone = 0, PcMIC = 1, PcMGDynamic = 2, PcMGStatic = 3 };
+// - Schwarz: Additive Schwarz on overlapping slabs, with mIC as local solver
+enum Preconditioner { PcNone = 0, PcMIC = 1, PcMGDynamic = 2, PcMGStatic = 3, PcSchwarz = 4 };
 
 //! Kernel: Construct the right-hand side of the poisson equation
 KERNEL(bnd=1, reduce=+) returns(int cnt=0) returns(double sum=0)
@@ -235,6 +236,7 @@ PYTHON() void releaseMG() {
 //! useL2Norm: use max norm by default, can be turned to L2 here
 //! zeroPressureFixing: remove null space by fixing a single pressure value, needed for MG 
 //! retRhs: return RHS divergence, e.g., for debugging; optional
+//! numSubdomains: number of slabs for the Schwarz preconditioner
 PYTHON() void solvePressure(MACGrid& vel, Grid<Real>& pressure, FlagGrid& flags, Real cgAccuracy = 1e-3,
     Grid<Real>* phi = 0, 
     Grid<Real>* perCellCorr = 0, 
@@ -246,7 +248,8 @@ PYTHON() void solvePressure(MACGrid& vel, Grid<Real>& pressure, FlagGrid& flags,
 	bool enforceCompatibility = false,
     bool useL2Norm = false, 
 	bool zeroPressureFixing = false,
-	Grid<Real>* retRhs = NULL )
+	Grid<Real>* retRhs = NULL,
+	int numSubdomains = 4 )
 {
 	if (precondition==false) preconditioner = PcNone; // for backwards compatibility
 
@@ -332,6 +335,7 @@ PYTHON() void solvePressure(MACGrid& vel, Grid<Real>& pressure, FlagGrid& flags,
 	int maxIter = 0;
 	
 	Grid<Real> *pca0 = nullptr, *pca1 = nullptr, *pca2 = nullptr, *pca3 = nullptr;
+	GridSchwarz* schwarz = nullptr;
 
 	// optional preconditioning	
 	if (preconditioner == PcNone || preconditioner == PcMIC) {			
@@ -350,6 +354,12 @@ PYTHON() void solvePressure(MACGrid& vel, Grid<Real>& pressure, FlagGrid& flags,
 		if (!gMG) gMG = new GridMg(pressure.getSize());
 
 		gcg->setMGPreconditioner( GridCgInterface::PC_MGP, gMG);
+	} else if (preconditioner == PcSchwarz) {
+		maxIter = (int)(cgMaxIterFac * flags.getSize().max()) * (flags.is3D() ? 1 : 4);
+
+		schwarz = new GridSchwarz(pressure.getSize(), numSubdomains);
+
+		gcg->setSchwarzPreconditioner( GridCgInterface::PC_SchwarzP, schwarz);
 	}
 
 	// CG solve
@@ -365,6 +375,7 @@ PYTHON() void solvePressure(MACGrid& vel, Grid<Real>& pressure, FlagGrid& flags,
 	if (pca1) delete pca1;
 	if (pca2) delete pca2;
 	if (pca3) delete pca3;
+	if (schwarz) delete schwarz;
 
 	// PcMGDynamic: always delete multigrid solver after use
 	// PcMGStatic: keep multigrid solver for next solve
@@ -27,7 +27,8 @@ namespace Manta
 // - MGDynamic: Multigrid preconditioner, rebuilt for each solve
 // - MGStatic: Multigrid preconditioner, built only once (faster than
 //       MGDynamic, but works only if Poisson equation does not change)
-enum Preconditioner { PcNone = 0, PcMIC = 1, PcMGDynamic = 2, PcMGStatic = 3 };
+// - Schwarz: Additive Schwarz on overlapping slabs, with mIC as local solver
+enum Preconditioner { PcNone = 0, PcMIC = 1, PcMGDynamic = 2, PcMGStatic = 3, PcSchwarz = 4 };
 
 void solvePressure(MACGrid& vel, Grid<Real>& pressure, FlagGrid& flags, Real cgAccuracy = 1e-3,
                     Grid<Real>* phi = 0,
@@ -40,6 +41,7 @@ void solvePressure(MACGrid& vel, Grid<Real>& pressure, FlagGrid& flags, Real cgA
                     bool enforceCompatibility = false,
                     bool useL2Norm = false,
                     bool zeroPressureFixing = false,
-                    Grid<Real>* retRhs = NULL);
+                    Grid<Real>* retRhs = NULL,
+                    int numSubdomains = 4);
 
 } // namespace
@@ -48,5 +48,6 @@ PcNone      = 0
 PcMIC       = 1
 PcMGDynamic = 2
 PcMGStatic  = 3
+PcSchwarz   = 4
 
 
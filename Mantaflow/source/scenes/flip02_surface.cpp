@@ -34,9 +34,13 @@ int main()
     auto resolution = Manta::Vec3i(res);
     if (dimension == 2) resolution.z = 1;
 
+    // velocity transfer, false = FLIP, true = APIC (affine particle-in-cell)
+    bool useApic = false;
+
     auto main_solver = Manta::FluidSolver(resolution, dimension);
     main_solver.setTimeStep(0.5f);
-    Real minParticles = pow(2, dimension);
+    // APIC keeps the liquid lively with half the particles
+    Real minParticles = pow(2, useApic ? dimension - 1 : dimension);
 
     // size of particles
     Real radiusFactor = 1.0f;
@@ -55,6 +59,10 @@ int main()
     auto pp         = Manta::BasicParticleSystem(&main_solver);
     auto pVel       = Manta::PdataVec3(&pp);
     auto pTest      = Manta::PdataReal(&pp);    // test real value, not necessary for simulation
+    // APIC only: affine velocity, gradients of the x, y and z velocity components
+    auto pCx        = Manta::PdataVec3(&pp);
+    auto pCy        = Manta::PdataVec3(&pp);
+    auto pCz        = Manta::PdataVec3(&pp);
     auto mesh       = Manta::Mesh(&main_solver);
 
     // acceleration data for particle nbs
@@ -109,11 +117,12 @@ int main()
 
     for (int t = 0; t < 250; t++)
     {
-        // FLIP
+        // FLIP / APIC
         pp.advectInGrid(flags, vel, Manta::IntegrationMode::IntRK4, false);
 
         // make sure we have velocities throught liquid region
-        Manta::mapPartsToMAC(flags, vel, vel_old, pp, pVel, &tmp_vec3);
+        if (useApic) Manta::apicMapPartsToMAC(flags, vel, pp, pVel, pCx, pCy, pCz, &tmp_vec3);
+        else         Manta::mapPartsToMAC(flags, vel, vel_old, pp, pVel, &tmp_vec3);
         Manta::extrapolateMACFromWeight(vel, tmp_vec3, 2);
         Manta::markFluidCells(pp, flags);
 
@@ -131,14 +140,15 @@ int main()
         Manta::solvePressure(vel, pressure, flags, 1e-3, &phi);
         Manta::setWallBcs(flags, vel);
 
-        // set source grids for resampling, used in adjustNumber!
+        // set source grids for resampling, used in adjustNumber! new particles start without affine velocity
         pVel.setSource(&vel, true);
         pTest.setSource(&tstGrid);
         Manta::adjustNumber(pp, vel, flags, 1 * minParticles, 2 * minParticles, phi, radiusFactor);
 
         // make sure we have proper velocities
         Manta::extrapolateMACSimple(flags, vel);
-        Manta::flipVelocityUpdate(flags, vel, vel_old, pp, pVel, 0.97f);
+        if (useApic) Manta::apicMapMACToParts(vel, pp, pVel, pCx, pCy, pCz);
+        else         Manta::flipVelocityUpdate(flags, vel, vel_old, pp, pVel, 0.97f);
 
         if (dimension == 3) phi.createMesh(mesh);
 
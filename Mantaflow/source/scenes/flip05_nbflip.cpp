@@ -77,6 +77,11 @@ int main()
     auto pindex     = Manta::ParticleIndexSystem(&main_solver);
     auto gpi        = Manta::Grid<int>(&main_solver);
 
+    // cells around the surface, limits the grid work of NB-FLIP to the band
+    // (deep inside, phi is extrapolated to -(narrowBandWidth + 4), outside to +5)
+    auto band       = Manta::LevelsetBand();
+    Manta::LevelsetBand* pBand = narrowBand ? &band : nullptr;
+
     // geometry in world units (to be converted to grid space upon init)
     flags.initDomain();
     phi.initFromFlags(flags);
@@ -114,9 +119,13 @@ int main()
         // advect grid velocity
         if (narrowBand) Manta::advectSemiLagrange(&flags, &vel, &vel, 2);
 
+        // particles are kept within narrowBandWidth of the surface, plus a margin for
+        // the particle radius and the velocity extrapolation
+        if (narrowBand) band.update(phi, narrowBandWidth + 3, 4);
+
         // create level set of particles
         Manta::gridParticleIndex(pp, pindex, flags, gpi);
-        Manta::unionParticleLevelset(pp, pindex, flags, gpi, phiParts, radiusFactor);
+        Manta::unionParticleLevelset(pp, pindex, flags, gpi, phiParts, radiusFactor, pBand);
 
         if (narrowBand)
         {
@@ -138,9 +147,9 @@ int main()
         if (narrowBand)
         {
             // combine particles velocities with advected grid velocities
-            mapPartsToMAC(flags, velParts, velOld, pp, pVel, &mapWeights);
-            extrapolateMACFromWeight(velParts, mapWeights, 2);
-            combineGridVel(velParts, mapWeights, vel, &phi, combineBandWidth);
+            mapPartsToMAC(flags, velParts, velOld, pp, pVel, &mapWeights, pBand);
+            extrapolateMACFromWeight(velParts, mapWeights, 2, pBand);
+            combineGridVel(velParts, mapWeights, vel, &phi, combineBandWidth, 0.0, pBand);
             velOld.copyFrom(vel);
         } else
         {
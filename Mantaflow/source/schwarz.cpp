@@ -0,0 +1,204 @@
+/******************************************************************************
+ *
+ * MantaFlow fluid solver framework
+ * Copyright 2011 Tobias Pfaff, Nils Thuerey
+ *
+ * This program is free software, distributed under the terms of the
+ * GNU General Public License (GPL)
+ * http://www.gnu.org/licenses
+ *
+ * Domain decomposed preconditioner for the pressure solve
+ *
+ ******************************************************************************/
+
+#include "schwarz.h"
+#include "kernel.h"
+
+using namespace std;
+namespace Manta {
+
+//! number of cells per slab plane
+static inline IndexInt schwarzPlaneSize(const GridBase& grid) {
+	return grid.is3D() ? grid.getStrideZ() : grid.getStrideY();
+}
+
+//*****************************************************************************
+// Copy slabs between the global grids and the local buffers
+
+template<class T>
+static void schwarzGather(const Grid<T>& src, const SchwarzSubdomain& sub, T* dst) {
+	const T* p = src.getData() + sub.lo * schwarzPlaneSize(src);
+	std::copy(p, p + sub.numCells(), dst);
+}
+
+static void schwarzScatterAdd(const Real* src, const SchwarzSubdomain& sub, Grid<Real>& dst) {
+	Real* p = dst.getData() + sub.lo * schwarzPlaneSize(dst);
+	const IndexInt n = sub.numCells();
+	for (IndexInt i=0; i<n; i++)
+		p[i] += src[i];
+}
+
+//*****************************************************************************
+// Local solver: modified incomplete Cholesky ala Bridson on the slab,
+// cells outside of the slab are treated as zero (homogeneous Dirichlet)
+
+static void factorLocalMIC(SchwarzSubdomain& s) {
+	const Real tau = 0.97;
+	const Real sigma = 0.25;
+	const IndexInt X = 1, Y = s.size.x, Z = (IndexInt)s.size.x * s.size.y;
+	vector<Real>& P = s.precond;
+
+	for (int k=0; k<s.size.z; k++)
+	for (int j=0; j<s.size.y; j++)
+	for (int i=0; i<s.size.x; i++) {
+		const IndexInt idx = i*X + j*Y + k*Z;
+		if (!s.fluid[idx]) { P[idx] = 0.; continue; }
+
+		Real e = s.A0[idx];
+		if (i>0) {
+			const IndexInt n = idx-X;
+			e -= square(s.Ai[n] * P[n]) + tau * s.Ai[n] * (s.Aj[n] + s.Ak[n]) * square(P[n]);
+		}
+		if (j>0) {
+			const IndexInt n = idx-Y;
+			e -= square(s.Aj[n] * P[n]) + tau * s.Aj[n] * (s.Ai[n] + s.Ak[n]) * square(P[n]);
+		}
+		if (k>0) {
+			const IndexInt n = idx-Z;
+			e -= square(s.Ak[n] * P[n]) + tau * s.Ak[n] * (s.Ai[n] + s.Aj[n]) * square(P[n]);
+		}
+
+		// stability cutoff
+		if (e < sigma * s.A0[idx])
+			e = s.A0[idx];
+		P[idx] = (e > 0.) ? 1. / sqrt(e) : 0.;
+	}
+}
+
+static void applyLocalMIC(SchwarzSubdomain& s) {
+	const IndexInt X = 1, Y = s.size.x, Z = (IndexInt)s.size.x * s.size.y;
+	const vector<Real>& P = s.precond;
+	vector<Real>& x = s.x;
+
+	// forward substitution
+	for (int k=0; k<s.size.z; k++)
+	for (int j=0; j<s.size.y; j++)
+	for (int i=0; i<s.size.x; i++) {
+		const IndexInt idx = i*X + j*Y + k*Z;
+		if (!s.fluid[idx]) { x[idx] = 0.; continue; }
+		Real v = s.rhs[idx];
+		if (i>0) v -= x[idx-X] * s.Ai[idx-X] * P[idx-X];
+		if (j>0) v -= x[idx-Y] * s.Aj[idx-Y] * P[idx-Y];
+		if (k>0) v -= x[idx-Z] * s.Ak[idx-Z] * P[idx-Z];
+		x[idx] = P[idx] * v;
+	}
+
+	// backward substitution
+	for (int k=s.size.z-1; k>=0; k--)
+	for (int j=s.size.y-1; j>=0; j--)
+	for (int i=s.size.x-1; i>=0; i--) {
+		const IndexInt idx = i*X + j*Y + k*Z;
+		if (!s.fluid[idx]) continue;
+		const Real p = P[idx];
+		Real v = x[idx];
+		if (i<s.size.x-1) v -= x[idx+X] * s.Ai[idx] * p;
+		if (j<s.size.y-1) v -= x[idx+Y] * s.Aj[idx] * p;
+		if (k<s.size.z-1) v -= x[idx+Z] * s.Ak[idx] * p;
+		x[idx] = p * v;
+	}
+}
+
+//*****************************************************************************
+// Kernels
+
+KERNEL(pts,imbalanced)
+void knSchwarzSetA(vector<SchwarzSubdomain>& subs, bool is3D, const FlagGrid& flags,
+	const Grid<Real>* pA0, const Grid<Real>* pAi, const Grid<Real>* pAj, const Grid<Real>* pAk)
+{
+	SchwarzSubdomain& s = subs[idx];
+	const IndexInt n = s.numCells();
+	s.A0.resize(n); s.Ai.resize(n); s.Aj.resize(n); s.Ak.resize(n, 0.);
+	s.precond.resize(n); s.fluid.resize(n);
+	s.rhs.resize(n); s.x.resize(n);
+
+	schwarzGather(*pA0, s, &s.A0[0]);
+	schwarzGather(*pAi, s, &s.Ai[0]);
+	schwarzGather(*pAj, s, &s.Aj[0]);
+	if (is3D) schwarzGather(*pAk, s, &s.Ak[0]);
+
+	vector<int> f(n);
+	schwarzGather(flags, s, &f[0]);
+	for (IndexInt i=0; i<n; i++)
+		s.fluid[i] = (f[i] & FlagGrid::TypeFluid) ? 1 : 0;
+
+	// decouple last local plane from the next slab
+	vector<Real>& Aslab = is3D ? s.Ak : s.Aj;
+	const IndexInt planeSize = is3D ? (IndexInt)s.size.x * s.size.y : s.size.x;
+	std::fill(Aslab.end() - planeSize, Aslab.end(), 0.);
+
+	factorLocalMIC(s);
+}
+
+KERNEL(pts,imbalanced)
+void knSchwarzLocalSolve(vector<SchwarzSubdomain>& subs, const Grid<Real>& src)
+{
+	SchwarzSubdomain& s = subs[idx];
+	schwarzGather(src, s, &s.rhs[0]);
+	applyLocalMIC(s);
+}
+
+//! accumulate local solutions, slabs of the same color never overlap
+KERNEL(pts)
+void knSchwarzAccumulate(vector<SchwarzSubdomain>& subs, Grid<Real>& dst, int color)
+{
+	if (idx % 2 != color) return;
+	schwarzScatterAdd(&subs[idx].x[0], subs[idx], dst);
+}
+
+//*****************************************************************************
+// GridSchwarz
+
+GridSchwarz::GridSchwarz(const Vec3i& gridSize, int numSubdomains, int overlap) :
+	mSize(gridSize), mIs3D(gridSize.z > 1), mOverlap(max(overlap,1)), mIsASet(false)
+{
+	// same-colored slabs must not overlap, i.e. each slab needs at least 2*overlap planes
+	const int planes = mIs3D ? mSize.z : mSize.y;
+	const int maxSubdomains = max(1, planes / (2*mOverlap));
+	if (numSubdomains > maxSubdomains) {
+		debMsg("GridSchwarz: reducing number of subdomains from "<<numSubdomains<<" to "<<maxSubdomains, 2);
+		numSubdomains = maxSubdomains;
+	}
+	numSubdomains = max(numSubdomains, 1);
+
+	mSubs.resize(numSubdomains);
+	for (int s=0; s<numSubdomains; s++) {
+		SchwarzSubdomain& sub = mSubs[s];
+		sub.begin = (int)((IndexInt)planes *  s    / numSubdomains);
+		sub.end   = (int)((IndexInt)planes * (s+1) / numSubdomains);
+		sub.lo    = max(sub.begin - mOverlap, 0);
+		sub.hi    = min(sub.end   + mOverlap, planes);
+		sub.size  = mSize;
+		if (mIs3D) sub.size.z = sub.hi - sub.lo;
+		else       sub.size.y = sub.hi - sub.lo;
+	}
+	debMsg("GridSchwarz: "<<numSubdomains<<" subdomains, overlap "<<mOverlap, 3);
+}
+
+void GridSchwarz::setA(const FlagGrid& flags, const Grid<Real>* pA0, const Grid<Real>* pAi, const Grid<Real>* pAj, const Grid<Real>* pAk)
+{
+	assertMsg(flags.getSize() == mSize, "GridSchwarz::setA: grid size mismatch");
+	knSchwarzSetA(mSubs, mIs3D, flags, pA0, pAi, pAj, pAk);
+	mIsASet = true;
+}
+
+void GridSchwarz::apply(Grid<Real>& dst, const Grid<Real>& src)
+{
+	assertMsg(mIsASet, "GridSchwarz::apply: matrix not set");
+	knSchwarzLocalSolve(mSubs, src);
+
+	dst.clear();
+	knSchwarzAccumulate(mSubs, dst, 0);
+	knSchwarzAccumulate(mSubs, dst, 1);
+}
+
+} // namespace
@@ -0,0 +1,74 @@
+/******************************************************************************
+ *
+ * MantaFlow fluid solver framework
+ * Copyright 2011 Tobias Pfaff, Nils Thuerey
+ *
+ * This program is free software, distributed under the terms of the
+ * GNU General Public License (GPL)
+ * http://www.gnu.org/licenses
+ *
+ * Domain decomposed preconditioner for the pressure solve
+ *
+ * The domain is split into overlapping slabs along the outermost axis (z in 3D,
+ * y in 2D). Each slab keeps a local copy of the 7-point stencil and applies a
+ * modified incomplete Cholesky factorization as local solver; the results are
+ * summed up again (symmetric additive Schwarz), so the operator can directly
+ * be used as preconditioner within GridCg.
+ *
+ ******************************************************************************/
+
+#ifndef _SCHWARZ_H
+#define _SCHWARZ_H
+
+#include "vectorbase.h"
+#include "grid.h"
+
+namespace Manta {
+
+//! Overlapping slab of the global domain
+struct SchwarzSubdomain {
+	SchwarzSubdomain() : begin(0), end(0), lo(0), hi(0) {}
+
+	//! number of cells in the local buffers
+	IndexInt numCells() const { return (IndexInt)size.x * size.y * size.z; }
+
+	//! owned planes [begin,end), planes incl. halo [lo,hi)
+	int begin, end, lo, hi;
+	//! local resolution, incl. halo
+	Vec3i size;
+	//! local matrix, mICP factor, and fluid mask
+	std::vector<Real> A0, Ai, Aj, Ak, precond;
+	std::vector<char> fluid;
+	//! local residual and correction
+	std::vector<Real> rhs, x;
+};
+
+//! Additive Schwarz preconditioner with slab decomposition
+class GridSchwarz {
+	public:
+		//! constructor: splits the domain into numSubdomains slabs, overlapping by 'overlap' planes
+		GridSchwarz(const Vec3i& gridSize, int numSubdomains, int overlap = 2);
+
+		//! update local matrices and factorizations from symmetric 7-point stencil
+		void setA(const FlagGrid& flags, const Grid<Real>* pA0, const Grid<Real>* pAi, const Grid<Real>* pAj, const Grid<Real>* pAk);
+		bool isASet() const { return mIsASet; }
+
+		//! dst = M^-1 src
+		void apply(Grid<Real>& dst, const Grid<Real>& src);
+
+		// access
+		int getNumSubdomains() const { return (int)mSubs.size(); }
+		int getOverlap() const { return mOverlap; }
+		const SchwarzSubdomain& getSubdomain(int i) const { return mSubs[i]; }
+
+	private:
+		Vec3i mSize;
+		bool mIs3D;
+		int mOverlap;
+		std::vector<SchwarzSubdomain> mSubs;
+		bool mIsASet;
+};
+
+} // namespace
+
+#endif
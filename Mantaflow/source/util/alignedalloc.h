@@ -0,0 +1,63 @@
+/******************************************************************************
+ *
+ * MantaFlow fluid solver framework
+ * Copyright 2011 Tobias Pfaff, Nils Thuerey
+ *
+ * This program is free software, distributed under the terms of the
+ * GNU General Public License (GPL)
+ * http://www.gnu.org/licenses
+ *
+ * Allocator for std::vector with aligned storage
+ *
+ ******************************************************************************/
+
+#ifndef _ALIGNEDALLOC_H
+#define _ALIGNEDALLOC_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#if defined(WIN32) || defined(_WIN32)
+#	include <malloc.h>
+#endif
+
+namespace Manta {
+
+//! Allocator returning ALIGNMENT-byte aligned blocks, so that vectorized loops over the data can use aligned loads
+template<class T, size_t ALIGNMENT = 64>
+class AlignedAllocator {
+public:
+	typedef T value_type;
+	template<class U> struct rebind { typedef AlignedAllocator<U, ALIGNMENT> other; };
+
+	AlignedAllocator() {}
+	template<class U> AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) {}
+
+	T* allocate(size_t n) {
+		if (n == 0) return NULL;
+		void* p = NULL;
+#		if defined(WIN32) || defined(_WIN32)
+		p = _aligned_malloc(n * sizeof(T), ALIGNMENT);
+#		else
+		if (posix_memalign(&p, ALIGNMENT, n * sizeof(T)) != 0) p = NULL;
+#		endif
+		if (!p) throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+	void deallocate(T* p, size_t) {
+#		if defined(WIN32) || defined(_WIN32)
+		_aligned_free(p);
+#		else
+		free(p);
+#		endif
+	}
+};
+
+template<class T, class U, size_t A>
+inline bool operator==(const AlignedAllocator<T,A>&, const AlignedAllocator<U,A>&) { return true; }
+template<class T, class U, size_t A>
+inline bool operator!=(const AlignedAllocator<T,A>&, const AlignedAllocator<U,A>&) { return false; }
+
+} // namespace
+
+#endif
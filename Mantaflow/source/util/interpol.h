@@ -89,6 +89,176 @@ inline Real interpolComponent(const Vec3* data, const Vec3i& size, const int Z,
            + (data[idx+X+Z][c]*t0 + data[idx+X+Y+Z][c]*t1) * s1) * f1;
 }
 
+//! Trilinear interpolation weights, allows sampling several grids at the same position
+struct InterpolWeights {
+    int xi, yi, zi, zi1;
+    Real s0, s1, t0, t1, f0, f1;
+};
+
+//! compute weights for interpolWeighted / interpolWeightedLookup, same as used by interpol()
+inline InterpolWeights getInterpolWeights(const Vec3i& size, const Vec3& pos) {
+    BUILD_INDEX
+    unusedParameter(X); unusedParameter(Y);
+    InterpolWeights w;
+    w.xi = xi; w.yi = yi; w.zi = zi; w.zi1 = zi+1;
+    if (size.z==1) w.zi = w.zi1 = 0;
+    w.s0 = s0; w.s1 = s1; w.t0 = t0; w.t1 = t1; w.f0 = f0; w.f1 = f1;
+    return w;
+}
+
+//! interpolate with precomputed weights, gives the same result as interpol()
+template <class T>
+inline T interpolWeighted(const T* data, const Vec3i& size, const InterpolWeights& w) {
+    const IndexInt X = 1, Y = size.x, Z = (IndexInt)size.x * size.y * (w.zi1 - w.zi);
+    const IndexInt idx = (IndexInt)w.xi + (IndexInt)size.x * (w.yi + (IndexInt)size.y * w.zi);
+    DEBUG_ONLY(checkIndexInterpol(size,idx)); DEBUG_ONLY(checkIndexInterpol(size,idx+X+Y+Z));
+
+    return  ((data[idx]    *w.t0 + data[idx+Y]    *w.t1) * w.s0
+           + (data[idx+X]  *w.t0 + data[idx+X+Y]  *w.t1) * w.s1) * w.f0
+           +((data[idx+Z]  *w.t0 + data[idx+Y+Z]  *w.t1) * w.s0
+           + (data[idx+X+Z]*w.t0 + data[idx+X+Y+Z]*w.t1) * w.s1) * w.f1;
+}
+
+//! same as interpolWeighted, but reads the values via lookup(i,j,k), e.g., for values that are computed on the fly
+template <class T, class LOOKUP>
+inline T interpolWeightedLookup(const LOOKUP& lookup, const InterpolWeights& w) {
+    const int xi = w.xi, yi = w.yi, zi = w.zi, zi1 = w.zi1;
+    return  ((lookup(xi,yi,zi)    *w.t0 + lookup(xi,yi+1,zi)    *w.t1) * w.s0
+           + (lookup(xi+1,yi,zi)  *w.t0 + lookup(xi+1,yi+1,zi)  *w.t1) * w.s1) * w.f0
+           +((lookup(xi,yi,zi1)   *w.t0 + lookup(xi,yi+1,zi1)   *w.t1) * w.s0
+           + (lookup(xi+1,yi,zi1) *w.t0 + lookup(xi+1,yi+1,zi1) *w.t1) * w.s1) * w.f1;
+}
+
+//! same as interpolComponent, but reads the values via lookup(i,j,k)
+template <int c, class LOOKUP>
+inline Real interpolComponentWeightedLookup(const LOOKUP& lookup, const InterpolWeights& w) {
+    const int xi = w.xi, yi = w.yi, zi = w.zi, zi1 = w.zi1;
+    return  ((lookup(xi,yi,zi)[c]    *w.t0 + lookup(xi,yi+1,zi)[c]    *w.t1) * w.s0
+           + (lookup(xi+1,yi,zi)[c]  *w.t0 + lookup(xi+1,yi+1,zi)[c]  *w.t1) * w.s1) * w.f0
+           +((lookup(xi,yi,zi1)[c]   *w.t0 + lookup(xi,yi+1,zi1)[c]   *w.t1) * w.s0
+           + (lookup(xi+1,yi,zi1)[c] *w.t0 + lookup(xi+1,yi+1,zi1)[c] *w.t1) * w.s1) * w.f1;
+}
+
+// ----------------------------------------------------------------------
+// Batched interpolation, evaluates up to INTERPOL_BATCH samples at once;
+// weights are kept as arrays, so that weight computation and gathers
+// can be vectorized by the compiler. Results are identical to interpol()
+// ----------------------------------------------------------------------
+
+static const int INTERPOL_BATCH = 16;
+
+//! Trilinear weights for a batch of samples
+struct InterpolWeightsBatch {
+    IndexInt idx[INTERPOL_BATCH];
+    Real s0[INTERPOL_BATCH], s1[INTERPOL_BATCH];
+    Real t0[INTERPOL_BATCH], t1[INTERPOL_BATCH];
+    Real f0[INTERPOL_BATCH], f1[INTERPOL_BATCH];
+};
+
+//! compute weights for n<=INTERPOL_BATCH positions, values are located at cell + shift
+/*! shift is (0.5,0.5,0.5) for regular grids, and e.g. (0,0.5,0.5) for x components of MAC grids */
+inline void getInterpolWeightsBatch(const Vec3i& size, const int Z, const Vec3* pos, int n, const Vec3& shift, InterpolWeightsBatch& w) {
+    assertDeb(n <= INTERPOL_BATCH, "batch of "<<n<<" samples exceeds INTERPOL_BATCH");
+    const IndexInt Y = size.x;
+    for (int l=0; l<INTERPOL_BATCH && l<n; l++) {
+        const Real px=pos[l].x-shift.x, py=pos[l].y-shift.y, pz=pos[l].z-shift.z;
+        int xi = (int)px, yi = (int)py, zi = (int)pz;
+        Real s1 = px-(Real)xi, t1 = py-(Real)yi, f1 = pz-(Real)zi;
+        // clamp to border
+        if (px < 0.) { xi = 0; s1 = 0.0; }
+        if (py < 0.) { yi = 0; t1 = 0.0; }
+        if (pz < 0.) { zi = 0; f1 = 0.0; }
+        if (xi >= size.x-1) { xi = size.x-2; s1 = 1.0; }
+        if (yi >= size.y-1) { yi = size.y-2; t1 = 1.0; }
+        if (size.z>1 && zi >= size.z-1) { zi = size.z-2; f1 = 1.0; }
+
+        w.idx[l] = (IndexInt)xi + Y * yi + (IndexInt)Z * zi;
+        w.s0[l] = 1.-s1; w.s1[l] = s1;
+        w.t0[l] = 1.-t1; w.t1[l] = t1;
+        w.f0[l] = 1.-f1; w.f1[l] = f1;
+    }
+}
+
+template <class T>
+inline void interpolBatch(const T* data, const Vec3i& size, const int Z, const InterpolWeightsBatch& w, int n, T* out) {
+    const IndexInt X = 1, Y = size.x;
+    for (int l=0; l<INTERPOL_BATCH && l<n; l++) {
+        const IndexInt idx = w.idx[l];
+        DEBUG_ONLY(checkIndexInterpol(size,idx)); DEBUG_ONLY(checkIndexInterpol(size,idx+X+Y+Z));
+        out[l] = ((data[idx]    *w.t0[l] + data[idx+Y]    *w.t1[l]) * w.s0[l]
+               + (data[idx+X]  *w.t0[l] + data[idx+X+Y]  *w.t1[l]) * w.s1[l]) * w.f0[l]
+               +((data[idx+Z]  *w.t0[l] + data[idx+Y+Z]  *w.t1[l]) * w.s0[l]
+               + (data[idx+X+Z]*w.t0[l] + data[idx+X+Y+Z]*w.t1[l]) * w.s1[l]) * w.f1[l];
+    }
+}
+
+template <int c>
+inline void interpolComponentBatch(const Vec3* data, const Vec3i& size, const int Z, const InterpolWeightsBatch& w, int n, Real* out) {
+    const IndexInt X = 1, Y = size.x;
+    for (int l=0; l<INTERPOL_BATCH && l<n; l++) {
+        const IndexInt idx = w.idx[l];
+        DEBUG_ONLY(checkIndexInterpol(size,idx)); DEBUG_ONLY(checkIndexInterpol(size,idx+X+Y+Z));
+        out[l] = ((data[idx][c]    *w.t0[l] + data[idx+Y][c]    *w.t1[l]) * w.s0[l]
+               + (data[idx+X][c]  *w.t0[l] + data[idx+X+Y][c]  *w.t1[l]) * w.s1[l]) * w.f0[l]
+               +((data[idx+Z][c]  *w.t0[l] + data[idx+Y+Z][c]  *w.t1[l]) * w.s0[l]
+               + (data[idx+X+Z][c]*w.t0[l] + data[idx+X+Y+Z][c]*w.t1[l]) * w.s1[l]) * w.f1[l];
+    }
+}
+
+//! batched version of interpol()
+template <class T>
+inline void interpolBatch(const T* data, const Vec3i& size, const int Z, const Vec3* pos, int n, T* out) {
+    InterpolWeightsBatch w;
+    getInterpolWeightsBatch(size, Z, pos, n, Vec3(0.5), w);
+    interpolBatch<T>(data, size, Z, w, n, out);
+}
+
+//! batched version of interpolComponent()
+template <int c>
+inline void interpolComponentBatch(const Vec3* data, const Vec3i& size, const int Z, const Vec3* pos, int n, Real* out) {
+    InterpolWeightsBatch w;
+    getInterpolWeightsBatch(size, Z, pos, n, Vec3(0.5), w);
+    interpolComponentBatch<c>(data, size, Z, w, n, out);
+}
+
+//! Weights for the three staggered components of a MAC grid
+struct InterpolWeightsBatchMAC {
+    InterpolWeightsBatch comp[3];
+};
+
+inline void getInterpolWeightsBatchMAC(const Vec3i& size, const int Z, const Vec3* pos, int n, InterpolWeightsBatchMAC& w) {
+    getInterpolWeightsBatch(size, Z, pos, n, Vec3(0. ,0.5,0.5), w.comp[0]);
+    getInterpolWeightsBatch(size, Z, pos, n, Vec3(0.5,0. ,0.5), w.comp[1]);
+    getInterpolWeightsBatch(size, Z, pos, n, Vec3(0.5,0.5,0. ), w.comp[2]);
+}
+
+inline void interpolMACBatch(const Vec3* data, const Vec3i& size, const int Z, const InterpolWeightsBatchMAC& w, int n, Vec3* out) {
+    Real vx[INTERPOL_BATCH], vy[INTERPOL_BATCH], vz[INTERPOL_BATCH];
+    interpolComponentBatch<0>(data, size, Z, w.comp[0], n, vx);
+    interpolComponentBatch<1>(data, size, Z, w.comp[1], n, vy);
+    interpolComponentBatch<2>(data, size, Z, w.comp[2], n, vz);
+    for (int l=0; l<n; l++) out[l] = Vec3(vx[l], vy[l], vz[l]);
+}
+
+//! batched version of interpolMAC()
+inline void interpolMACBatch(const Vec3* data, const Vec3i& size, const int Z, const Vec3* pos, int n, Vec3* out) {
+    InterpolWeightsBatchMAC w;
+    getInterpolWeightsBatchMAC(size, Z, pos, n, w);
+    interpolMACBatch(data, size, Z, w, n, out);
+}
+
+//! Range for KERNEL(pts) over batches of n samples, idx is the batch number
+class InterpolBatches {
+public:
+    InterpolBatches(IndexInt n) : mN(n) {}
+    IndexInt size() const { return (mN + INTERPOL_BATCH-1) / INTERPOL_BATCH; }
+    //! first sample, and number of samples of batch b
+    IndexInt start(IndexInt b) const { return b * INTERPOL_BATCH; }
+    int count(IndexInt b) const { return (int)std::min((IndexInt)INTERPOL_BATCH, mN - b * INTERPOL_BATCH); }
+private:
+    IndexInt mN;
+};
+
 template<class T>
 inline void setInterpol(T* data, const Vec3i& size, const int Z, const Vec3& pos, const T& v, Real* sumBuffer) 
 {
@@ -371,6 +371,43 @@ private:
 	MTRand mtr; 
 };
 
+//! Counter based random numbers, the n-th number of a stream is a hash of (key, n)
+/*! streams keyed by e.g. cell index and frame can be drawn in parallel, 
+    and give the same numbers regardless of the order or thread they are drawn in */
+class CounterRandomStream
+{
+public:
+	typedef unsigned long long uint64;
+
+	inline CounterRandomStream(uint64 seed, uint64 stream, uint64 substream=0) : mCounter(0) {
+		mKey = mix( seed + mix( stream + mix( substream ) ) );
+	}
+
+	inline unsigned int getUInt() { return (unsigned int)( mix( mKey + (++mCounter) * 0x9E3779B97F4A7C15ULL ) >> 32 ); }
+	//! numbers in [0,1)
+	inline double getDouble( void ) { return getUInt() * (1.0/4294967296.0); }
+	inline float  getFloat ( void ) { return (getUInt() >> 8) * (1.0f/16777216.0f); }
+
+	#if FLOATINGPOINT_PRECISION==1
+	inline Real getReal()           { return getFloat(); }
+	#else
+	inline Real getReal()           { return getDouble(); }
+	#endif
+
+	inline Vec3   getVec3 ()        { Real a=getReal(), b=getReal(), c=getReal(); return Vec3(a,b,c); }
+
+private:
+	//! splitmix64 finalizer
+	static inline uint64 mix(uint64 z) {
+		z += 0x9E3779B97F4A7C15ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	uint64 mKey, mCounter;
+};
+
 
 } // namespace
 
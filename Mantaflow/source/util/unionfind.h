@@ -0,0 +1,66 @@
+/******************************************************************************
+ *
+ * MantaFlow fluid solver framework
+ * Copyright 2011 Tobias Pfaff, Nils Thuerey
+ *
+ * This program is free software, distributed under the terms of the
+ * GNU General Public License (GPL)
+ * http://www.gnu.org/licenses
+ *
+ * Lock-free union-find for parallel connected component labeling
+ *
+ ******************************************************************************/
+
+#ifndef _UNIONFIND_H
+#define _UNIONFIND_H
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+namespace Manta {
+
+//! Disjoint sets over 0..n-1, unite() and find() may be called concurrently from kernels
+/*! Roots are always linked below the smaller index, so the representative of each set
+    is its smallest element, independent of the order in which unite() calls happen */
+class UnionFind {
+public:
+	UnionFind(int n) : mParent(n) {
+		for (int i=0; i<n; i++) mParent[i].store(i, std::memory_order_relaxed);
+	}
+
+	inline int size() const { return (int)mParent.size(); }
+
+	//! representative of x, with path halving
+	inline int find(int x) {
+		while (true) {
+			int p = mParent[x].load(std::memory_order_relaxed);
+			if (p == x) return x;
+			int gp = mParent[p].load(std::memory_order_relaxed);
+			if (p != gp) mParent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			x = gp;
+		}
+	}
+
+	inline void unite(int a, int b) {
+		while (true) {
+			a = find(a);
+			b = find(b);
+			if (a == b) return;
+			if (a < b) std::swap(a,b);
+			// a is a root unless another thread linked it in the meantime
+			int expected = a;
+			if (mParent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+		}
+	}
+
+	//! only valid once all unite() calls are finished
+	inline bool isRoot(int x) const { return mParent[x].load(std::memory_order_relaxed) == x; }
+
+protected:
+	std::vector< std::atomic<int> > mParent;
+};
+
+} // namespace
+
+#endif
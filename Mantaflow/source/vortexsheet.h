@@ -37,9 +37,6 @@ struct VorticityChannel : public SimpleTriChannel<VortexSheetInfo> {
 //! Manages 3D texture coordinates
 struct TexCoord3Channel : public SimpleNodeChannel<Vec3> {
 	virtual NodeChannel* clone() { TexCoord3Channel* tc = new TexCoord3Channel(); *tc = *this; return tc; }
-	
-	void addInterpol(int a, int b, Real alpha) { data.push_back((1.0-alpha)*data[a] + alpha*data[b]);}
-	void mergeWith(int node, int delnode, Real alpha) { data[node] = 0.5*(data[node]+data[delnode]); }
 };
 
 struct TurbulenceInfo {
@@ -48,12 +45,11 @@ struct TurbulenceInfo {
 	Real k, epsilon;    
 };
 
+inline TurbulenceInfo interpolChannel(const TurbulenceInfo& a, const TurbulenceInfo& b, Real alpha) { return TurbulenceInfo(a, b, alpha); }
+
 //! Manages k-epsilon information
 struct TurbulenceChannel : public SimpleNodeChannel<TurbulenceInfo> {
 	virtual NodeChannel* clone() { TurbulenceChannel* tc = new TurbulenceChannel(); *tc = *this; return tc; }
-	
-	void addInterpol(int a, int b, Real alpha) { data.push_back(TurbulenceInfo(data[a], data[b], alpha)); }
-	void mergeWith(int node, int delnode, Real alpha) { data[node] = TurbulenceInfo(data[node], data[delnode], 0.5); }
 };
 
 //! Typed Mesh with a vorticity and 2 texcoord3 channels